@@ -0,0 +1,251 @@
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "model_launcher.h"
+#include "system_variables.h"
+#include "pest_error.h"
+
+#ifdef OS_WIN
+#include <Windows.h>
+#endif
+
+#ifdef OS_LINUX
+#include <spawn.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+extern char **environ;
+#endif
+
+using namespace std;
+
+string RunUsage::to_string() const
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "u=%.2f s=%.2f m=%ld", user_secs, sys_secs, max_rss_kb);
+	return string(buf);
+}
+
+bool RunUsage::from_string(const string &str)
+{
+	double u, s;
+	long m;
+	if (sscanf(str.c_str(), "u=%lf s=%lf m=%ld", &u, &s, &m) != 3) return false;
+	user_secs = u;
+	sys_secs = s;
+	max_rss_kb = m;
+	return true;
+}
+
+#ifdef OS_LINUX
+namespace
+{
+	// start cmd through the shell in a new process group whose id is the pid of the shell
+	pid_t spawn_command(const string &cmd, const string &work_dir)
+	{
+		vector<const char*> argv;
+		argv.push_back("sh");
+		argv.push_back("-c");
+		if (work_dir.empty())
+		{
+			argv.push_back(cmd.c_str());
+		}
+		else
+		{
+			argv.push_back("cd -- \"$1\" && eval \"$2\"");
+			argv.push_back("sh");
+			argv.push_back(work_dir.c_str());
+			argv.push_back(cmd.c_str());
+		}
+		argv.push_back(NULL);
+		posix_spawnattr_t attr;
+		posix_spawnattr_init(&attr);
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+		posix_spawnattr_setpgroup(&attr, 0);
+		pid_t pid;
+		int err = posix_spawn(&pid, "/bin/sh", NULL, &attr, const_cast<char* const*>(argv.data()), environ);
+		posix_spawnattr_destroy(&attr);
+		return (err == 0) ? pid : -1;
+	}
+
+	int open_pidfd(pid_t pid)
+	{
+#ifdef SYS_pidfd_open
+		return syscall(SYS_pidfd_open, pid, 0);
+#else
+		return -1;
+#endif
+	}
+
+	// wait up to wait_ms milliseconds for the process to exit without reaping it.  Returns true if it has
+	// exited.  Kernels without pidfd support fall back to checking with waitid every few milliseconds
+	bool wait_exit(pid_t pid, int pidfd, int wait_ms)
+	{
+		if (pidfd >= 0)
+		{
+			struct pollfd pfd;
+			pfd.fd = pidfd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			int n = poll(&pfd, 1, wait_ms);
+			return n > 0 || (n < 0 && errno != EINTR);
+		}
+		const int step_ms = 5;
+		for (int waited = 0;; waited += step_ms)
+		{
+			siginfo_t info;
+			info.si_pid = 0;
+			if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid != 0) return true;
+			if (waited >= wait_ms) return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(step_ms));
+		}
+	}
+}
+#endif
+
+ModelLauncher::Status ModelLauncher::run(const vector<string> &commands, const string &work_dir,
+	pest_utils::thread_flag *terminate, double max_secs, RunUsage &usage)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start_time = Clock::now();
+	Clock::time_point end_time = start_time + std::chrono::milliseconds((long long)(max_secs * 1000.0));
+	Status status = Status::OK;
+	usage = RunUsage();
+#ifdef OS_LINUX
+	for (auto &cmd_string : commands)
+	{
+		pid_t pid = spawn_command(cmd_string, work_dir);
+		if (pid == -1)
+		{
+			cerr << "could not start command: " << cmd_string << endl;
+			status = Status::START_FAILED;
+			break;
+		}
+		int pidfd = open_pidfd(pid);
+		bool exited = false;
+		while (!exited)
+		{
+			if (terminate != nullptr && terminate->get())
+			{
+				status = Status::TERMINATED;
+				break;
+			}
+			int wait_ms = OperSys::thread_sleep_milli_secs;
+			if (max_secs > 0)
+			{
+				long long remain_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - Clock::now()).count();
+				if (remain_ms <= 0)
+				{
+					status = Status::TIMED_OUT;
+					break;
+				}
+				wait_ms = (int)std::min<long long>(wait_ms, remain_ms);
+			}
+			exited = wait_exit(pid, pidfd, wait_ms);
+		}
+		if (!exited)
+		{
+			kill(-pid, SIGKILL);
+		}
+		int wait_status;
+		struct rusage ru;
+		while (wait4(pid, &wait_status, 0, &ru) == -1 && errno == EINTR) {}
+		if (pidfd >= 0) close(pidfd);
+		usage.user_secs += ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1.0e6;
+		usage.sys_secs += ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1.0e6;
+		usage.max_rss_kb = std::max(usage.max_rss_kb, (long)ru.ru_maxrss);
+		if (status != Status::OK) break;
+	}
+#endif
+#ifdef OS_WIN
+	//create a job object to track child and grandchild process
+	HANDLE job = CreateJobObject(NULL, NULL);
+	if (job == NULL) throw PestError("could not create job object handle");
+	JOBOBJECT_EXTENDED_LIMIT_INFORMATION jeli = { 0 };
+	jeli.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+	if (0 == SetInformationJobObject(job, JobObjectExtendedLimitInformation, &jeli, sizeof(jeli)))
+	{
+		CloseHandle(job);
+		throw PestError("could not assign job limit flag to job object");
+	}
+	const char *cur_dir = work_dir.empty() ? NULL : work_dir.c_str();
+	for (auto &cmd_string : commands)
+	{
+		vector<char> cmd_line(cmd_string.begin(), cmd_string.end());
+		cmd_line.push_back('\0');
+		STARTUPINFO si;
+		PROCESS_INFORMATION pi;
+		ZeroMemory(&si, sizeof(si));
+		si.cb = sizeof(si);
+		ZeroMemory(&pi, sizeof(pi));
+		// the process is started suspended so it is in the job before it can start any children
+		if (!CreateProcess(NULL, cmd_line.data(), NULL, NULL, false, CREATE_SUSPENDED, NULL, cur_dir, &si, &pi))
+		{
+			cerr << "could not start command: " << cmd_string << endl;
+			status = Status::START_FAILED;
+			break;
+		}
+		if (0 == AssignProcessToJobObject(job, pi.hProcess))
+		{
+			TerminateProcess(pi.hProcess, 1);
+			CloseHandle(pi.hThread);
+			CloseHandle(pi.hProcess);
+			CloseHandle(job);
+			throw PestError("could not add process to job object: " + cmd_string);
+		}
+		ResumeThread(pi.hThread);
+		CloseHandle(pi.hThread);
+		bool exited = false;
+		while (!exited)
+		{
+			if (terminate != nullptr && terminate->get())
+			{
+				status = Status::TERMINATED;
+				break;
+			}
+			DWORD wait_ms = OperSys::thread_sleep_milli_secs;
+			if (max_secs > 0)
+			{
+				long long remain_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - Clock::now()).count();
+				if (remain_ms <= 0)
+				{
+					status = Status::TIMED_OUT;
+					break;
+				}
+				wait_ms = (DWORD)std::min<long long>(wait_ms, remain_ms);
+			}
+			exited = (WaitForSingleObject(pi.hProcess, wait_ms) != WAIT_TIMEOUT);
+		}
+		if (!exited)
+		{
+			TerminateJobObject(job, 1);
+			WaitForSingleObject(pi.hProcess, INFINITE);
+		}
+		CloseHandle(pi.hProcess);
+		if (status != Status::OK) break;
+	}
+	JOBOBJECT_BASIC_ACCOUNTING_INFORMATION jbai;
+	if (QueryInformationJobObject(job, JobObjectBasicAccountingInformation, &jbai, sizeof(jbai), NULL))
+	{
+		// times are in 100 nanosecond units
+		usage.user_secs = jbai.TotalUserTime.QuadPart / 1.0e7;
+		usage.sys_secs = jbai.TotalKernelTime.QuadPart / 1.0e7;
+	}
+	if (QueryInformationJobObject(job, JobObjectExtendedLimitInformation, &jeli, sizeof(jeli), NULL))
+	{
+		// peak committed memory of the job is the closest measure to the resident set size
+		usage.max_rss_kb = (long)(jeli.PeakJobMemoryUsed / 1024);
+	}
+	CloseHandle(job);
+#endif
+	usage.wall_secs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time).count() / 1000.0;
+	return status;
+}
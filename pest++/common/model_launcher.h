@@ -0,0 +1,41 @@
+#ifndef MODEL_LAUNCHER_H_
+#define MODEL_LAUNCHER_H_
+
+#include <string>
+#include <vector>
+#include "config_os.h"
+#include "utilities.h"
+
+// resources used by the processes of a model run
+class RunUsage
+{
+public:
+	RunUsage() : wall_secs(0), user_secs(0), sys_secs(0), max_rss_kb(0) {}
+	double wall_secs;
+	double user_secs; // cpu time of the commands and their children
+	double sys_secs;
+	long max_rss_kb; // largest resident set size of any of the processes
+	// short text form that fits in the description of a NetPackage
+	std::string to_string() const;
+	// parse the text written by to_string().  Returns false if str is not in that form
+	bool from_string(const std::string &str);
+};
+
+// ModelLauncher runs the commands of a model run as child processes.  On linux each command is started
+// with posix_spawn through /bin/sh in a new process group, and the wait for it to finish uses a pidfd so
+// the exit is noticed as soon as it happens.  On windows the commands run inside a job object.  When the
+// run is terminated or exceeds its time limit, the whole process group (or job) is killed so grandchild
+// processes started by the model do not outlive the run.
+class ModelLauncher
+{
+public:
+	enum class Status { OK, START_FAILED, TERMINATED, TIMED_OUT };
+	// run the commands one after the other in work_dir (the current directory if empty).  The run is
+	// stopped when terminate is set or when it has taken more than max_secs seconds (no limit if
+	// max_secs <= 0).  terminate is checked every OperSys::thread_sleep_milli_secs.  The resources used
+	// are returned in usage
+	static Status run(const std::vector<std::string> &commands, const std::string &work_dir,
+		pest_utils::thread_flag *terminate, double max_secs, RunUsage &usage);
+};
+
+#endif /* MODEL_LAUNCHER_H_ */
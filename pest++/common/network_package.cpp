@@ -4,11 +4,95 @@
 #include "network_package.h"
 #include "network_wrapper.h"
 #include <cassert>
+#include <stdexcept>
 
 using namespace std;
 
 //Static Memeber Initialization
 int NetPackage::last_group_id = 0;
+const char NetPackage::V2_MAGIC[4] = { 'Y', 'M', 'R', '2' };
+const string NetPackage::V2_TAG = "NetPackage v2";
+const string NetPackage::V2_COMPRESS_TAG = "NetPackage v2 compress";
+const int NetPackage::V1_HEADER_LEN = sizeof(unsigned long) + sizeof(NetPackage::PackType) + sizeof(int) + sizeof(int) + NetPackage::DESC_LEN;
+mutex NetPackage::sock_mutex;
+unordered_map<int, NetPackage::SockState> NetPackage::sock_map;
+atomic<uint64_t> NetPackage::n_data_sent(0);
+atomic<uint64_t> NetPackage::n_wire_sent(0);
+atomic<uint64_t> NetPackage::n_data_recv(0);
+atomic<uint64_t> NetPackage::n_wire_recv(0);
+
+// version 2 header fields are stored little-endian whatever the byte order of the host
+static void put_le(char *buf, uint64_t val, int n_bytes)
+{
+	for (int i = 0; i < n_bytes; ++i)
+	{
+		buf[i] = char((val >> (8 * i)) & 0xFF);
+	}
+}
+
+static uint64_t get_le(const char *buf, int n_bytes)
+{
+	uint64_t val = 0;
+	for (int i = 0; i < n_bytes; ++i)
+	{
+		val |= uint64_t((unsigned char)buf[i]) << (8 * i);
+	}
+	return val;
+}
+
+// XOR each double with the matching value of ref, or with the previous value if ref is null, and store
+// only the low order bytes below the leading zero bytes of the result.  Each control byte holds the
+// number of leading zero bytes of two values.  Runs that barely change an observation give mostly zero bytes
+static void xor_encode(const char *raw, size_t n_vals, const char *ref, vector<char> &out)
+{
+	uint64_t prev = 0;
+	size_t i_ctrl = 0;
+	for (size_t i = 0; i < n_vals; ++i)
+	{
+		uint64_t val = get_le(&raw[i * 8], 8);
+		uint64_t x = val ^ (ref ? get_le(&ref[i * 8], 8) : prev);
+		prev = val;
+		int n_zero = 0;
+		while (n_zero < 8 && ((x >> (8 * (7 - n_zero))) & 0xFF) == 0) ++n_zero;
+		if (i % 2 == 0)
+		{
+			i_ctrl = out.size();
+			out.push_back(char(n_zero << 4));
+		}
+		else
+		{
+			out[i_ctrl] |= char(n_zero);
+		}
+		for (int i_byte = 0; i_byte < 8 - n_zero; ++i_byte)
+		{
+			out.push_back(char((x >> (8 * i_byte)) & 0xFF));
+		}
+	}
+}
+
+// reverse of xor_encode.  Returns false if the encoded data is too short
+static bool xor_decode(const char *z_data, size_t z_len, size_t n_vals, const char *ref, char *raw)
+{
+	uint64_t prev = 0;
+	size_t i_z = 0;
+	int ctrl = 0;
+	for (size_t i = 0; i < n_vals; ++i)
+	{
+		if (i % 2 == 0)
+		{
+			if (i_z >= z_len) return false;
+			ctrl = (unsigned char)z_data[i_z++];
+		}
+		int n_zero = (i % 2 == 0) ? (ctrl >> 4) : (ctrl & 0x0F);
+		if (n_zero > 8 || i_z + 8 - n_zero > z_len) return false;
+		uint64_t x = get_le(&z_data[i_z], 8 - n_zero);
+		i_z += 8 - n_zero;
+		uint64_t val = x ^ (ref ? get_le(&ref[i * 8], 8) : prev);
+		put_le(&raw[i * 8], val, 8);
+		prev = val;
+	}
+	return true;
+}
 
 //Static Methods
 int NetPackage::get_new_group_id()
@@ -16,6 +100,79 @@ int NetPackage::get_new_group_id()
 	return ++last_group_id;
 }
 
+NetPackage::SockState &NetPackage::get_sock_state(int sockfd)
+{
+	// elements of an unordered_map are not moved when it grows so the reference stays valid until
+	// the connection is reset
+	lock_guard<mutex> lock(sock_mutex);
+	return sock_map[sockfd];
+}
+
+int NetPackage::get_version(int sockfd)
+{
+	return get_sock_state(sockfd).version;
+}
+
+void NetPackage::reset_connection(int sockfd)
+{
+	lock_guard<mutex> lock(sock_mutex);
+	sock_map.erase(sockfd);
+}
+
+NetPackage::ByteCounts NetPackage::get_byte_counts()
+{
+	ByteCounts counts;
+	counts.data_sent = n_data_sent;
+	counts.wire_sent = n_wire_sent;
+	counts.data_recv = n_data_recv;
+	counts.wire_recv = n_wire_recv;
+	return counts;
+}
+
+uint16_t NetPackage::compress_data(SockState &state, const char *raw, size_t raw_len, vector<char> &z_data)
+{
+	// payloads that are the same size as the last one (RUN_FINISH results of the same model) are XORed
+	// with it.  Others are XORed value by value
+	size_t n_vals = raw_len / sizeof(double);
+	bool use_ref = (state.send_ref.size() == raw_len);
+	z_data.clear();
+	z_data.reserve(raw_len / 2);
+	xor_encode(raw, n_vals, use_ref ? state.send_ref.data() : nullptr, z_data);
+	uint16_t flags = use_ref ? FLAG_XOR_REF : FLAG_XOR_PREV;
+	if (z_data.size() >= raw_len - raw_len / 8)
+	{
+		// not worth it.  Send the data as it is but still keep it as the reference
+		z_data.clear();
+		flags = FLAG_SET_REF;
+	}
+	state.send_ref.assign(raw, raw + raw_len);
+	return flags;
+}
+
+void NetPackage::decompress_data(SockState &state, uint16_t flags, vector<char> &data)
+{
+	if (flags & (FLAG_XOR_REF | FLAG_XOR_PREV))
+	{
+		uint64_t raw_len = (data.size() >= 8) ? get_le(data.data(), 8) : 0;
+		const char *ref = nullptr;
+		if (flags & FLAG_XOR_REF)
+		{
+			if (state.recv_ref.size() != raw_len)
+			{
+				throw runtime_error("NetPackage: compressed data does not match the reference data");
+			}
+			ref = state.recv_ref.data();
+		}
+		vector<char> raw(raw_len);
+		if (data.size() < 8 || !xor_decode(&data[8], data.size() - 8, raw_len / sizeof(double), ref, raw.data()))
+		{
+			throw runtime_error("NetPackage: invalid compressed data");
+		}
+		data.swap(raw);
+	}
+	state.recv_ref = data;
+}
+
 //Non static methods
 NetPackage::NetPackage(PackType _type, int _group, int _run_id, const string &desc_str)
 	: type(_type), group(_group), run_id(_run_id)
@@ -36,78 +193,191 @@ void NetPackage::reset(PackType _type, int _group, int _run_id, const string &_d
 
 int NetPackage::send(int sockfd, const void *data, unsigned long data_len_l)
 {
-	int n;
-	unsigned long buf_sz = 0;
-	//calculate the size of buffer
-	buf_sz = sizeof(buf_sz);
-	buf_sz += sizeof(type);
-	buf_sz += sizeof(group);
-	buf_sz += sizeof(run_id);
-	buf_sz += sizeof(desc);
-	buf_sz += data_len_l;
-	//pack information into buffer
-	//unique_ptr<char[]> buf(new char[buf_sz]);
-	vector<char> buf;
-	buf.resize(buf_sz, '\0');
-	size_t i_start = 0;
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &buf_sz, sizeof(buf_sz));
-	i_start += sizeof(buf_sz);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &type, sizeof(type));
-	i_start += sizeof(type);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &group, sizeof(group));
-	i_start += sizeof(group);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &run_id, sizeof(run_id));
-	i_start += sizeof(run_id);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, desc, sizeof(desc));
-	i_start += sizeof(desc);
-	if (data_len_l > 0) {
-		w_memcpy_s(&buf[i_start], buf_sz-i_start, data, data_len_l);
-		i_start += data_len_l;
+	vector<pair<const char*, size_t>> data_bufs;
+	data_bufs.push_back(make_pair(static_cast<const char*>(data), size_t(data_len_l)));
+	return send(sockfd, data_bufs);
+}
+
+int NetPackage::send(int sockfd, const vector<pair<const char*, size_t>> &data_bufs)
+{
+	uint64_t data_len_l = 0;
+	for (const auto &b : data_bufs)
+	{
+		data_len_l += b.second;
+	}
+	SockState &state = get_sock_state(sockfd);
+	uint16_t flags = 0;
+	vector<char> z_data;
+	if (state.version == 2 && state.compress && data_len_l >= MIN_COMPRESS_LEN && data_len_l % sizeof(double) == 0)
+	{
+		vector<char> raw;
+		const char *raw_ptr = data_bufs[0].first;
+		if (data_bufs.size() > 1)
+		{
+			raw.reserve(data_len_l);
+			for (const auto &b : data_bufs)
+			{
+				raw.insert(raw.end(), b.first, b.first + b.second);
+			}
+			raw_ptr = raw.data();
+		}
+		// compressed data starts with the uncompressed length
+		z_data.resize(8);
+		put_le(z_data.data(), data_len_l, 8);
+		vector<char> xor_data;
+		flags = compress_data(state, raw_ptr, data_len_l, xor_data);
+		z_data.insert(z_data.end(), xor_data.begin(), xor_data.end());
+	}
+	// the header is packed on the stack and sent together with the data buffers in a single call
+	char header_buf[V2_HEADER_LEN];
+	vector<pair<const char*, size_t>> bufs;
+	if (flags & (FLAG_XOR_REF | FLAG_XOR_PREV))
+	{
+		size_t header_sz = pack_header(header_buf, state.version, flags, z_data.size());
+		bufs.push_back(make_pair((const char*)header_buf, header_sz));
+		bufs.push_back(make_pair((const char*)z_data.data(), z_data.size()));
+	}
+	else
+	{
+		size_t header_sz = pack_header(header_buf, state.version, flags, data_len_l);
+		bufs.reserve(data_bufs.size() + 1);
+		bufs.push_back(make_pair((const char*)header_buf, header_sz));
+		bufs.insert(bufs.end(), data_bufs.begin(), data_bufs.end());
 	}
-	if (i_start!=buf_sz) {
-		cerr << "NetPackage::send error: could only send" << i_start
-			<< " out of " << buf_sz << "bytes" << endl;
+	int n = w_sendallv(sockfd, bufs);
+	n_data_sent += data_len_l;
+	for (const auto &b : bufs)
+	{
+		n_wire_sent += b.second;
 	}
-	assert (i_start==buf_sz);
-	n = w_sendall(sockfd, buf.data(), &buf_sz);
 	return n;  // return 0 on sucess or -1 on failure
 }
 
 int  NetPackage::recv(int sockfd)
 {
 	int n;
-	unsigned long header_sz = 0;
-	unsigned long buf_sz = 0;
+	//get header (ie size, seq_id, id and name).  The first bytes tell if it is a version 2 header
+	char header_buf[V2_HEADER_LEN];
+	unsigned long n_bytes = sizeof(V2_MAGIC);
+	n = w_recvall(sockfd, header_buf, &n_bytes);
+	if (n > 0 && n_bytes == sizeof(V2_MAGIC))
+	{
+		int version = memcmp(header_buf, V2_MAGIC, sizeof(V2_MAGIC)) == 0 ? 2 : 1;
+		unsigned long header_sz = (version == 2) ? V2_HEADER_LEN : V1_HEADER_LEN;
+		n_bytes = header_sz - sizeof(V2_MAGIC);
+		n = w_recvall(sockfd, &header_buf[sizeof(V2_MAGIC)], &n_bytes);
+		if (n > 0)
+		{
+			assert(n_bytes == header_sz - sizeof(V2_MAGIC));
+			uint16_t flags;
+			uint64_t data_len_l;
+			unpack_header(header_buf, version, flags, data_len_l);
+			SockState &state = get_sock_state(sockfd);
+			if (version == 2)
+			{
+				state.version = 2;
+			}
+			if (type == PackType::REQ_RUNDIR && (V2_TAG == desc || V2_COMPRESS_TAG == desc))
+			{
+				state.version = 2;
+				state.compress = (V2_COMPRESS_TAG == desc);
+			}
+			//get data
+			data_len = (unsigned long)data_len_l;
+			data.resize(data_len, '\0');
+			if (data_len > 0) {
+				n = w_recvall(sockfd, &data[0], &data_len);
+				assert(data_len == data.size());
+			}
+			n_wire_recv += header_sz + data_len;
+			if (n > 0 && flags != 0)
+			{
+				try
+				{
+					decompress_data(state, flags, data);
+				}
+				catch (exception &e)
+				{
+					cerr << e.what() << endl;
+					n = -1;
+				}
+			}
+			n_data_recv += data.size();
+		}
+	}
+	if (n> 1) {n=1;}
+	return n;  // -1 on failure, 0 on a close connection or 1 on success
+}
+
+size_t NetPackage::pack_header(char *buf, int version, uint16_t flags, uint64_t data_len_l) const
+{
 	size_t i_start = 0;
-	//get header (ie size, seq_id, id and name)
-	header_sz = sizeof(buf_sz) + sizeof(type) + sizeof(group) + sizeof(run_id) + sizeof(desc);
-	vector<char> header_buf;
-	header_buf.resize(header_sz, '\0');
-	n = w_recvall(sockfd, &header_buf[0], &header_sz);
-	if(n>0) {
-		assert(header_sz==header_buf.size());
-		i_start = 0;
-		w_memcpy_s(&buf_sz, sizeof(buf_sz), &header_buf[i_start], sizeof(buf_sz));
+	if (version == 2)
+	{
+		memcpy(buf, V2_MAGIC, sizeof(V2_MAGIC));
+		i_start += sizeof(V2_MAGIC);
+		put_le(&buf[i_start], uint16_t(type), 2);
+		i_start += 2;
+		put_le(&buf[i_start], flags, 2);
+		i_start += 2;
+		put_le(&buf[i_start], uint32_t(group), 4);
+		i_start += 4;
+		put_le(&buf[i_start], uint32_t(run_id), 4);
+		i_start += 4;
+		put_le(&buf[i_start], data_len_l, 8);
+		i_start += 8;
+	}
+	else
+	{
+		// the length includes the header
+		unsigned long buf_sz = (unsigned long)(V1_HEADER_LEN + data_len_l);
+		memcpy(&buf[i_start], &buf_sz, sizeof(buf_sz));
 		i_start += sizeof(buf_sz);
-		w_memcpy_s(&type, sizeof(type), &header_buf[i_start], sizeof(type));
+		memcpy(&buf[i_start], &type, sizeof(type));
 		i_start += sizeof(type);
-		w_memcpy_s(&group, sizeof(group), &header_buf[i_start], sizeof(group));
+		memcpy(&buf[i_start], &group, sizeof(group));
 		i_start += sizeof(group);
-		w_memcpy_s(&run_id, sizeof(run_id), &header_buf[i_start], sizeof(run_id));
+		memcpy(&buf[i_start], &run_id, sizeof(run_id));
 		i_start += sizeof(run_id);
-		w_memcpy_s(&desc, sizeof(desc), &header_buf[i_start], sizeof(desc));
-		i_start += sizeof(desc);
-		desc[DESC_LEN-1] = '\0';
-		//get data
-		data_len = buf_sz - i_start;
-		data.resize(data_len, '\0');
-		if (data_len > 0) {
-			n = w_recvall(sockfd, &data[0], &data_len);
-			assert(data_len==buf_sz-header_sz);
-		}
 	}
-	if (n> 1) {n=1;}
-	return n;  // -1 on failure, 0 on a close connection or 1 on success
+	memcpy(&buf[i_start], desc, sizeof(desc));
+	i_start += sizeof(desc);
+	return i_start;
+}
+
+void NetPackage::unpack_header(const char *buf, int version, uint16_t &flags, uint64_t &data_len_l)
+{
+	size_t i_start = 0;
+	flags = 0;
+	if (version == 2)
+	{
+		i_start += sizeof(V2_MAGIC);
+		type = PackType(get_le(&buf[i_start], 2));
+		i_start += 2;
+		flags = uint16_t(get_le(&buf[i_start], 2));
+		i_start += 2;
+		group = int32_t(uint32_t(get_le(&buf[i_start], 4)));
+		i_start += 4;
+		run_id = int32_t(uint32_t(get_le(&buf[i_start], 4)));
+		i_start += 4;
+		data_len_l = get_le(&buf[i_start], 8);
+		i_start += 8;
+	}
+	else
+	{
+		unsigned long buf_sz;
+		memcpy(&buf_sz, &buf[i_start], sizeof(buf_sz));
+		i_start += sizeof(buf_sz);
+		memcpy(&type, &buf[i_start], sizeof(type));
+		i_start += sizeof(type);
+		memcpy(&group, &buf[i_start], sizeof(group));
+		i_start += sizeof(group);
+		memcpy(&run_id, &buf[i_start], sizeof(run_id));
+		i_start += sizeof(run_id);
+		data_len_l = (buf_sz > (unsigned long)V1_HEADER_LEN) ? buf_sz - V1_HEADER_LEN : 0;
+	}
+	memcpy(desc, &buf[i_start], sizeof(desc));
+	desc[DESC_LEN-1] = '\0';
 }
 
 void NetPackage::print_header(std::ostream &fout)
@@ -4,28 +4,89 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <unordered_map>
+#include <atomic>
 
 class NetPackage
 {
 public:
-	enum class PackType{UNKN, OK, CONFIRM_OK, READY, REQ_RUNDIR, RUNDIR, REQ_LINPACK, LINPACK, CMD, START_RUN, RUN_FINISH, RUN_FAILED, TERMINATE,PING,REQ_KILL,IO_ERROR};
+	enum class PackType{UNKN, OK, CONFIRM_OK, READY, REQ_RUNDIR, RUNDIR, REQ_LINPACK, LINPACK, CMD, START_RUN, RUN_FINISH, RUN_FAILED, TERMINATE,PING,REQ_KILL,IO_ERROR,START_RUN_BATCH,REQ_SLAVES,BASE_PARS,START_RUN_DELTA,BASE_OBS,RUN_FINISH_SPARSE};
+	// optional features a slave reports in the LINPACK package
+	static const std::int32_t FEATURE_DELTA_PARS = 1; // understands BASE_PARS and START_RUN_DELTA
+	static const std::int32_t FEATURE_SPARSE_OBS = 2; // understands BASE_OBS and sends RUN_FINISH_SPARSE
 	static int get_new_group_id();
 	NetPackage(PackType _type=PackType::UNKN, int _group=-1, int _run_id=-1, const std::string &desc="");
 	~NetPackage(){}
 	const static int DESC_LEN = 41;
+	// Version 1 headers are the in-memory layout of the header fields, so the size of the length field
+	// depends on the platform.  Version 2 headers start with V2_MAGIC followed by fixed width little-endian
+	// fields.  Packages are received in either format.  A socket is sent version 1 headers until the peer
+	// shows that it understands version 2, either by sending a version 2 package or a REQ_RUNDIR whose
+	// description is V2_TAG.  A peer that sends V2_COMPRESS_TAG instead also asks for large payloads to be
+	// compressed (see compress_data)
+	static const char V2_MAGIC[4];
+	static const std::string V2_TAG;
+	static const std::string V2_COMPRESS_TAG;
+	static const int V2_HEADER_LEN = 4 + 2 + 2 + 4 + 4 + 8 + DESC_LEN;
+	static int get_version(int sockfd);
+	// forget the version and compression state of an earlier connection with the same socket number
+	static void reset_connection(int sockfd);
+	// bytes of package data before compression and bytes sent or received on the sockets including headers
+	class ByteCounts
+	{
+	public:
+		ByteCounts() : data_sent(0), wire_sent(0), data_recv(0), wire_recv(0) {}
+		std::uint64_t data_sent;
+		std::uint64_t wire_sent;
+		std::uint64_t data_recv;
+		std::uint64_t wire_recv;
+	};
+	static ByteCounts get_byte_counts();
 	int send(int sockfd, const void *data, unsigned long data_len_l);
+	// send a package whose data is the concatenation of data_bufs without copying them
+	int send(int sockfd, const std::vector<std::pair<const char*, size_t>> &data_bufs);
 	int recv(int sockfd);
 	void reset(PackType _type, int _group, int _run_id, const std::string &_desc);
 	PackType get_type() const {return type;}
 	int get_run_id() const {return run_id;}
 	int get_groud_id() const {return group;}
+	std::string get_desc() const {return desc;}
 	const std::vector<char> &get_data(){return data;}
 	void print_header(std::ostream &fout);
 	
 
 private:
+	static const int V1_HEADER_LEN;
+	// version 2 header flags describing how the data is compressed
+	static const std::uint16_t FLAG_XOR_REF = 1; // doubles XORed with the reference payload of the connection
+	static const std::uint16_t FLAG_XOR_PREV = 2; // doubles XORed with the previous value
+	static const std::uint16_t FLAG_SET_REF = 4; // uncompressed data that becomes the reference payload
+	static const size_t MIN_COMPRESS_LEN = 1024;
+	class SockState
+	{
+	public:
+		SockState() : version(1), compress(false) {}
+		int version;
+		bool compress;
+		// the last compressed payload sent and received.  Sender and receiver update them in the same way
+		std::vector<char> send_ref;
+		std::vector<char> recv_ref;
+	};
 	unsigned long data_len;
 	static int last_group_id;
+	static std::mutex sock_mutex;
+	static std::unordered_map<int, SockState> sock_map;
+	static std::atomic<std::uint64_t> n_data_sent;
+	static std::atomic<std::uint64_t> n_wire_sent;
+	static std::atomic<std::uint64_t> n_data_recv;
+	static std::atomic<std::uint64_t> n_wire_recv;
+	static SockState &get_sock_state(int sockfd);
+	static std::uint16_t compress_data(SockState &state, const char *raw, size_t raw_len, std::vector<char> &z_data);
+	static void decompress_data(SockState &state, std::uint16_t flags, std::vector<char> &data);
+	size_t pack_header(char *buf, int version, std::uint16_t flags, std::uint64_t data_len_l) const;
+	void unpack_header(const char *buf, int version, std::uint16_t &flags, std::uint64_t &data_len_l);
 	PackType type;
 	int group;
 	int run_id;
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <cstring>
+#include "network_poller.h"
+#include "pest_error.h"
+
+#ifdef OS_LINUX
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+NetPoller::NetPoller(bool _use_epoll) : use_epoll(false), epoll_fd(-1)
+{
+	FD_ZERO(&master);
+#ifdef OS_LINUX
+	if (_use_epoll)
+	{
+		epoll_fd = epoll_create1(0);
+		if (epoll_fd >= 0)
+		{
+			use_epoll = true;
+			events.resize(64);
+		}
+		else
+		{
+			cerr << "epoll_create1 error: " << strerror(errno) << ".  Using select instead" << endl;
+		}
+	}
+#endif
+}
+
+NetPoller::~NetPoller()
+{
+#ifdef OS_LINUX
+	if (epoll_fd >= 0)
+	{
+		close(epoll_fd);
+	}
+#endif
+}
+
+void NetPoller::add(int sockfd)
+{
+#ifdef OS_LINUX
+	if (use_epoll)
+	{
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = sockfd;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd, &ev) != 0)
+		{
+			throw PestError(string("NetPoller: unable to add socket to epoll set: ") + strerror(errno));
+		}
+		sockets.insert(sockfd);
+		return;
+	}
+	if (sockfd >= FD_SETSIZE)
+	{
+		throw PestError("NetPoller: socket descriptor exceeds FD_SETSIZE and can not be used with select");
+	}
+#endif
+	FD_SET(sockfd, &master);
+	sockets.insert(sockfd);
+}
+
+void NetPoller::remove(int sockfd)
+{
+	if (sockets.erase(sockfd) == 0) return;
+#ifdef OS_LINUX
+	if (use_epoll)
+	{
+		// a socket that has already been closed is removed from the epoll set automatically
+		epoll_event ev;
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sockfd, &ev);
+		return;
+	}
+#endif
+	FD_CLR(sockfd, &master);
+}
+
+int NetPoller::wait(int timeout_ms, vector<int> &ready_fds)
+{
+	ready_fds.clear();
+#ifdef OS_LINUX
+	if (use_epoll)
+	{
+		int n = epoll_wait(epoll_fd, events.data(), events.size(), timeout_ms);
+		if (n == -1)
+		{
+			if (errno == EINTR) return 0;
+			cerr << "epoll_wait error: " << strerror(errno) << endl;
+			return -1;
+		}
+		for (int i = 0; i < n; ++i)
+		{
+			ready_fds.push_back(events[i].data.fd);
+		}
+		// more sockets may have been ready than could be returned.  Grow the event buffer so
+		// they are returned on the next call
+		if (size_t(n) == events.size())
+		{
+			events.resize(2 * events.size());
+		}
+		return n;
+	}
+#endif
+	fd_set read_fds = master;
+	timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	int fdmax = sockets.empty() ? 0 : *sockets.rbegin();
+	if (w_select(fdmax + 1, &read_fds, NULL, NULL, &tv) == -1)
+	{
+		return -1;
+	}
+	for (int sockfd : sockets)
+	{
+		if (FD_ISSET(sockfd, &read_fds))
+		{
+			ready_fds.push_back(sockfd);
+		}
+	}
+	return ready_fds.size();
+}
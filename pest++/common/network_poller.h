@@ -0,0 +1,41 @@
+#ifndef NET_POLLER_H_
+#define NET_POLLER_H_
+
+#include <vector>
+#include <set>
+#include "network_wrapper.h"
+#ifdef OS_LINUX
+#include <sys/epoll.h>
+#endif
+
+// NetPoller waits for data to arrive on a set of sockets.  On linux the sockets are monitored with epoll so
+// the cost of a wait is proportional to the number of sockets with data rather than to the largest socket
+// descriptor, and the number of sockets is not limited by FD_SETSIZE.  Other systems, or use_epoll=false,
+// use select.
+class NetPoller
+{
+public:
+	NetPoller(bool _use_epoll=true);
+	~NetPoller();
+	NetPoller(const NetPoller &) = delete;
+	NetPoller& operator=(const NetPoller &) = delete;
+	void add(int sockfd);
+	void remove(int sockfd);
+	bool contains(int sockfd) const { return sockets.find(sockfd) != sockets.end(); }
+	size_t size() const { return sockets.size(); }
+	const std::set<int>& get_sockets() const { return sockets; }
+	bool get_use_epoll() const { return use_epoll; }
+	// wait up to timeout_ms milliseconds for data to arrive.  The sockets with data to be read are
+	// returned in ready_fds.  Returns the number of ready sockets or -1 on failure
+	int wait(int timeout_ms, std::vector<int> &ready_fds);
+private:
+	bool use_epoll;
+	int epoll_fd;
+	std::set<int> sockets;
+	fd_set master;
+#ifdef OS_LINUX
+	std::vector<epoll_event> events;
+#endif
+};
+
+#endif /* NET_POLLER_H_ */
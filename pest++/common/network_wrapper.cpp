@@ -20,6 +20,8 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/select.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include<sys/wait.h>
 #include <errno.h>
 #endif
@@ -88,6 +90,17 @@ vector<string> w_getnameinfo_vec(int sockfd, int flags)
 	return name_info;
 }
 
+string w_gethostname()
+{
+	char host[256];
+	if (gethostname(host, sizeof host) != 0)
+	{
+		return string("localhost");
+	}
+	host[sizeof host - 1] = '\0';
+	return string(host);
+}
+
 int w_socket(int domain, int type, int protocol)
 {
 	int sockfd = socket(domain, type, protocol);
@@ -178,6 +191,89 @@ int w_sendall(int sockfd, char *buf, unsigned long *len)
 	return n; // return -1 on failure, 0 closed connection or 1 on success
 }
 
+int w_sendallv(int sockfd, const vector<pair<const char*, size_t>> &bufs)
+{
+	int n = 1;
+#ifdef OS_WIN
+	vector<WSABUF> iov;
+	for (const auto &b : bufs)
+	{
+		if (b.second == 0) continue;
+		WSABUF wbuf;
+		wbuf.buf = const_cast<char*>(b.first);
+		wbuf.len = (ULONG)b.second;
+		iov.push_back(wbuf);
+	}
+	size_t i_iov = 0;
+	while (i_iov < iov.size())
+	{
+		DWORD n_sent = 0;
+		if (WSASend(sockfd, &iov[i_iov], (DWORD)(iov.size() - i_iov), &n_sent, 0, NULL, NULL) != 0)
+		{
+			n = -1;
+			break;
+		}
+		if (n_sent == 0) { n = 0; break; } //connection closed
+		// skip the buffers that were sent completely and advance into a partially sent one
+		while (n_sent > 0 && i_iov < iov.size())
+		{
+			if (n_sent >= iov[i_iov].len)
+			{
+				n_sent -= iov[i_iov].len;
+				++i_iov;
+			}
+			else
+			{
+				iov[i_iov].buf += n_sent;
+				iov[i_iov].len -= n_sent;
+				n_sent = 0;
+			}
+		}
+	}
+#endif
+#ifdef OS_LINUX
+	vector<iovec> iov;
+	for (const auto &b : bufs)
+	{
+		if (b.second == 0) continue;
+		iovec v;
+		v.iov_base = const_cast<char*>(b.first);
+		v.iov_len = b.second;
+		iov.push_back(v);
+	}
+	size_t i_iov = 0;
+	while (i_iov < iov.size())
+	{
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov[i_iov];
+		msg.msg_iovlen = min(iov.size() - i_iov, size_t(IOV_MAX));
+		ssize_t n_sent = sendmsg(sockfd, &msg, 0);
+		if (n_sent == -1) { n = -1; break; }  //error
+		if (n_sent == 0) { n = 0; break; } //connection closed
+		// skip the buffers that were sent completely and advance into a partially sent one
+		size_t n_left = n_sent;
+		while (n_left > 0 && i_iov < iov.size())
+		{
+			if (n_left >= iov[i_iov].iov_len)
+			{
+				n_left -= iov[i_iov].iov_len;
+				++i_iov;
+			}
+			else
+			{
+				iov[i_iov].iov_base = static_cast<char*>(iov[i_iov].iov_base) + n_left;
+				iov[i_iov].iov_len -= n_left;
+				n_left = 0;
+			}
+		}
+	}
+#endif
+	if (n < 0){
+		cerr << "w_sendallv error: " << w_get_error_msg() << endl;
+	}
+	return n; // return -1 on failure, 0 closed connection or 1 on success
+}
 
 int w_recvall(int sockfd, char *buf, unsigned long *len)
 {
@@ -307,6 +403,60 @@ int w_select(int numfds, fd_set *readfds, fd_set *writefds,
 	return n;
 }
 
+int w_socketpair(int sv[2])
+{
+	sv[0] = -1;
+	sv[1] = -1;
+#ifdef OS_WIN
+	// winsock has no socketpair, so connect two sockets through the loopback interface
+	int n = -1;
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == INVALID_SOCKET)
+	{
+		cerr << "socketpair error: " << w_get_error_msg() << endl;
+		return -1;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addr_len = sizeof(addr);
+	if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) == 0
+		&& getsockname(listener, (struct sockaddr*)&addr, &addr_len) == 0
+		&& listen(listener, 1) == 0)
+	{
+		SOCKET s0 = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (s0 != INVALID_SOCKET && connect(s0, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+		{
+			SOCKET s1 = accept(listener, NULL, NULL);
+			if (s1 != INVALID_SOCKET)
+			{
+				sv[0] = (int)s0;
+				sv[1] = (int)s1;
+				n = 0;
+			}
+		}
+		if (n != 0 && s0 != INVALID_SOCKET) closesocket(s0);
+	}
+	closesocket(listener);
+	if (n != 0)
+	{
+		cerr << "socketpair error: " << w_get_error_msg() << endl;
+	}
+	return n;
+#endif
+#ifdef OS_LINUX
+	int n = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	if (n != 0)
+	{
+		cerr << "socketpair error: " << w_get_error_msg() << endl;
+		n = -1;
+	}
+	return n;
+#endif
+}
+
 int w_memcpy_s(void *dest, size_t numberOfElements, const void *src, size_t count)
 {
 	int err = 0;
@@ -360,185 +510,3 @@ void w_sleep(int millisec)
    #endif
 }
 
-
-#ifdef OS_WIN
-PROCESS_INFORMATION start_command(string &cmd_string)
-{
-	char* cmd_line = _strdup(cmd_string.c_str());
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
-	ZeroMemory(&si, sizeof(si));
-	ZeroMemory(&pi, sizeof(pi));
-	if (!CreateProcess(NULL, cmd_line, NULL, NULL, false, 0, NULL, NULL, &si, &pi))
-	{
-		std::string cmd_string(cmd_line);
-		throw std::runtime_error("CreateProcess() failed for command: " + cmd_string);
-	}
-	return pi;
-}
-#endif
-
-
-#ifdef OS_LINUX
-int start_command(string &cmd_string)
-{
-	//split cmd_string on whitespaces
-	stringstream cmd_ss(cmd_string);
-	string cmd;
-	vector<string> cmds;
-	while (getline(cmd_ss,cmd))
-	{
-		cmds.push_back(cmd);
-	}
-	//create the strurture for execv
-	vector<char const*> arg_v;
-	for (size_t icmd=0; icmd<cmds.size(); ++icmd)
-	  {
-	    arg_v.push_back(cmds[icmd].data());
-	  }
-	//char * const*argv = new char* [cmds.size()+1];
-	//for (size_t icmd=0; icmd<cmds.size(); ++icmd)
-	//{
-	//  argv[icmd] = cmds[icmd].data();
-	//}
-	//argv[cmds.size() + 1] = NULL; //last arg must be NULL
-		arg_v.push_back(NULL);
-	      	
-	pid_t pid = fork();
-	if (pid == 0)
-	{
-	  setpgid(0,0);
-	  int success = execv(arg_v[0], const_cast<char* const*>(&(arg_v[0])));
-	     if (success == -1)
-	     {
-	       throw std::runtime_error("execv() failed for command: " + cmd_string);
-	     }
-	}
-	else
-	{ 
-	  setpgid(pid,pid);
-	}
-	return pid;
-}
-
-#endif
-
-
-void w_run_commands(pest_utils::thread_flag* terminate, pest_utils::thread_flag* finished, vector<string> commands)
-{
-#ifdef OS_WIN
-	//a flag to track if the run was terminated
-	bool term_break = false;
-	//create a job object to track child and grandchild process
-	HANDLE job = CreateJobObject(NULL, NULL);
-	if (job == NULL) throw PestError("could not create job object handle");
-	JOBOBJECT_EXTENDED_LIMIT_INFORMATION jeli = { 0 };
-	jeli.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
-	if (0 == SetInformationJobObject(job, JobObjectExtendedLimitInformation, &jeli, sizeof(jeli)))
-	{
-		throw PestError("could not assign job limit flag to job object");
-	}
-	for (auto &cmd_string : commands)
-	{		
-		//start the command
-		PROCESS_INFORMATION pi;
-		try
-		{
-			pi = start_command(cmd_string);
-		}
-		catch (...)
-		{
-			finished->set(true);
-			throw std::runtime_error("start_command() failed for command: " + cmd_string);
-		}
-		if (0 == AssignProcessToJobObject(job, pi.hProcess))
-		{
-			throw PestError("could not add process to job object: " + cmd_string);
-		}
-		DWORD exitcode;
-		while (true)
-		{
-			//sleep			
-			std::this_thread::sleep_for(std::chrono::milliseconds(OperSys::thread_sleep_milli_secs));
-			//check if process is still active
-			GetExitCodeProcess(pi.hProcess, &exitcode);
-			//if the process ended, break
-			if (exitcode != STILL_ACTIVE)
-			{
-				break;
-			}
-			//check for termination flag
-			if (terminate->get())
-			{
-				std::cout << "recieved terminate signal" << std::endl;
-				//try to kill the process
-				bool success = CloseHandle(job);
-				//bool success = TerminateProcess(pi.hProcess, 0);
-				if (!success)
-				{
-					finished->set(true);
-					throw std::runtime_error("unable to terminate process for command: " + cmd_string);
-				}
-				term_break = true;
-				break;
-			}
-		}
-		//jump out of the for loop if terminated
-		if (term_break) break;
-	}
-	//set the finished flag for the listener thread
-	finished->set(true);
-	return;
-
-#endif
-
-#ifdef OS_LINUX
-	//a flag to track if the run was terminated
-	bool term_break = false;
-	for (auto &cmd_string : commands)
-	{		
-		//start the command
-		int command_pid = start_command(cmd_string);
-		while (true)
-		{
-			//sleep
-			std::this_thread::sleep_for(std::chrono::milliseconds(OperSys::thread_sleep_milli_secs));
-			//check if process is still active
-			int status;
-			pid_t exit_code = waitpid(command_pid, &status, WNOHANG);
-			//if the process ended, break
-			if (exit_code == -1)
-			{
-				finished->set(true);
-				throw std::runtime_error("waitpid() returned error status for command: " + cmd_string);
-			}
-			else if (exit_code != 0)
-			{
-				break;
-			}
-			//check for termination flag
-			if (terminate->get())
-			{
-				std::cout << "recieved terminate signal" << std::endl;
-				//try to kill the process
-				errno = 0;
-				int success = kill(-command_pid, SIGKILL);
-				if (success == -1)
-				{
-					finished->set(true);
-					throw std::runtime_error("unable to terminate process for command: " + cmd_string);
-				}
-				term_break = true;
-				break;
-			}
-		}
-		//jump out of the for loop if terminated
-		if (term_break) break;
-	}
-	//set the finished flag for the listener thread
-	finished->set(true);
-	return;
-#endif
-
-}
-
@@ -27,6 +27,7 @@ void w_init();
 int w_close(int sockfd);
 void w_cleanup();
 std::vector<std::string> w_getnameinfo_vec(int sockfd, int flags=0);
+std::string w_gethostname();
 int w_getaddrinfo(const char *node, const char *service,
 			  const struct addrinfo *hints, struct addrinfo **res);
 int w_socket(int domain, int type, int protocol);
@@ -36,10 +37,16 @@ int w_listen(int sockfd, int backlog);
 int w_accept(int sockfd, struct sockaddr *addr, socklen_t *addr_len);
 int w_send(int sockfd, char *buf, size_t len, int flags);
 int w_sendall(int sockfd, char *buf, unsigned long *len);
+// send the buffers one after the other using scatter/gather I/O so they do not have to be copied into a
+// single buffer first.  Returns -1 on failure, 0 on a closed connection or 1 on success
+int w_sendallv(int sockfd, const std::vector<std::pair<const char*, size_t>> &bufs);
 int w_recv(int sockfd, char *buf, size_t len, int flags);
 int w_recvall(int sockfd, char *buf, unsigned long *len);
 int w_select(int numfds, fd_set *readfds, fd_set *writefds,
 		   fd_set *exceptfds, struct timeval *timeout);
+// create a pair of connected sockets that can be added to a select set.  A thread writes to sv[1] to wake
+// up another thread waiting in select on sv[0].  Returns 0 on success and -1 on failure
+int w_socketpair(int sv[2]);
 int w_memcpy_s(void *dest, size_t number_of_elements, const void *src, size_t count);
 addrinfo* w_bind_first_avl(addrinfo *servinfo, int &sockfd);
 addrinfo* w_connect_first_avl(addrinfo *servinfo, int &sockfd);
@@ -47,6 +54,5 @@ void w_print_servinfo(struct addrinfo *res, std::ostream &fout);
 std::string w_get_addrinfo_string(struct addrinfo *p);
 std::string w_get_error_msg();
 void w_sleep(int millisec);
-void w_run_commands(pest_utils::thread_flag* terminate, pest_utils::thread_flag* finished, vector<string> commands);
 #endif /* NETWORK_H_ */
 
@@ -20,14 +20,21 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <fstream>
+#include <cstdlib>
 #include "system_variables.h"
+#include "pest_error.h"
 
 #ifdef OS_WIN
  #include <direct.h>
+ #include <windows.h>
 #endif
 
 #ifdef OS_LINUX
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #endif
 
 #ifdef OS_WIN
@@ -111,3 +118,146 @@ bool OperSys::double_is_invalid(double x)
   return test;
 #endif
 }
+
+bool OperSys::is_absolute_path(const std::string &path)
+{
+	if (path.empty()) return false;
+	if (path[0] == '/' || path[0] == '\\') return true;
+#ifdef OS_WIN
+	if (path.size() > 1 && path[1] == ':') return true;
+#endif
+	return false;
+}
+
+void OperSys::mkdir(const std::string &dir_name)
+{
+#ifdef OS_WIN
+	if (!CreateDirectoryA(dir_name.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		throw PestError("unable to create directory: " + dir_name);
+	}
+#endif
+#ifdef OS_LINUX
+	struct stat st;
+	if (::mkdir(dir_name.c_str(), 0755) != 0 && !(stat(dir_name.c_str(), &st) == 0 && S_ISDIR(st.st_mode)))
+	{
+		throw PestError("unable to create directory: " + dir_name);
+	}
+#endif
+}
+
+void OperSys::copy_dir(const std::string &src_dir, const std::string &dest_dir, const std::string &skip_prefix,
+	const std::set<std::string> &skip_names)
+{
+	mkdir(dest_dir);
+#ifdef OS_WIN
+	WIN32_FIND_DATAA find_data;
+	HANDLE h_find = FindFirstFileA((src_dir + DIR_SEP + "*").c_str(), &find_data);
+	if (h_find == INVALID_HANDLE_VALUE)
+	{
+		throw PestError("unable to read directory: " + src_dir);
+	}
+	do
+	{
+		string name(find_data.cFileName);
+		if (name == "." || name == ".." || (!skip_prefix.empty() && name.compare(0, skip_prefix.size(), skip_prefix) == 0)
+			|| skip_names.count(name) > 0)
+		{
+			continue;
+		}
+		string src_name = src_dir + DIR_SEP + name;
+		string dest_name = dest_dir + DIR_SEP + name;
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			copy_dir(src_name, dest_name);
+		}
+		else if (!CopyFileA(src_name.c_str(), dest_name.c_str(), false))
+		{
+			FindClose(h_find);
+			throw PestError("unable to copy file: " + src_name + " to " + dest_name);
+		}
+	} while (FindNextFileA(h_find, &find_data));
+	FindClose(h_find);
+#endif
+#ifdef OS_LINUX
+	DIR *dir = opendir(src_dir.c_str());
+	if (dir == NULL)
+	{
+		throw PestError("unable to read directory: " + src_dir);
+	}
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		string name(entry->d_name);
+		if (name == "." || name == ".." || (!skip_prefix.empty() && name.compare(0, skip_prefix.size(), skip_prefix) == 0)
+			|| skip_names.count(name) > 0)
+		{
+			continue;
+		}
+		string src_name = src_dir + DIR_SEP + name;
+		string dest_name = dest_dir + DIR_SEP + name;
+		struct stat st;
+		if (stat(src_name.c_str(), &st) != 0)
+		{
+			continue;
+		}
+		if (S_ISDIR(st.st_mode))
+		{
+			copy_dir(src_name, dest_name);
+			continue;
+		}
+		ifstream fin(src_name.c_str(), ios::binary);
+		ofstream fout(dest_name.c_str(), ios::binary | ios::trunc);
+		if (!fin || !fout || (st.st_size > 0 && !(fout << fin.rdbuf())))
+		{
+			closedir(dir);
+			throw PestError("unable to copy file: " + src_name + " to " + dest_name);
+		}
+		fout.close();
+		// keep the permissions so model executables can still be run from the copy
+		chmod(dest_name.c_str(), st.st_mode & 07777);
+	}
+	closedir(dir);
+#endif
+}
+
+string OperSys::cpu_model()
+{
+	string model;
+#ifdef OS_WIN
+	const char *env = std::getenv("PROCESSOR_IDENTIFIER");
+	if (env != nullptr) model = env;
+#endif
+#ifdef OS_LINUX
+	ifstream fin("/proc/cpuinfo");
+	string line;
+	while (getline(fin, line))
+	{
+		if (line.compare(0, 10, "model name") == 0)
+		{
+			size_t i = line.find(':');
+			if (i != string::npos) model = line.substr(i + 1);
+			break;
+		}
+	}
+#endif
+	return model;
+}
+
+string OperSys::temp_dir()
+{
+#ifdef OS_WIN
+	const char *env_names[] = { "TEMP", "TMP" };
+	string default_dir = ".";
+#endif
+#ifdef OS_LINUX
+	const char *env_names[] = { "TMPDIR", "TMP" };
+	string default_dir = "/tmp";
+#endif
+	for (const char *name : env_names)
+	{
+		const char *env = std::getenv(name);
+		if (env != nullptr && env[0] != '\0') return env;
+	}
+	return default_dir;
+}
@@ -21,6 +21,7 @@
 
 #include "config_os.h"
 #include <string>
+#include <set>
 
 class OperSys
 {
@@ -34,6 +35,17 @@ public:
 	static void chdir(const char *str);
 	static char *gets_s(char *str, size_t len);
 	static bool double_is_invalid(double x);
+	static bool is_absolute_path(const std::string &path);
+	// create directory dir_name if it does not already exist
+	static void mkdir(const std::string &dir_name);
+	// copy the files and subdirectories of src_dir to dest_dir.  Entries of src_dir whose names start with
+	// skip_prefix or are in skip_names are not copied
+	static void copy_dir(const std::string &src_dir, const std::string &dest_dir, const std::string &skip_prefix="",
+		const std::set<std::string> &skip_names=std::set<std::string>());
+	// description of the processor model.  Returns an empty string if it is not available
+	static std::string cpu_model();
+	// directory for temporary files shared by all processes on this computer
+	static std::string temp_dir();
 	
 };
 
@@ -0,0 +1,82 @@
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+// TimerWheel is a hashed timing wheel.  Items are placed in the slot corresponding to their due time and
+// expire() only visits the slots whose time has passed, so the cost of checking for expired items is
+// proportional to the elapsed time and the number of items in the visited slots rather than to the total
+// number of items.  Items due more than one revolution of the wheel in the future stay in their slot
+// until their revolution comes around.  There is no cancel operation; owners should check that an expired
+// item is still relevant.
+template <class T>
+class TimerWheel
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	TimerWheel(std::chrono::milliseconds _resolution = std::chrono::milliseconds(100), size_t n_slots = 1024)
+		: slots(n_slots), resolution(_resolution), start_time(Clock::now()), cur_tick(0), n_items(0) {}
+	void schedule(const T &item, Clock::time_point due)
+	{
+		long long tick = std::max(get_tick(due), cur_tick);
+		slots[tick % slots.size()].push_back(Entry(due, item));
+		++n_items;
+	}
+	void schedule_in(const T &item, Clock::duration delay)
+	{
+		schedule(item, Clock::now() + delay);
+	}
+	// append the items due at or before now to expired_vec
+	void expire(Clock::time_point now, std::vector<T> &expired_vec)
+	{
+		long long now_tick = get_tick(now);
+		long long n_ticks = std::min(now_tick - cur_tick + 1, (long long)slots.size());
+		for (long long i = 0; i < n_ticks; ++i)
+		{
+			std::vector<Entry> &slot = slots[(cur_tick + i) % slots.size()];
+			size_t n_keep = 0;
+			for (size_t j = 0; j < slot.size(); ++j)
+			{
+				if (slot[j].due <= now)
+				{
+					expired_vec.push_back(slot[j].item);
+					--n_items;
+				}
+				else
+				{
+					slot[n_keep++] = slot[j];
+				}
+			}
+			slot.erase(slot.begin() + n_keep, slot.end());
+		}
+		cur_tick = std::max(cur_tick, now_tick);
+	}
+	size_t size() const { return n_items; }
+	void clear()
+	{
+		for (auto &slot : slots) slot.clear();
+		n_items = 0;
+	}
+private:
+	class Entry
+	{
+	public:
+		Entry(Clock::time_point _due, const T &_item) : due(_due), item(_item) {}
+		Clock::time_point due;
+		T item;
+	};
+	std::vector<std::vector<Entry>> slots;
+	std::chrono::milliseconds resolution;
+	Clock::time_point start_time;
+	long long cur_tick;
+	size_t n_items;
+	long long get_tick(Clock::time_point t) const
+	{
+		if (t <= start_time) return 0;
+		return std::chrono::duration_cast<std::chrono::milliseconds>(t - start_time).count() / resolution.count();
+	}
+};
+
+#endif /* TIMER_WHEEL_H_ */
@@ -0,0 +1,824 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "instruction_reader.h"
+#include "iopp.h"
+
+using namespace std;
+
+namespace
+{
+	// observation names are compared in lower case with at most this many characters, as in readins
+	const size_t MAX_NAME_LEN = 50;
+
+	// first occurrence of text in [begin, end).  Like the fortran INDEX function an empty text is found at
+	// the start
+	const char *find_text(const char *begin, const char *end, const char *text, size_t len)
+	{
+		if (len == 0) return begin;
+		while (end - begin >= (ptrdiff_t)len)
+		{
+			const char *p = (const char*)memchr(begin, text[0], end - begin - len + 1);
+			if (p == nullptr) return nullptr;
+			if (memcmp(p + 1, text + 1, len - 1) == 0) return p;
+			begin = p + 1;
+		}
+		return nullptr;
+	}
+
+	// replace the tabs in line (llen characters padded with blanks) with blanks up to the next multiple of
+	// 8 columns, in the same way as the fortran TABREP routine
+	void expand_tabs(char *line, int llen)
+	{
+		int nblc = llen;
+		while (nblc > 0 && line[nblc - 1] == ' ') --nblc;
+		for (int i = 1; i <= nblc; ++i)
+		{
+			if (line[i - 1] != '\t') continue;
+			int tab_end = ((i - 1) / 8 + 1) * 8;
+			int j = tab_end - i;
+			line[i - 1] = ' ';
+			if (j == 0) continue;
+			nblc = min(nblc + j, llen);
+			for (int k = nblc; k >= tab_end; --k)
+			{
+				line[k - 1] = line[k - j - 1];
+			}
+			for (int k = i + 1; k <= min(nblc, i + j); ++k)
+			{
+				line[k - 1] = ' ';
+			}
+			i += j;
+		}
+	}
+
+	int len_trim(const char *text, size_t len)
+	{
+		while (len > 0 && text[len - 1] == ' ') --len;
+		return len;
+	}
+
+	void to_lower(string &s)
+	{
+		for (auto &c : s)
+		{
+			if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+		}
+	}
+
+	string obs_key(const string &name)
+	{
+		string key = name.substr(0, MAX_NAME_LEN);
+		to_lower(key);
+		return key;
+	}
+
+	InstructionFileError read_error(const string &reason, const string &out_filename, bool exists, size_t out_line,
+		const string &ins_filename, int ins_line, const string &ins_text)
+	{
+		ostringstream ss;
+		ss << reason << " in model output file " << out_filename;
+		if (!exists) ss << " (file not found)";
+		else if (out_line > 0) ss << " at line " << out_line;
+		ss << ", instruction file " << ins_filename << " line " << ins_line << ": " << ins_text;
+		return InstructionFileError(ss.str());
+	}
+}
+
+// model output file held in memory and the state of the instructions being executed on it.  As in
+// readins, the current line and the position in it are kept from one output file to the next
+class InstructionReader::ReadState
+{
+public:
+	ReadState() : exists(false), pos(0), line_start(NO_LINE), line(""), nblc(0), j1(0), mrktyp(0), almark(1), begins(0) {}
+	static const size_t NO_LINE = numeric_limits<size_t>::max();
+	bool exists;
+	vector<char> data;
+	size_t pos; // start of the next line
+	size_t line_start; // start of the current line, NO_LINE if no line of this file has been read
+	// current line with tabs expanded, at most MAX_LINE_LEN characters.  Columns are numbered from 1 and
+	// the columns after nblc are blank
+	const char *line;
+	int nblc;
+	int j1; // column of the last character processed
+	int mrktyp; // 0 if the next marker is a primary marker
+	int almark; // 1 if only markers have been processed since the start of the instruction line
+	int begins; // 1 if the search for the primary marker of a continued line is restarted
+	char at(int col) const { return (col <= nblc) ? line[col - 1] : ' '; }
+	void load(const string &filename)
+	{
+		// the current line is copied as data is about to be replaced
+		memcpy(carry, line, nblc);
+		line = carry;
+		data.clear();
+		pos = 0;
+		line_start = NO_LINE;
+		FILE *fin = fopen(filename.c_str(), "rb");
+		exists = (fin != nullptr);
+		if (!exists) return;
+		const size_t block_size = 1 << 20;
+		size_t n_read;
+		do
+		{
+			size_t old_size = data.size();
+			data.resize(old_size + block_size);
+			n_read = fread(data.data() + old_size, 1, block_size, fin);
+			data.resize(old_size + n_read);
+		} while (n_read == block_size);
+		fclose(fin);
+	}
+	bool skip_line()
+	{
+		const char *start;
+		size_t len;
+		return next_line(start, len);
+	}
+	bool read_line()
+	{
+		const char *start;
+		size_t len;
+		if (!next_line(start, len)) return false;
+		if (len > MAX_LINE_LEN) len = MAX_LINE_LEN;
+		if (memchr(start, '\t', len) != nullptr)
+		{
+			memcpy(expanded, start, len);
+			memset(expanded + len, ' ', MAX_LINE_LEN - len);
+			expand_tabs(expanded, MAX_LINE_LEN);
+			line = expanded;
+			len = MAX_LINE_LEN;
+		}
+		else
+		{
+			line = start;
+		}
+		nblc = len_trim(line, len);
+		return true;
+	}
+	// read lines until one contains mark.  Returns the column of the last character of the marker in
+	// col, or false at the end of the file
+	bool find_primary(const char *mark, size_t len, int &col)
+	{
+		// a marker without blanks can only be found where its text is in the file, so the lines in
+		// between are skipped without being read
+		bool search_file = (len > 0 && memchr(mark, ' ', len) == nullptr);
+		while (true)
+		{
+			if (search_file)
+			{
+				const char *begin = data.data() + pos;
+				const char *hit = find_text(begin, data.data() + data.size(), mark, len);
+				if (hit == nullptr) return false;
+				while (hit > begin && hit[-1] != '\n') --hit;
+				pos = hit - data.data();
+			}
+			if (!read_line()) return false;
+			int i = find_padded(mark, len);
+			if (i > 0)
+			{
+				col = i + len - 1;
+				return true;
+			}
+		}
+	}
+	size_t line_num() const
+	{
+		if (line_start == NO_LINE) return 0;
+		return count(data.begin(), data.begin() + line_start, '\n') + 1;
+	}
+private:
+	char expanded[MAX_LINE_LEN];
+	char carry[MAX_LINE_LEN];
+	bool next_line(const char *&start, size_t &len)
+	{
+		if (pos >= data.size()) return false;
+		line_start = pos;
+		start = data.data() + pos;
+		const char *nl = (const char*)memchr(start, '\n', data.size() - pos);
+		if (nl == nullptr)
+		{
+			len = data.size() - pos;
+			pos = data.size();
+		}
+		else
+		{
+			len = nl - start;
+			pos += len + 1;
+			if (len > 0 && start[len - 1] == '\r') --len;
+		}
+		return true;
+	}
+	// column of mark in the current line padded with blanks to MAX_LINE_LEN characters, or 0
+	int find_padded(const char *mark, size_t len) const
+	{
+		const char *hit = find_text(line, line + nblc, mark, len);
+		if (hit != nullptr) return hit - line + 1;
+		// a marker ending in blanks can match at the end of the line
+		for (int i = max(1, nblc - (int)len + 2); i <= (int)(MAX_LINE_LEN - len) + 1; ++i)
+		{
+			size_t k = 0;
+			while (k < len && at(i + k) == mark[k]) ++k;
+			if (k == len) return i;
+			if (i > nblc) break;
+		}
+		return 0;
+	}
+};
+
+bool InstructionReader::read_int(const char *p, size_t w, int &val)
+{
+	// a field width of 0 is not allowed
+	if (w == 0) return false;
+	while (w > 0 && *p == ' ')
+	{
+		++p;
+		--w;
+	}
+	if (w == 0)
+	{
+		val = 0;
+		return true;
+	}
+	bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+	{
+		++p;
+		if (--w == 0) return false;
+	}
+	long long max_val = numeric_limits<int>::max() + (negative ? 1LL : 0LL);
+	long long value = 0;
+	bool seen_digit = false;
+	for (; w > 0; ++p, --w)
+	{
+		if (*p == ' ') continue;
+		if (*p < '0' || *p > '9') return false;
+		value = value * 10 + (*p - '0');
+		if (value > max_val) return false;
+		seen_digit = true;
+	}
+	if (!seen_digit) return false;
+	val = (int)(negative ? -value : value);
+	return true;
+}
+
+bool InstructionReader::read_real(const char *p, size_t w, double &val)
+{
+	if (w == 0) return false;
+	while (w > 0 && *p == ' ')
+	{
+		++p;
+		--w;
+	}
+	if (w == 0)
+	{
+		val = 0;
+		return true;
+	}
+	// the number is rewritten without blanks for strtod, unless it can be converted exactly with a
+	// single multiplication or division
+	char buf[MAX_LINE_LEN + 16];
+	char *out = buf;
+	bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+	{
+		if (negative) *(out++) = '-';
+		++p;
+		--w;
+	}
+	while (w > 0 && *p == ' ')
+	{
+		++p;
+		--w;
+	}
+	if (w == 0)
+	{
+		val = 0;
+		return true;
+	}
+	if (w >= 3 && (*p == 'i' || *p == 'I' || *p == 'n' || *p == 'N'))
+	{
+		// infinity or nan, with an optional string in brackets after nan.  Trailing blanks are ignored
+		string word;
+		int n_paren = 0;
+		bool blank = false;
+		for (; w > 0; ++p, --w)
+		{
+			char c = *p;
+			if (c == ' ')
+			{
+				if (n_paren == 1) return false;
+				blank = true;
+			}
+			else if (c == '(') ++n_paren;
+			else if (c == ')')
+			{
+				if (n_paren++ != 1) return false;
+			}
+			else if (!isalnum((unsigned char)c)) return false;
+			if (!blank && n_paren == 0) word += tolower((unsigned char)c);
+		}
+		if (n_paren != 0 && n_paren != 2) return false;
+		if (word == "inf" || word == "infinity")
+		{
+			if (n_paren != 0) return false;
+			val = negative ? -numeric_limits<double>::infinity() : numeric_limits<double>::infinity();
+			return true;
+		}
+		if (word != "nan") return false;
+		val = negative ? -numeric_limits<double>::quiet_NaN() : numeric_limits<double>::quiet_NaN();
+		return true;
+	}
+	bool seen_dp = false;
+	bool seen_int_digits = false;
+	bool seen_dec_digits = false;
+	uint64_t mant = 0;
+	int n_sig = 0;
+	int mant_exp = 0;
+	int exponent = 0;
+	bool has_exponent = false;
+	for (; w > 0; ++p, --w)
+	{
+		char c = *p;
+		if (c == '.')
+		{
+			if (seen_dp) return false;
+			if (!seen_int_digits) *(out++) = '0';
+			*(out++) = '.';
+			seen_dp = true;
+		}
+		else if (c >= '0' && c <= '9')
+		{
+			*(out++) = c;
+			if (seen_dp) seen_dec_digits = true;
+			else seen_int_digits = true;
+			if (mant == 0 && c == '0')
+			{
+				if (seen_dp) --mant_exp;
+			}
+			else if (n_sig < 19)
+			{
+				mant = mant * 10 + (c - '0');
+				++n_sig;
+				if (seen_dp) --mant_exp;
+			}
+			else
+			{
+				n_sig = 20;
+			}
+		}
+		else if (c == '+' || c == '-')
+		{
+			has_exponent = true;
+			break;
+		}
+		else if (c == 'e' || c == 'E' || c == 'd' || c == 'D' || c == 'q' || c == 'Q')
+		{
+			++p;
+			--w;
+			has_exponent = true;
+			break;
+		}
+		else if (c != ' ')
+		{
+			return false;
+		}
+	}
+	if (has_exponent)
+	{
+		while (w > 0 && *p == ' ')
+		{
+			++p;
+			--w;
+		}
+		if (w == 0) return false;
+		int exp_sign = 1;
+		if (*p == '-' || *p == '+')
+		{
+			if (*p == '-') exp_sign = -1;
+			++p;
+			--w;
+		}
+		bool seen_digit = false;
+		for (; w > 0; ++p, --w)
+		{
+			if (*p == ' ') continue;
+			if (*p < '0' || *p > '9') return false;
+			exponent = min(exponent * 10 + (*p - '0'), 100000);
+			seen_digit = true;
+		}
+		if (!seen_digit) return false;
+		exponent *= exp_sign;
+		if (exponent >= 10000 || exponent <= -10000) return false;
+	}
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+		1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	int exp10 = mant_exp + exponent;
+	if (n_sig <= 19 && mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+	{
+		// both operands are exact so the result is correctly rounded, as from strtod
+		double v = (double)mant;
+		v = (exp10 < 0) ? v / pow10[-exp10] : v * pow10[exp10];
+		val = negative ? -v : v;
+		return true;
+	}
+	if (seen_dp && !seen_dec_digits) *(out++) = '0';
+	else if (!seen_int_digits && !seen_dec_digits) *(out++) = '0';
+	if (exponent != 0) out += sprintf(out, "e%d", exponent);
+	*out = '\0';
+	val = strtod(buf, nullptr);
+	return true;
+}
+
+InstructionReader::InstructionReader(const vector<string> &_ins_filenames, const vector<string> &_obs_names)
+	: ins_filenames(_ins_filenames), obs_names(_obs_names), files(_ins_filenames.size())
+{
+	unordered_map<string, int> name_map;
+	for (size_t i = 0; i < obs_names.size(); ++i)
+	{
+		name_map.emplace(obs_key(obs_names[i]), i);
+	}
+	vector<bool> obs_read(obs_names.size(), false);
+	for (size_t i = 0; i < ins_filenames.size(); ++i)
+	{
+		compile(ins_filenames[i], name_map, obs_read, files[i]);
+	}
+	for (size_t i = 0; i < obs_names.size(); ++i)
+	{
+		if (!obs_read[i])
+		{
+			throw InstructionFileError("observation " + obs_names[i] + " is not read by any instruction file");
+		}
+	}
+}
+
+void InstructionReader::compile(const string &ins_filename, const unordered_map<string, int> &name_map,
+	vector<bool> &obs_read, CompiledFile &file)
+{
+	ifstream fin(ins_filename, ios::binary);
+	if (!fin)
+	{
+		throw InstructionFileError("instruction file " + ins_filename + " does not exist");
+	}
+	stringstream ss;
+	ss << fin.rdbuf();
+	const string contents = ss.str();
+	size_t line_start = 0;
+	int line_num = 0;
+	bool header = true;
+	bool first_line = true;
+	string line;
+	while (line_start < contents.size())
+	{
+		size_t line_end = contents.find('\n', line_start);
+		if (line_end == string::npos) line_end = contents.size();
+		line.assign(contents, line_start, line_end - line_start);
+		line_start = line_end + 1;
+		++line_num;
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.size() > MAX_LINE_LEN) line.resize(MAX_LINE_LEN);
+		replace(line.begin(), line.end(), '\t', ' ');
+		if (header)
+		{
+			// "pif" or "jif" with the marker character in column 5
+			string ftyp = line.substr(0, 3);
+			to_lower(ftyp);
+			if (ftyp != "pif" && ftyp != "jif")
+			{
+				throw InstructionFileError("illegal header in instruction file " + ins_filename);
+			}
+			if (line.size() < 5 || line[4] == ' ')
+			{
+				throw InstructionFileError("marker delimiter not specified in instruction file " + ins_filename);
+			}
+			file.marker = line[4];
+			header = false;
+			continue;
+		}
+		line.resize(len_trim(line.data(), line.size()));
+		if (line.empty()) continue;
+		auto ins_error = [&](const string &reason)
+		{
+			ostringstream ss;
+			ss << reason << " in instruction file " << ins_filename << " line " << line_num << ": " << line;
+			return InstructionFileError(ss.str());
+		};
+		file.lines.push_back(InsLine(line, line_num, file.ops.size()));
+		// split the line into instructions in the same way as the fortran GETINT routine
+		const char mrk = file.marker;
+		size_t n2 = 0;
+		while (true)
+		{
+			size_t n1 = line.find_first_not_of(' ', n2);
+			if (n1 == string::npos) break;
+			if (line[n1] != mrk)
+			{
+				n2 = line.find(' ', n1);
+				if (n2 == string::npos) n2 = line.size();
+			}
+			else
+			{
+				n2 = line.find(mrk, n1 + 1);
+				if (n2 == string::npos)
+				{
+					throw ins_error("unbalanced marker delimiters");
+				}
+				++n2;
+			}
+			const char *ins = line.data() + n1;
+			size_t len = n2 - n1;
+			char c = ins[0];
+			Op op(OpType::CONTINUE);
+			if (c == mrk)
+			{
+				op.is_marker = true;
+				op.text_pos = file.marker_text.size();
+				op.text_len = len - 2;
+				file.marker_text.append(ins + 1, len - 2);
+			}
+			if (c == 'l' || c == 'L')
+			{
+				op.type = OpType::LINE;
+				if (!read_int(ins + 1, len - 1, op.num1))
+				{
+					throw ins_error("cannot read line advance item " + string(ins, len));
+				}
+			}
+			else if (c == mrk)
+			{
+				op.type = OpType::MARKER;
+			}
+			else if (c == '&')
+			{
+				if (file.lines.back().n_ops != 0 || first_line)
+				{
+					throw ins_error("misplaced continuation character");
+				}
+				op.type = OpType::CONTINUE;
+			}
+			else if (c == 'w' || c == 'W')
+			{
+				op.type = OpType::WHITESPACE;
+			}
+			else if (c == 't' || c == 'T')
+			{
+				op.type = OpType::TAB;
+				if (!read_int(ins + 1, len - 1, op.num1))
+				{
+					throw ins_error("cannot read tab position " + string(ins, len));
+				}
+			}
+			else if (c == '[' || c == '(')
+			{
+				op.type = (c == '[') ? OpType::FIXED_OBS : OpType::SEMI_FIXED_OBS;
+				string item(ins, len);
+				size_t n3 = item.find((c == '[') ? ']' : ')');
+				string name = (n3 == string::npos) ? string() : item.substr(1, n3 - 1);
+				auto it = name_map.find(obs_key(name));
+				if (it == name_map.end())
+				{
+					throw ins_error("observation " + name + " is not in the list of observations");
+				}
+				op.obs_idx = it->second;
+				// first and last columns separated by a colon.  fortran reads them with an I3 format
+				size_t i_colon = item.find(':', n3 + 1);
+				if (i_colon == string::npos
+					|| i_colon - n3 - 1 > 999 || !read_int(&item[n3 + 1], i_colon - n3 - 1, op.num1)
+					|| item.size() - i_colon - 1 > 999 || !read_int(&item[i_colon + 1], item.size() - i_colon - 1, op.num2)
+					|| op.num1 <= 0)
+				{
+					throw ins_error("cannot read the columns of observation " + name);
+				}
+			}
+			else if (c == '!')
+			{
+				op.type = OpType::NON_FIXED_OBS;
+				string name(ins + 1, max(len, (size_t)2) - 2);
+				to_lower(name);
+				if (name != "dum" || len != 5)
+				{
+					auto it = name_map.find(obs_key(name));
+					if (it == name_map.end())
+					{
+						throw ins_error("observation " + name + " is not in the list of observations");
+					}
+					op.obs_idx = it->second;
+				}
+			}
+			else
+			{
+				throw ins_error("unrecognised instruction " + string(ins, len));
+			}
+			if (op.obs_idx >= 0) obs_read[op.obs_idx] = true;
+			file.ops.push_back(op);
+			++file.lines.back().n_ops;
+		}
+		first_line = false;
+	}
+	if (header)
+	{
+		throw InstructionFileError("unexpected end of instruction file " + ins_filename);
+	}
+}
+
+void InstructionReader::read(const vector<string> &out_filenames, vector<double> &obs_values) const
+{
+	if (out_filenames.size() != files.size())
+	{
+		throw InstructionFileError("number of model output files does not match the number of instruction files");
+	}
+	obs_values.resize(obs_names.size());
+	ReadState state;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		execute(i, out_filenames[i], state, obs_values);
+	}
+}
+
+void InstructionReader::execute(size_t i_file, const string &out_filename, ReadState &s, vector<double> &obs_values) const
+{
+	const CompiledFile &file = files[i_file];
+	s.load(out_filename);
+	s.mrktyp = 0;
+	s.almark = 1;
+	s.begins = 0;
+	size_t i_line = 0;
+	while (i_line < file.lines.size())
+	{
+		const InsLine &ins_line = file.lines[i_line];
+		const Op *ops = &file.ops[ins_line.first_op];
+		auto error = [&](const string &reason)
+		{
+			return read_error(reason, out_filename, s.exists, s.line_num(), ins_filenames[i_file],
+				ins_line.line_num, ins_line.text);
+		};
+		auto obs_name = [&](int obs_idx)
+		{
+			return (obs_idx < 0) ? string("dum") : obs_names[obs_idx];
+		};
+		bool restart = false;
+		for (size_t k = 0; k < ins_line.n_ops; ++k)
+		{
+			const Op &op = ops[k];
+			const char *mark = file.marker_text.data() + op.text_pos;
+			if (k == 0)
+			{
+				if (op.type != OpType::CONTINUE)
+				{
+					s.mrktyp = 0;
+					s.almark = 1;
+					s.begins = 0;
+				}
+				else if (s.begins)
+				{
+					// go back to the line with the primary marker
+					--i_line;
+					restart = true;
+					break;
+				}
+			}
+			switch (op.type)
+			{
+			case OpType::LINE:
+				s.almark = 0;
+				for (int i = 1; i < op.num1; ++i)
+				{
+					if (!s.skip_line()) throw error("unexpected end of file");
+				}
+				if (!s.read_line()) throw error("unexpected end of file");
+				s.mrktyp = 1;
+				s.j1 = 0;
+				break;
+			case OpType::MARKER:
+				if (s.mrktyp == 0)
+				{
+					if (!s.find_primary(mark, op.text_len, s.j1))
+					{
+						throw error("primary marker " + string(mark, op.text_len) + " not found");
+					}
+					s.mrktyp = 1;
+				}
+				else
+				{
+					const char *hit = nullptr;
+					if (s.j1 < s.nblc) hit = find_text(s.line + s.j1, s.line + s.nblc, mark, op.text_len);
+					if (hit == nullptr)
+					{
+						if (s.almark == 1)
+						{
+							// look for the primary marker again
+							s.begins = 1;
+							restart = true;
+							break;
+						}
+						throw error("secondary marker " + string(mark, op.text_len) + " not found");
+					}
+					s.j1 = (hit - s.line) + op.text_len;
+				}
+				break;
+			case OpType::CONTINUE:
+				break;
+			case OpType::WHITESPACE:
+			{
+				s.almark = 0;
+				const char *blank = nullptr;
+				if (s.j1 < s.nblc) blank = (const char*)memchr(s.line + s.j1, ' ', s.nblc - s.j1);
+				if (blank == nullptr) throw error("whitespace not found");
+				int i = blank - s.line + 1;
+				while (i <= s.nblc && s.at(i) == ' ') ++i;
+				s.j1 = i - 1;
+				break;
+			}
+			case OpType::TAB:
+				s.almark = 0;
+				if (op.num1 < s.j1) throw error("tab position is before the current position");
+				s.j1 = op.num1;
+				if (s.j1 > s.nblc) throw error("tab position is beyond the end of the line");
+				break;
+			case OpType::FIXED_OBS:
+			case OpType::SEMI_FIXED_OBS:
+			{
+				s.almark = 0;
+				int num1 = op.num1;
+				int num2 = op.num2;
+				if (num1 > s.nblc) throw error("observation " + obs_name(op.obs_idx) + " not found");
+				num2 = min(num2, s.nblc);
+				if (op.type == OpType::FIXED_OBS)
+				{
+					if (num2 < 1) throw error("observation " + obs_name(op.obs_idx) + " not found");
+					bool blank = true;
+					for (int i = num1; i <= num2 && blank; ++i) blank = (s.at(i) == ' ');
+					if (blank) throw error("observation " + obs_name(op.obs_idx) + " not found");
+				}
+				else
+				{
+					// extend the columns to the whole number, as the fortran GETTOT routine.  A last column of 0
+					// is treated as non-blank, so the number is the first word on the line
+					if (num2 >= 1 && s.at(num2) == ' ')
+					{
+						int i = num2;
+						while (i >= num1 && s.at(i) == ' ') --i;
+						if (i < num1) throw error("observation " + obs_name(op.obs_idx) + " not found");
+						num2 = i;
+					}
+					else if (num2 != s.nblc)
+					{
+						int i = max(num2, 1);
+						while (i <= s.nblc && s.at(i) != ' ') ++i;
+						num2 = i - 1;
+					}
+					if (num1 != 1)
+					{
+						int i = num1;
+						while (i >= 1 && s.at(i) != ' ') --i;
+						num1 = i + 1;
+					}
+				}
+				if (num2 < num1 || !read_real(s.line + num1 - 1, num2 - num1 + 1, obs_values[op.obs_idx]))
+				{
+					throw error("cannot read observation " + obs_name(op.obs_idx));
+				}
+				s.j1 = num2;
+				break;
+			}
+			case OpType::NON_FIXED_OBS:
+			{
+				s.almark = 0;
+				int num1 = s.j1 + 1;
+				while (num1 <= s.nblc && s.at(num1) == ' ') ++num1;
+				if (num1 > s.nblc) throw error("observation " + obs_name(op.obs_idx) + " not found");
+				const char *blank = (const char*)memchr(s.line + num1 - 1, ' ', s.nblc - num1 + 1);
+				int num2 = (blank == nullptr) ? s.nblc : blank - s.line;
+				double val;
+				if (!read_real(s.line + num1 - 1, num2 - num1 + 1, val))
+				{
+					// the number may be followed by a secondary marker without a blank in between
+					const Op *next = (k + 1 < ins_line.n_ops) ? &ops[k + 1] : nullptr;
+					if (next == nullptr || !next->is_marker)
+					{
+						throw error("cannot read observation " + obs_name(op.obs_idx));
+					}
+					const char *next_mark = file.marker_text.data() + next->text_pos;
+					const char *hit = nullptr;
+					if (s.j1 <= s.nblc) hit = find_text(s.line + s.j1, s.line + s.nblc, next_mark, next->text_len);
+					if (hit == nullptr) throw error("cannot read observation " + obs_name(op.obs_idx));
+					num2 = hit - s.line;
+					if (num2 < num1 || !read_real(s.line + num1 - 1, num2 - num1 + 1, val))
+					{
+						throw error("cannot read observation " + obs_name(op.obs_idx));
+					}
+				}
+				if (op.obs_idx >= 0) obs_values[op.obs_idx] = val;
+				s.j1 = num2;
+				break;
+			}
+			}
+			if (restart) break;
+		}
+		if (!restart) ++i_line;
+	}
+}
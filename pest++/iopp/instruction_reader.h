@@ -0,0 +1,77 @@
+#ifndef INSTRUCTION_READER_H
+#define INSTRUCTION_READER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// InstructionReader reads observation values from model output files using PEST instruction files in the
+// same way as the fortran readins routine, but the instruction files are only read once.  The constructor
+// compiles each instruction line into a list of operations (line advance, marker, whitespace, tab and the
+// fixed, semi-fixed and non-fixed observation reads) with the observation names already looked up.  read()
+// loads each output file with a single block read and runs the operations over it, writing the values
+// straight into the observation vector.  Primary markers are found by searching the whole file with memchr
+// rather than line by line.  The values read and the files rejected are the same as with readins.  read()
+// does not modify the object, so it can be called from several threads reading different output files.
+class InstructionReader
+{
+public:
+	// obs_names are the names of the values returned by read().  Observation names are not case sensitive.
+	// Throws InstructionFileError if an instruction file cannot be read, contains an instruction that
+	// cannot be executed, or if an observation is not read by any of the instruction files
+	InstructionReader(const std::vector<std::string> &ins_filenames, const std::vector<std::string> &obs_names);
+	// read one model output file for each instruction file.  obs_values is resized to the number of
+	// observations.  Throws InstructionFileError if an output file does not match its instructions
+	void read(const std::vector<std::string> &out_filenames, std::vector<double> &obs_values) const;
+	const std::vector<std::string> &get_ins_filenames() const { return ins_filenames; }
+	// read a number in the same way as a fortran Fw.0 edit descriptor.  Blanks are ignored and the
+	// exponent letter may be left out.  Returns false if text is not a number
+	static bool read_real(const char *text, size_t len, double &val);
+	// read an integer in the same way as a fortran Iw edit descriptor.  Returns false if text is not
+	// an integer
+	static bool read_int(const char *text, size_t len, int &val);
+	// fortran reads the lines of instruction and output files into a buffer of this many characters
+	static const size_t MAX_LINE_LEN = 2000;
+private:
+	enum class OpType { LINE, MARKER, CONTINUE, WHITESPACE, TAB, FIXED_OBS, SEMI_FIXED_OBS, NON_FIXED_OBS };
+	class Op
+	{
+	public:
+		Op(OpType _type) : type(_type), num1(0), num2(0), obs_idx(-1), is_marker(false), text_pos(0), text_len(0) {}
+		OpType type;
+		int num1; // number of lines, tab column or first column of a fixed observation
+		int num2; // last column of a fixed observation
+		int obs_idx; // -1 for dum
+		bool is_marker; // the instruction starts with the marker character
+		size_t text_pos; // marker text in CompiledFile::marker_text
+		size_t text_len;
+	};
+	class InsLine
+	{
+	public:
+		InsLine(const std::string &_text, int _line_num, size_t _first_op)
+			: text(_text), line_num(_line_num), first_op(_first_op), n_ops(0) {}
+		std::string text;
+		int line_num;
+		size_t first_op;
+		size_t n_ops;
+	};
+	class CompiledFile
+	{
+	public:
+		CompiledFile() : marker(' ') {}
+		char marker;
+		std::string marker_text;
+		std::vector<Op> ops;
+		std::vector<InsLine> lines;
+	};
+	class ReadState;
+	std::vector<std::string> ins_filenames;
+	std::vector<std::string> obs_names;
+	std::vector<CompiledFile> files;
+	void compile(const std::string &ins_filename, const std::unordered_map<std::string, int> &name_map,
+		std::vector<bool> &obs_read, CompiledFile &file);
+	void execute(size_t i_file, const std::string &out_filename, ReadState &state, std::vector<double> &obs_values) const;
+};
+
+#endif /* INSTRUCTION_READER_H */
@@ -0,0 +1,719 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include "template_writer.h"
+#include "iopp.h"
+
+using namespace std;
+
+namespace
+{
+	// the numbers are formatted with integer arithmetic that gives the same digits as snprintf, which rounds
+	// the exact binary value to the nearest decimal with ties to even.  Values outside the range handled are
+	// passed to snprintf and strtod
+	const uint64_t pow10_u64[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+		100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+		100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+		1000000000000000000ULL };
+	const int MAX_SCALED_DIGITS = 18;
+	// powers of ten that are exact doubles
+	const double exact_pow10[] = { 1.0E0, 1.0E1, 1.0E2, 1.0E3, 1.0E4, 1.0E5, 1.0E6, 1.0E7, 1.0E8, 1.0E9, 1.0E10,
+		1.0E11, 1.0E12, 1.0E13, 1.0E14, 1.0E15, 1.0E16, 1.0E17, 1.0E18, 1.0E19, 1.0E20, 1.0E21, 1.0E22 };
+	const int MAX_EXACT_POW10 = 22;
+	// 5^27 is the largest power of five that fits in 63 bits
+	const int MAX_POW5 = 27;
+
+	uint64_t pow5(int n)
+	{
+		uint64_t p = 1;
+		for (int i = 0; i < n; ++i) p *= 5;
+		return p;
+	}
+
+	// 128 bit product of a and b as hi and lo words
+	void mul_64(uint64_t a, uint64_t b, uint64_t &hi, uint64_t &lo)
+	{
+		uint64_t a_lo = a & 0xFFFFFFFFULL, a_hi = a >> 32;
+		uint64_t b_lo = b & 0xFFFFFFFFULL, b_hi = b >> 32;
+		uint64_t p0 = a_lo * b_lo;
+		uint64_t p1 = a_lo * b_hi;
+		uint64_t p2 = a_hi * b_lo;
+		uint64_t p3 = a_hi * b_hi;
+		uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFULL) + (p2 & 0xFFFFFFFFULL);
+		lo = (mid << 32) | (p0 & 0xFFFFFFFFULL);
+		hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+	}
+
+	// round a * 10^s to the nearest integer with ties to even, where a is positive (or zero) and finite.
+	// Returns false if the result cannot be found with 128 bit arithmetic or has more than
+	// MAX_SCALED_DIGITS digits
+	bool round_scaled(double a, int s, uint64_t &q)
+	{
+		if (a == 0.0)
+		{
+			q = 0;
+			return true;
+		}
+		int e2;
+		double f = frexp(a, &e2);
+		// a = m * 2^e exactly
+		uint64_t m = uint64_t(ldexp(f, 53));
+		int e = e2 - 53;
+		bool half = false;
+		bool above_half = false;
+		if (s >= 0)
+		{
+			// a * 10^s = m * 5^s * 2^(e + s)
+			if (s > MAX_POW5) return false;
+			uint64_t hi, lo;
+			mul_64(m, pow5(s), hi, lo);
+			int sh = e + s;
+			if (sh >= 0)
+			{
+				if (hi != 0 || sh >= 64 || lo > (pow10_u64[MAX_SCALED_DIGITS] >> sh)) return false;
+				q = lo << sh;
+				return true;
+			}
+			int r = -sh;
+			if (r >= 128) return false;
+			// q is the product shifted right by r bits.  The bit below q decides the rounding
+			uint64_t rest_lo, rest_hi;
+			if (r < 64)
+			{
+				if ((hi >> r) != 0) return false;
+				q = (r == 0) ? lo : ((lo >> r) | (hi << (64 - r)));
+				rest_hi = 0;
+				rest_lo = lo & ((1ULL << r) - 1);
+				half = ((lo >> (r - 1)) & 1) != 0;
+				rest_lo &= ~(1ULL << (r - 1));
+			}
+			else
+			{
+				q = (r == 64) ? hi : (hi >> (r - 64));
+				rest_lo = lo;
+				rest_hi = (r == 64) ? 0 : (hi & ((1ULL << (r - 64)) - 1));
+				if (r == 64)
+				{
+					half = (lo >> 63) != 0;
+					rest_lo &= ~(1ULL << 63);
+				}
+				else
+				{
+					half = ((hi >> (r - 65)) & 1) != 0;
+					rest_hi &= ~(1ULL << (r - 65));
+				}
+			}
+			above_half = half && (rest_lo != 0 || rest_hi != 0);
+		}
+		else
+		{
+			// a * 10^s = m / (5^t * 2^(t - e)) with t = -s.  Values with e >= 0 are integers larger than 2^52
+			// and are left to snprintf
+			int t = -s;
+			if (t > MAX_POW5 || e >= 0) return false;
+			uint64_t d = pow5(t);
+			int k = t - e;
+			uint64_t q1 = m / d;
+			uint64_t r1 = m % d;
+			if (k >= 64) return false;
+			q = q1 >> k;
+			// the whole divisor d * 2^k must fit so that the remainder cannot overflow
+			if (((d << k) >> k) != d) return false;
+			// remainder of m divided by d * 2^k, compared with half of d * 2^k
+			uint64_t rem = (q1 & ((1ULL << k) - 1)) * d + r1;
+			uint64_t half_div = d << (k - 1);
+			half = rem >= half_div;
+			above_half = rem > half_div;
+		}
+		if (above_half || (half && (q & 1) != 0)) ++q;
+		return q <= pow10_u64[MAX_SCALED_DIGITS];
+	}
+
+	// the n significant digits of a (n <= MAX_SCALED_DIGITS) as an integer and the decimal exponent of the
+	// first digit, as written by snprintf with %.(n-1)e.  Returns false if the digits cannot be found with
+	// round_scaled
+	bool round_significant(double a, int n, uint64_t &q, int &exp10)
+	{
+		if (a == 0.0)
+		{
+			q = 0;
+			exp10 = 0;
+			return true;
+		}
+		int e2;
+		frexp(a, &e2);
+		// estimate of the exponent, corrected below
+		exp10 = int(floor((e2 - 1) * 0.30102999566398120));
+		for (int i_try = 0; i_try < 3; ++i_try)
+		{
+			if (!round_scaled(a, n - 1 - exp10, q)) return false;
+			if (q >= pow10_u64[n]) ++exp10;
+			else if (q < pow10_u64[n - 1]) --exp10;
+			else return true;
+		}
+		return false;
+	}
+
+	// write the digits of q, at least n_min of them, to text.  Returns the number of digits
+	int write_digits(uint64_t q, int n_min, char *text)
+	{
+		char buf[24];
+		int n = 0;
+		do
+		{
+			buf[n++] = char('0' + q % 10);
+			q /= 10;
+		} while (q != 0);
+		while (n < n_min) buf[n++] = '0';
+		for (int i = 0; i < n; ++i) text[i] = buf[n - 1 - i];
+		return n;
+	}
+
+	// the same text as snprintf with %.(prec)f.  Returns the number of characters
+	int print_f(char *buf, size_t buf_size, int prec, double val)
+	{
+		uint64_t q;
+		if (std::isfinite(val) && prec >= 0 && round_scaled(fabs(val), prec, q))
+		{
+			char digits[24];
+			int n = write_digits(q, prec + 1, digits);
+			if (size_t(n + 3) <= buf_size)
+			{
+				int len = 0;
+				if (signbit(val)) buf[len++] = '-';
+				memcpy(buf + len, digits, n - prec);
+				len += n - prec;
+				if (prec > 0)
+				{
+					buf[len++] = '.';
+					memcpy(buf + len, digits + n - prec, prec);
+					len += prec;
+				}
+				buf[len] = '\0';
+				return len;
+			}
+		}
+		return snprintf(buf, buf_size, "%.*f", prec, val);
+	}
+
+	// the same text as snprintf with %.(prec)e, or %.(prec)E if upper is true.  Returns the number of characters
+	int print_e(char *buf, size_t buf_size, int prec, double val, bool upper=false)
+	{
+		uint64_t q;
+		int exp10;
+		if (std::isfinite(val) && val != 0.0 && prec >= 0 && prec < MAX_SCALED_DIGITS
+			&& size_t(prec + 9) <= buf_size && round_significant(fabs(val), prec + 1, q, exp10))
+		{
+			char digits[24];
+			write_digits(q, prec + 1, digits);
+			int len = 0;
+			if (val < 0.0) buf[len++] = '-';
+			buf[len++] = digits[0];
+			if (prec > 0)
+			{
+				buf[len++] = '.';
+				memcpy(buf + len, digits + 1, prec);
+				len += prec;
+			}
+			buf[len++] = upper ? 'E' : 'e';
+			buf[len++] = (exp10 < 0) ? '-' : '+';
+			len += write_digits(abs(exp10), 2, buf + len);
+			buf[len] = '\0';
+			return len;
+		}
+		return snprintf(buf, buf_size, upper ? "%.*E" : "%.*e", prec, val);
+	}
+
+	// the value of the number in text (len characters), rounded in the same way as strtod
+	double read_value(const char *text, int len)
+	{
+		// a number of up to 19 digits times an exact power of ten is correctly rounded by a single
+		// multiplication or division when the number is exact as a double
+		int i = 0;
+		bool neg = false;
+		if (i < len && (text[i] == '-' || text[i] == '+')) neg = (text[i++] == '-');
+		uint64_t mant = 0;
+		int n_digits = 0;
+		int exp10 = 0;
+		bool has_digit = false;
+		bool ok = true;
+		for (; i < len && text[i] >= '0' && text[i] <= '9'; ++i)
+		{
+			has_digit = true;
+			if (mant != 0 || text[i] != '0') ++n_digits;
+			mant = mant * 10 + (text[i] - '0');
+		}
+		if (i < len && text[i] == '.')
+		{
+			for (++i; i < len && text[i] >= '0' && text[i] <= '9'; ++i)
+			{
+				has_digit = true;
+				if (mant != 0 || text[i] != '0') ++n_digits;
+				mant = mant * 10 + (text[i] - '0');
+				--exp10;
+			}
+		}
+		if (i < len && (text[i] == 'E' || text[i] == 'e'))
+		{
+			++i;
+			bool exp_neg = false;
+			if (i < len && (text[i] == '-' || text[i] == '+')) exp_neg = (text[i++] == '-');
+			int exp = 0;
+			if (i == len) ok = false;
+			for (; i < len && text[i] >= '0' && text[i] <= '9' && exp < 1000; ++i) exp = exp * 10 + (text[i] - '0');
+			exp10 += exp_neg ? -exp : exp;
+		}
+		if (ok && has_digit && i == len && n_digits <= 19 && mant <= (1ULL << 53) && abs(exp10) <= MAX_EXACT_POW10)
+		{
+			double val = double(mant);
+			val = (exp10 < 0) ? val / exact_pow10[-exp10] : val * exact_pow10[exp10];
+			return neg ? -val : val;
+		}
+		char buf[64];
+		len = min(len, int(sizeof(buf)) - 1);
+		memcpy(buf, text, len);
+		buf[len] = '\0';
+		return strtod(buf, nullptr);
+	}
+
+	// fortran Fw.d output editing.  The number is right justified in text (w characters).  The zero before
+	// the decimal point is left out if there is not enough room for it.  Returns false if the number does
+	// not fit, where fortran writes asterisks
+	bool f_edit(double val, int w, int d, char *text)
+	{
+		char buf[64];
+		int n = print_f(buf, sizeof(buf), d, val);
+		if (n < 0 || n >= (int)sizeof(buf) - 1) return false;
+		if (d == 0) buf[n++] = '.';
+		char *start = buf;
+		if (n > w)
+		{
+			if (buf[0] == '0' && buf[1] == '.')
+			{
+				++start;
+				--n;
+			}
+			else if (buf[0] == '-' && buf[1] == '0' && buf[2] == '.')
+			{
+				buf[1] = '-';
+				++start;
+				--n;
+			}
+		}
+		if (n > w) return false;
+		memset(text, ' ', w - n);
+		memcpy(text + w - n, start, n);
+		return true;
+	}
+
+	// fortran kPEw.dEe output editing.  Writes the sign and digits before the exponent to mant (without
+	// leading blanks) and returns the exponent in exp.  The zero before the decimal point (k=0) is left out
+	// if there is not enough room for it.  Returns false if the number does not fit in w characters
+	bool e_edit(double val, int k, int w, int d, int e, char *mant, int &mant_len, int &exp)
+	{
+		if (k < 0 || k > d + 1) return false;
+		int n_sig = (k == 0) ? d : d + 1;
+		if (n_sig < 1) return false;
+		char buf[64];
+		print_e(buf, sizeof(buf), n_sig - 1, val);
+		char *p = buf;
+		int len = 0;
+		if (*p == '-')
+		{
+			mant[len++] = '-';
+			++p;
+		}
+		char digits[32];
+		int n_digits = 0;
+		for (; *p != 'e'; ++p)
+		{
+			if (*p != '.') digits[n_digits++] = *p;
+		}
+		exp = atoi(p + 1) + 1 - k;
+		if (k == 0)
+		{
+			mant[len++] = '0';
+			mant[len++] = '.';
+			memcpy(mant + len, digits, n_digits);
+			len += n_digits;
+		}
+		else
+		{
+			memcpy(mant + len, digits, k);
+			len += k;
+			mant[len++] = '.';
+			memcpy(mant + len, digits + k, n_digits - k);
+			len += n_digits - k;
+		}
+		int max_exp = 1;
+		for (int i = 0; i < e; ++i) max_exp *= 10;
+		if (abs(exp) >= max_exp) return false;
+		// exponent letter, sign and e digits
+		if (len + 2 + e > w)
+		{
+			if (k != 0 || len + 1 + e > w) return false;
+			// drop the leading zero
+			int i_zero = (mant[0] == '-') ? 1 : 0;
+			memmove(mant + i_zero, mant + i_zero + 1, len - i_zero - 1);
+			--len;
+		}
+		mant_len = len;
+		return true;
+	}
+
+	// write the number in the form written by wrtsig with exponent editing: the digits before the exponent
+	// followed by E, a minus sign for a negative exponent and the exponent without leading zeros
+	int write_exp(const char *mant, int mant_len, int exp, char *text)
+	{
+		int len = mant_len;
+		memcpy(text, mant, len);
+		text[len++] = 'E';
+		if (exp < 0)
+		{
+			text[len++] = '-';
+			exp = -exp;
+		}
+		return len + write_digits(exp, 1, text + len);
+	}
+
+	void to_lower(string &str)
+	{
+		for (auto &c : str)
+		{
+			if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+		}
+	}
+
+	// the parameter name between markers at j1 and j2, in the same way as the PEST parnam routine.  Returns
+	// false if there is no name
+	bool get_par_name(const string &line, size_t j1, size_t j2, string &name)
+	{
+		if (j2 - j1 <= 1) return false;
+		size_t i = j1 + 1;
+		while (i < j2 && line[i] == ' ') ++i;
+		if (i == j2) return false;
+		name = line.substr(i, min<size_t>(50, j2 - i));
+		name.erase(name.find_last_not_of(' ') + 1);
+		to_lower(name);
+		return true;
+	}
+}
+
+int TemplateWriter::format_value(double val, int width, char *text, double &text_val)
+{
+	// this follows the PEST wrtsig routine called with precis=0 (single precision) and nopnt=0 (decimal
+	// point required).  The fortran edit descriptors it uses are reproduced by f_edit and e_edit
+	if (val == 0.0) val = 0.0; // negative zero is written as zero
+	char buf[64];
+	print_e(buf, sizeof(buf), 15, val);
+	int jexp = atoi(strchr(buf, 'e') + 1);
+	int pos = (val < 0.0) ? 0 : 1;
+	int epos = (jexp < 0) ? 0 : 1;
+	int lw = min(MAX_VALUE_WIDTH, width);
+	if (abs(jexp) > 38) return 0;
+	int len = 0;
+	if (lw >= 14 - pos)
+	{
+		// 1PE13.7 or 1PE14.7
+		len = print_e(text, MAX_VALUE_WIDTH + 1, 7, val, true);
+	}
+	else
+	{
+		bool use_exp = false;
+		char f_text[MAX_VALUE_WIDTH + 1];
+		int d = min(lw - 2 + pos, lw - jexp - 3 + pos);
+		while (true)
+		{
+			if (d < 0)
+			{
+				use_exp = true;
+				break;
+			}
+			if (f_edit(val, lw, d, f_text)) break;
+			--d;
+		}
+		if (!use_exp)
+		{
+			int k = find(f_text, f_text + lw, '.') - f_text + 1;
+			if (k == lw + 1) return 0;
+			if (k == 1 || (pos == 0 && k == 2))
+			{
+				// a number such as .000123 is written with exponent editing unless a significant digit
+				// appears in the first three digits after the decimal point
+				use_exp = true;
+				for (int j = 1; j <= 3; ++j)
+				{
+					if (k + j > lw) return 0;
+					if (f_text[k + j - 1] != '0')
+					{
+						use_exp = false;
+						break;
+					}
+				}
+			}
+			if (!use_exp)
+			{
+				int i_start = 0;
+				while (f_text[i_start] == ' ') ++i_start;
+				len = lw - i_start;
+				memcpy(text, f_text + i_start, len);
+			}
+		}
+		if (use_exp)
+		{
+			int d = lw - 7 + pos + epos + 1;
+			if (abs(jexp) < 10) ++d;
+			int p = 1;
+			int lexp = 0;
+			bool iflag = false;
+			if (jexp >= 10 && jexp - (d - 1) < 10)
+			{
+				// write more digits before the decimal point to keep the exponent to a single digit
+				p = 1 + (jexp - 9);
+				++d;
+				lexp = 9;
+			}
+			else if (jexp == -10)
+			{
+				// 0.1E-9 has one more significant digit than 1.0E-10
+				iflag = true;
+				++d;
+			}
+			bool inc = false;
+			char mant[MAX_VALUE_WIDTH + 8];
+			int mant_len;
+			int exp;
+			while (true)
+			{
+				if (d <= 0) return 0;
+				if (iflag)
+				{
+					if (!e_edit(val, 0, d + 8, d, 3, mant, mant_len, exp)) return 0;
+					break;
+				}
+				if (!e_edit(val, p, d + 7, d - 1, 3, mant, mant_len, exp)) return 0;
+				// rounding may have increased the exponent to two digits
+				if (exp == 10 && (jexp == 9 || lexp == 9) && !inc)
+				{
+					if (lexp == 0)
+					{
+						if (d - 1 == 0) --d;
+						else ++p;
+					}
+					else if (jexp - (d - 2) < 10)
+					{
+						++p;
+					}
+					else
+					{
+						--d;
+					}
+					inc = true;
+					continue;
+				}
+				break;
+			}
+			if (iflag)
+			{
+				// drop the zero before the decimal point
+				int i_zero = (mant[0] == '-') ? 1 : 0;
+				if (mant[i_zero] == '0')
+				{
+					memmove(mant + i_zero, mant + i_zero + 1, mant_len - i_zero - 1);
+					--mant_len;
+				}
+			}
+			char exp_text[MAX_VALUE_WIDTH + 16];
+			len = write_exp(mant, mant_len, exp, exp_text);
+			if (len > lw) return 0;
+			memcpy(text, exp_text, len);
+		}
+	}
+	if (len <= 0 || len > lw) return 0;
+	text_val = read_value(text, len);
+	return len;
+}
+
+TemplateWriter::TemplateWriter(const vector<string> &_tpl_filenames, const vector<string> &_par_names)
+	: tpl_filenames(_tpl_filenames), par_names(_par_names), par_width(_par_names.size(), 0), files(_tpl_filenames.size())
+{
+	// fortran compares names of at most 50 characters
+	vector<string> lower_names;
+	for (auto name : par_names)
+	{
+		to_lower(name);
+		if (name.size() > 50) name.resize(50);
+		lower_names.push_back(name);
+	}
+	for (size_t i = 0; i < tpl_filenames.size(); ++i)
+	{
+		compile(tpl_filenames[i], lower_names, files[i]);
+	}
+	for (size_t i = 0; i < par_names.size(); ++i)
+	{
+		if (par_width[i] == 0)
+		{
+			throw TemplateFileError("parameter " + par_names[i] + " is not listed in any template file");
+		}
+	}
+	for (auto &file : files)
+	{
+		for (auto &seg : file.segments)
+		{
+			if (seg.par_idx >= 0) file.max_size += seg.width;
+		}
+	}
+}
+
+void TemplateWriter::compile(const string &tpl_filename, const vector<string> &lower_names, CompiledFile &file)
+{
+	ifstream fin(tpl_filename, ios::binary);
+	if (!fin)
+	{
+		throw TemplateFileError("template file " + tpl_filename + " does not exist");
+	}
+	stringstream ss;
+	ss << fin.rdbuf();
+	const string contents = ss.str();
+	unordered_map<string, int> name_map;
+	for (size_t i = 0; i < lower_names.size(); ++i)
+	{
+		name_map.emplace(lower_names[i], i);
+	}
+	size_t text_start = 0;
+	size_t line_start = 0;
+	bool header = true;
+	char mark = '\0';
+	string line;
+	while (line_start < contents.size())
+	{
+		size_t line_end = contents.find('\n', line_start);
+		if (line_end == string::npos) line_end = contents.size();
+		line.assign(contents, line_start, line_end - line_start);
+		line_start = line_end + 1;
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (header)
+		{
+			// "ptf" or "jtf" followed by the marker character, separated by blanks or a comma
+			string ftyp;
+			string mark_str;
+			for (auto &c : line)
+			{
+				if (c == ',' || c == '\t') c = ' ';
+			}
+			istringstream is(line);
+			is >> ftyp >> mark_str;
+			to_lower(ftyp);
+			if ((ftyp != "ptf" && ftyp != "jtf") || mark_str.empty())
+			{
+				throw TemplateFileError("illegal header in template file " + tpl_filename);
+			}
+			mark = mark_str[0];
+			header = false;
+			continue;
+		}
+		if (line.size() > MAX_LINE_LEN) line.resize(MAX_LINE_LEN);
+		size_t lc = line.find_last_not_of(' ') + 1;
+		if (lc == 0)
+		{
+			// fortran writes a blank line as a single space
+			file.text += " \n";
+			continue;
+		}
+		size_t start = 0;
+		while (start < lc)
+		{
+			size_t j1 = line.find(mark, start);
+			if (j1 == string::npos || j1 >= lc) break;
+			size_t j2 = line.find(mark, j1 + 1);
+			string name;
+			if (j2 == string::npos || j2 >= lc || !get_par_name(line, j1, j2, name))
+			{
+				throw TemplateFileError("error getting parameter name from template: " + line.substr(j1, lc - j1)
+					+ " in file " + tpl_filename);
+			}
+			auto it = name_map.find(name);
+			if (it == name_map.end())
+			{
+				throw TemplateFileError("parameter " + name + " in template file " + tpl_filename +
+					" is not in the list of parameters");
+			}
+			file.text.append(line, start, j1 - start);
+			int width = j2 - j1 + 1;
+			file.segments.push_back(Segment(text_start, file.text.size() - text_start, it->second, width));
+			text_start = file.text.size();
+			int &par_width_ref = par_width[it->second];
+			par_width_ref = (par_width_ref == 0) ? width : min(par_width_ref, width);
+			start = j2 + 1;
+		}
+		if (start < lc) file.text.append(line, start, lc - start);
+		file.text += '\n';
+	}
+	if (header)
+	{
+		throw TemplateFileError("illegal header in template file " + tpl_filename);
+	}
+	file.segments.push_back(Segment(text_start, file.text.size() - text_start, -1, 0));
+	file.max_size = file.text.size();
+}
+
+void TemplateWriter::write(vector<double> &par_values, const vector<string> &inp_filenames) const
+{
+	if (inp_filenames.size() != files.size())
+	{
+		throw TemplateFileError("number of model input files does not match the number of template files");
+	}
+	if (par_values.size() != par_names.size())
+	{
+		throw TemplateFileError("number of parameter values does not match the number of parameters");
+	}
+	// every occurrence of a parameter is written with the same text, so the values are formatted once
+	vector<char> value_text(par_values.size() * MAX_VALUE_WIDTH);
+	vector<int> value_len(par_values.size());
+	for (size_t i = 0; i < par_values.size(); ++i)
+	{
+		double text_val;
+		value_len[i] = format_value(par_values[i], par_width[i], &value_text[i * MAX_VALUE_WIDTH], text_val);
+		if (value_len[i] == 0)
+		{
+			ostringstream ss;
+			ss << "value " << par_values[i] << " of parameter " << par_names[i] << " cannot be written in a field of "
+				<< par_width[i] << " characters";
+			throw TemplateFileError(ss.str());
+		}
+		par_values[i] = text_val;
+	}
+	size_t max_size = 0;
+	for (auto &file : files) max_size = max(max_size, file.max_size);
+	string buf;
+	buf.reserve(max_size);
+	for (size_t i_file = 0; i_file < files.size(); ++i_file)
+	{
+		const CompiledFile &file = files[i_file];
+		buf.clear();
+		for (auto &seg : file.segments)
+		{
+			buf.append(file.text, seg.text_pos, seg.text_len);
+			if (seg.par_idx >= 0)
+			{
+				int len = value_len[seg.par_idx];
+				buf.append(seg.width - len, ' ');
+				buf.append(&value_text[seg.par_idx * MAX_VALUE_WIDTH], len);
+			}
+		}
+		// text mode so lines end in the same way as the files written by fortran
+		FILE *fout = fopen(inp_filenames[i_file].c_str(), "w");
+		bool ok = (fout != nullptr) && fwrite(buf.data(), 1, buf.size(), fout) == buf.size();
+		if (fout != nullptr && fclose(fout) != 0) ok = false;
+		if (!ok)
+		{
+			throw TemplateFileError("error writing model input file " + inp_filenames[i_file]);
+		}
+	}
+}
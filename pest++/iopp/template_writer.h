@@ -0,0 +1,61 @@
+#ifndef TEMPLATE_WRITER_H
+#define TEMPLATE_WRITER_H
+
+#include <string>
+#include <vector>
+
+// TemplateWriter writes model input files from PEST template files in the same way as the fortran wrttpl
+// routine, but the template files are only read once.  The constructor splits each template file into
+// literal text and parameter slots (the parameter index and the width of the marker), and the smallest
+// marker width of each parameter is found in advance.  write() then only formats the parameter values and
+// writes each input file from a buffer with a single call.  The output is identical to that of wrttpl,
+// and the values written are returned in the same way.  write() does not modify the object, so it can be
+// called from several threads writing to different input files.
+class TemplateWriter
+{
+public:
+	// par_names are the names of the values passed to write().  Parameter names are not case sensitive.
+	// Throws TemplateFileError if a template file cannot be read or does not match par_names
+	TemplateWriter(const std::vector<std::string> &tpl_filenames, const std::vector<std::string> &par_names);
+	// write one input file for each template file.  par_values are replaced by the values written to the
+	// files.  Throws TemplateFileError if a value cannot be written or a file cannot be written
+	void write(std::vector<double> &par_values, const std::vector<std::string> &inp_filenames) const;
+	const std::vector<std::string> &get_tpl_filenames() const { return tpl_filenames; }
+	// the widest field wrttpl writes a (single precision) number into
+	static const int MAX_VALUE_WIDTH = 15;
+	// write val with the maximum precision that fits in width characters in the same way as the PEST wrtsig
+	// routine (single precision with a decimal point).  text must have room for MAX_VALUE_WIDTH characters.
+	// Returns the number of characters written and the value of the text in text_val, or 0 if val cannot
+	// be represented in width characters
+	static int format_value(double val, int width, char *text, double &text_val);
+private:
+	// literal text of a template file followed by the value of a parameter, right justified in a field
+	// of width characters
+	class Segment
+	{
+	public:
+		Segment(size_t _text_pos, size_t _text_len, int _par_idx, int _width)
+			: text_pos(_text_pos), text_len(_text_len), par_idx(_par_idx), width(_width) {}
+		size_t text_pos;
+		size_t text_len;
+		int par_idx; // -1 if there is no parameter after the text
+		int width;
+	};
+	class CompiledFile
+	{
+	public:
+		CompiledFile() : max_size(0) {}
+		std::string text;
+		std::vector<Segment> segments;
+		size_t max_size; // largest size of the input file
+	};
+	// fortran reads template lines into a buffer of this many characters
+	static const size_t MAX_LINE_LEN = 2000;
+	std::vector<std::string> tpl_filenames;
+	std::vector<std::string> par_names;
+	std::vector<int> par_width; // smallest marker width of each parameter
+	std::vector<CompiledFile> files;
+	void compile(const std::string &tpl_filename, const std::vector<std::string> &lower_names, CompiledFile &file);
+};
+
+#endif /* TEMPLATE_WRITER_H */
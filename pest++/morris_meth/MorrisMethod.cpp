@@ -17,6 +17,7 @@
 #include "ModelRunPP.h"
 #include "utilities.h"
 #include "FileManager.h"
+#include "Jacobian.h"
 #include "Stats.h"
 
 using namespace std;
@@ -280,15 +281,16 @@ Parameters MorrisMethod::get_ctl_parameters(int row)
 
 void MorrisMethod::assemble_runs(RunManagerAbstract &run_manager)
 {
+	const vector<string> &model_par_name_vec = run_manager.get_par_name_vec();
 	for (int tmp_r=0; tmp_r<r; ++tmp_r)
 	{
 		b_star_mat = create_P_star_mat(adj_par_name_vec.size());
 		int n_rows = b_star_mat.rows();
-		int run_id;
-		string par_name = "";
+		// the runs for each trajectory are added to the run manager as a single batch
+		MatrixXd model_pars_mat(n_rows, model_par_name_vec.size());
+		vector<string> par_name_vec(n_rows);
 		for (int i=0; i<n_rows; ++i)
 		{
-			par_name.clear();
 			//get control parameters
 			Parameters pars = get_ctl_parameters(i);
 			pars.insert(fixed_ctl_pars.begin(), fixed_ctl_pars.end());
@@ -296,10 +298,11 @@ void MorrisMethod::assemble_runs(RunManagerAbstract &run_manager)
 			base_partran_seq_ptr->ctl2model_ip(pars);
 			if (i>0)
 			{
-				par_name = adj_par_name_vec[i-1];
+				par_name_vec[i] = adj_par_name_vec[i-1];
 			}
-			run_id = run_manager.add_run(pars, par_name, Parameters::no_data);
+			model_pars_mat.row(i) = pars.get_data_eigen_vec(model_par_name_vec).transpose();
 		}
+		run_manager.add_runs(model_pars_mat, par_name_vec, vector<double>(n_rows, Parameters::no_data));
 	}
 }
 
@@ -337,9 +340,40 @@ void  MorrisMethod::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run
 	bool run1_ok = false;
 	string par_name_1;
 	double null_value;
+	int run_status;
 	stringstream message;
 	cout << endl;
-	run1_ok = run_manager.get_run(0, pars1, obs1);
+
+	// model runs are read from the run manager storage in blocks of the same size as the jacobian runs
+	const vector<string> &run_mngr_par_name_vec = run_manager.get_par_name_vec();
+	int n_block_runs = max(size_t(1), Jacobian::max_run_block_byte_size / (sizeof(double) * (run_mngr_par_name_vec.size() + run_mngr_obs_name_vec.size())));
+	MatrixXd block_pars;
+	MatrixXd block_obs;
+	vector<bool> block_success;
+	int block_beg = 0;
+	int block_end = 0;
+	auto get_block_run = [&](int i_run, Parameters &pars, Observations &obs)
+	{
+		if (i_run < block_beg || i_run >= block_end)
+		{
+			block_beg = i_run;
+			block_end = min(n_runs, i_run + n_block_runs);
+			vector<int> run_ids;
+			for (int i = block_beg; i < block_end; ++i)
+			{
+				run_ids.push_back(i);
+			}
+			run_manager.get_runs(run_ids, block_pars, block_obs, block_success);
+		}
+		int i_blk = i_run - block_beg;
+		pars = Parameters(run_mngr_par_name_vec, block_pars.row(i_blk).transpose());
+		vector<double> obs_vec(block_obs.cols());
+		Eigen::Map<Eigen::RowVectorXd>(obs_vec.data(), obs_vec.size()) = block_obs.row(i_blk);
+		obs.update(run_mngr_obs_name_vec, obs_vec);
+		return bool(block_success[i_blk]);
+	};
+
+	run1_ok = get_block_run(0, pars1, obs1);
 	for (int i_run=1; i_run<n_runs; ++i_run)
 	{
 		std::cout << string(message.str().size(), '\b');
@@ -350,7 +384,8 @@ void  MorrisMethod::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run
 		run0_ok = run1_ok;
 		pars0 = pars1;
 		obs0 = obs1;
-		run1_ok = run_manager.get_run(i_run, pars1, obs1, par_name_1, null_value);
+		run1_ok = get_block_run(i_run, pars1, obs1);
+		run_manager.get_info(i_run, run_status, par_name_1, null_value);
 		// Add run0 to obs_stats
 		if (run0_ok)
 		{
@@ -74,14 +74,17 @@ MatrixXd Sobol::gen_N_matrix(const MatrixXd &m1, const MatrixXd &m2, const vecto
 
 void Sobol::add_model_runs(RunManagerAbstract &run_manager, const MatrixXd &n)
 {
+	const vector<string> &model_par_name_vec = run_manager.get_par_name_vec();
+	MatrixXd model_pars_mat(n_sample, model_par_name_vec.size());
 	for (int i=0; i<n_sample; ++i)
 	{
 		VectorXd tmp_vec =  n.row(i);
 		Parameters tmp_pars(adj_par_name_vec, tmp_vec);
 		tmp_pars.insert(fixed_ctl_pars.begin(), fixed_ctl_pars.end());
 		base_partran_seq_ptr->ctl2model_ip(tmp_pars);
-		run_manager.add_run(tmp_pars);
+		model_pars_mat.row(i) = tmp_pars.get_data_eigen_vec(model_par_name_vec).transpose();
 	}
+	run_manager.add_runs(model_pars_mat);
 }
 
 void Sobol::assemble_runs(RunManagerAbstract &run_manager)
@@ -122,12 +125,28 @@ vector<double> Sobol::get_phi_vec(RunManagerAbstract &run_manager, int run_set,
 	Observations obs0;
 	int nrun = 0;
 	vector<double> phi_vec = vector<double>(n_sample, MISSING_DATA);
+	// read all of the runs in this set as a single batch
+	vector<int> run_ids;
+	for(int run_id=run_b; run_id<run_e; ++run_id)
+	{
+		run_ids.push_back(run_id);
+	}
+	MatrixXd run_pars;
+	MatrixXd run_obs;
+	vector<bool> run_success;
+	run_manager.get_runs(run_ids, run_pars, run_obs, run_success);
+	const vector<string> &run_par_name_vec = run_manager.get_par_name_vec();
+	const vector<string> &run_obs_name_vec = run_manager.get_obs_name_vec();
+	vector<double> obs_vec(run_obs_name_vec.size());
 	for(int run_id=run_b; run_id<run_e; ++run_id)
 	{
 		double phi = MISSING_DATA;
-		bool success = run_manager.get_run(run_id, pars0, obs0);
+		bool success = run_success[nrun];
 		if (success)
 		{
+			pars0 = Parameters(run_par_name_vec, run_pars.row(nrun).transpose());
+			Eigen::Map<Eigen::RowVectorXd>(obs_vec.data(), obs_vec.size()) = run_obs.row(nrun);
+			obs0.update(run_obs_name_vec, obs_vec);
 			run0.update_ctl(pars0, obs0);
 			phi = run0.get_phi(0.0);
 		}
@@ -56,6 +56,9 @@ int main(int argc, char* argv[])
 	fout << "#####################################################################################################" << endl;
 	fout << "Header information" << endl;
 	fout << "number of runs = " << n_runs << endl;
+	fout << "format version = " << rs.get_format_version() << endl;
+	fout << "observation value size = " << rs.get_obs_value_size() << endl;
+	fout << "runs per tile = " << rs.get_tile_nruns() << endl;
 	fout << "parameter names:" << endl;
 	const vector<string> &par_names_vec = rs.get_par_name_vec();
 	for (const auto &name : par_names_vec)
@@ -35,6 +35,7 @@
 #include "TerminationController.h"
 #include "RunManagerGenie.h"
 #include "RunManagerSerial.h"
+#include "RunManagerThreaded.h"
 #include "RunManagerExternal.h"
 #include "SVD_PROPACK.h"
 #include "OutputFileWriter.h"
@@ -79,7 +80,7 @@ int main(int argc, char* argv[])
 		}
 
 		string complete_path;
-		enum class RunManagerType { SERIAL, YAMR, GENIE, EXTERNAL };
+		enum class RunManagerType { SERIAL, THREADED, YAMR, GENIE, EXTERNAL };
 
 		if (argc >= 2) {
 			complete_path = argv[1];
@@ -89,10 +90,12 @@ int main(int argc, char* argv[])
 			cerr << "usage:" << endl << endl;
 			cerr << "    serial run manager:" << endl;
 			cerr << "        pest++ pest_ctl_file.pst" << endl << endl;
+			cerr << "    local run manager with several workers:" << endl;
+			cerr << "        pest++ pest_ctl_file.pst /T number_of_workers" << endl << endl;
 			cerr << "    YAMR master:" << endl;
-			cerr << "        pest++ control_file.pst /H :port" << endl << endl;
+			cerr << "        pest++ control_file.pst /H :port [/B broker_hostname:port]" << endl << endl;
 			cerr << "    YAMR runner:" << endl;
-			cerr << "        pest++ /H hostname:port " << endl << endl;
+			cerr << "        pest++ /H hostname:port [/S number_of_slots]" << endl << endl;
 			cerr << "    GENIE:" << endl;
 			cerr << "        pest++ control_file.pst /G hostname:port" << endl << endl;
 			cerr << "    external run manager:" << endl;
@@ -108,6 +111,22 @@ int main(int argc, char* argv[])
 		vector<string>::const_iterator it_find, it_find_next;
 		string next_item;
 		string socket_str = "";
+		int n_workers = 0;
+		//Check for the threaded run manager
+		it_find = find(cmd_arg_vec.begin(), cmd_arg_vec.end(), "/t");
+		if (it_find != cmd_arg_vec.end())
+		{
+			if (it_find + 1 != cmd_arg_vec.end())
+			{
+				convert_ip(*(it_find + 1), n_workers);
+			}
+			if (n_workers < 1)
+			{
+				cerr << "threaded run manager requires the number of workers be specified as /T number_of_workers" << endl << endl;
+				throw(PestCommandlineError(commandline));
+			}
+			run_manager_type = RunManagerType::THREADED;
+		}
 		//Check for external run manager
 		it_find = find(cmd_arg_vec.begin(), cmd_arg_vec.end(), "/e");
 		if (it_find != cmd_arg_vec.end() )
@@ -135,6 +154,22 @@ int main(int argc, char* argv[])
 					throw(PestCommandlineError(commandline));
 				}
 				YAMRSlave yam_slave;
+				//Check for the number of concurrent runs
+				it_find = find(cmd_arg_vec.begin(), cmd_arg_vec.end(), "/s");
+				if (it_find != cmd_arg_vec.end())
+				{
+					int n_slots = 0;
+					if (it_find + 1 != cmd_arg_vec.end())
+					{
+						convert_ip(*(it_find + 1), n_slots);
+					}
+					if (n_slots < 1)
+					{
+						cerr << "YAMR slave requires the number of slots be specified as /S number_of_slots" << endl << endl;
+						throw(PestCommandlineError(commandline));
+					}
+					yam_slave.set_slots(n_slots);
+				}
 				yam_slave.start(sock_parts[0], sock_parts[1]);
 			}
 			catch (PestError &perr)
@@ -272,7 +307,29 @@ int main(int argc, char* argv[])
 				exi.insfile_vec, exi.outfile_vec,
 				file_manager.build_filename("rns"), port,
 				file_manager.open_ofile_ext("rmr"),
-				pest_scenario.get_pestpp_options().get_max_run_fail());
+				pest_scenario.get_pestpp_options().get_max_run_fail(),
+				pest_scenario.get_pestpp_options().get_yamr_batch_secs(),
+				pest_scenario.get_pestpp_options().get_yamr_recalibrate(),
+				pest_scenario.get_pestpp_options().get_yamr_compress(),
+				pest_scenario.get_pestpp_options().get_yamr_obs_tol());
+			//Check for a YAMR broker to provide slaves
+			it_find = find(cmd_arg_vec.begin(), cmd_arg_vec.end(), "/b");
+			if (it_find != cmd_arg_vec.end())
+			{
+				vector<string> broker_parts;
+				if (it_find + 1 != cmd_arg_vec.end())
+				{
+					next_item = *(it_find + 1);
+					strip_ip(next_item);
+					tokenize(next_item, broker_parts, ":");
+				}
+				if (broker_parts.size() != 2)
+				{
+					cerr << "YAMR broker must be specified as /B hostname:port" << endl << endl;
+					throw(PestCommandlineError(commandline));
+				}
+				static_cast<RunManagerYAMR*>(run_manager_ptr)->connect_broker(broker_parts[0], broker_parts[1]);
+			}
 		}
 		else if (run_manager_type == RunManagerType::GENIE)
 		{
@@ -291,6 +348,19 @@ int main(int argc, char* argv[])
 				file_manager.build_filename("exi"), 
 				pest_scenario.get_pestpp_options().get_max_run_fail());
 		}
+		else if (run_manager_type == RunManagerType::THREADED)
+		{
+			performance_log.log_event("starting basic model IO error checking", 1);
+			cout << "checking model IO files...";
+			pest_scenario.check_io();
+			performance_log.log_event("finished basic model IO error checking");
+			cout << "done" << endl;
+			const ModelExecInfo &exi = pest_scenario.get_model_exec_info();
+			run_manager_ptr = new RunManagerThreaded(exi.comline_vec,
+				exi.tplfile_vec, exi.inpfile_vec, exi.insfile_vec, exi.outfile_vec,
+				file_manager.build_filename("rns"), pathname, n_workers,
+				pest_scenario.get_pestpp_options().get_max_run_fail());
+		}
 		else
 		{
 			performance_log.log_event("starting basic model IO error checking", 1);
@@ -305,6 +375,12 @@ int main(int argc, char* argv[])
 				file_manager.build_filename("rns"), pathname,
 				pest_scenario.get_pestpp_options().get_max_run_fail());
 		}
+		run_manager_ptr->set_storage_mmap(pest_scenario.get_pestpp_options().get_storage_mmap());
+		run_manager_ptr->set_storage_group_commit(pest_scenario.get_pestpp_options().get_storage_commit_nruns(),
+			pest_scenario.get_pestpp_options().get_storage_commit_msec());
+		run_manager_ptr->set_storage_format(pest_scenario.get_pestpp_options().get_storage_obs_float32(),
+			pest_scenario.get_pestpp_options().get_storage_tile_nruns());
+		run_manager_ptr->set_max_run_secs(pest_scenario.get_pestpp_options().get_max_run_secs());
 
 		const ParamTransformSeq &base_trans_seq = pest_scenario.get_base_par_tran_seq();
 
@@ -219,6 +219,11 @@ bool Jacobian::build_runs(ModelRun &init_model_run, vector<string> numeric_par_n
 	Parameters numeric_pars = par_transform.ctl2numeric_cp(init_model_run.get_ctl_pars());
 
 	vector<double> del_numeric_par_vec;
+	const vector<string> &model_par_names = run_manager.get_par_name_vec();
+	// the perturbed values are found first so the parameters of all the runs can be written straight into
+	// the matrix that is added to the run manager as a single batch
+	vector<pair<string, vector<double> > > par_del_vec;
+	size_t n_runs = 0;
 	for(const auto &ipar_name : numeric_par_names)
 	{
 		debug_print(ipar_name);
@@ -229,13 +234,8 @@ bool Jacobian::build_runs(ModelRun &init_model_run, vector<string> numeric_par_n
 		if (success && !del_numeric_par_vec.empty())
 		{
 			debug_msg("success");
-			Parameters numeric_parameters = par_transform.ctl2numeric_cp(init_model_run.get_ctl_pars());
-			for (double ipar_val : del_numeric_par_vec)
-			{
-				numeric_parameters.update_rec(ipar_name, ipar_val);
-				Parameters model_parameters = par_transform.numeric2model_cp(numeric_parameters);
-				run_manager.add_run(model_parameters, ipar_name, ipar_val);
-			}
+			n_runs += del_numeric_par_vec.size();
+			par_del_vec.push_back(make_pair(ipar_name, del_numeric_par_vec));
 		}
 		else
 		{
@@ -243,6 +243,29 @@ bool Jacobian::build_runs(ModelRun &init_model_run, vector<string> numeric_par_n
 			failed_parameter_names.insert(ipar_name);
 		}
 	}
+	Eigen::MatrixXd run_pars_mat(n_runs, model_par_names.size());
+	vector<string> run_info_txt_vec;
+	vector<double> run_info_value_vec;
+	size_t i_run = 0;
+	for (const auto &par_del : par_del_vec)
+	{
+		Parameters numeric_parameters = par_transform.ctl2numeric_cp(init_model_run.get_ctl_pars());
+		for (double ipar_val : par_del.second)
+		{
+			numeric_parameters.update_rec(par_del.first, ipar_val);
+			Parameters model_parameters = par_transform.numeric2model_cp(numeric_parameters);
+			vector<double> model_par_vec = model_parameters.get_data_vec(model_par_names);
+			for (size_t j = 0; j < model_par_vec.size(); ++j)
+			{
+				run_pars_mat(i_run, j) = model_par_vec[j];
+			}
+			run_info_txt_vec.push_back(par_del.first);
+			run_info_value_vec.push_back(ipar_val);
+			++i_run;
+		}
+	}
+	// add all of the perturbation runs to the run manager as a single batch
+	run_manager.add_runs(run_pars_mat, run_info_txt_vec, run_info_value_vec);
 	debug_print(failed_parameter_names);
 	debug_msg("Jacobian::build_runs method: end");
 	if (failed_parameter_names.size() > 0)
@@ -270,10 +293,15 @@ bool Jacobian::process_runs(ParamTransformSeq &par_transform,
 
 	JacobianRun base_run;
 	int i_run = 0;
+	// model runs are read from the run manager storage in blocks
+	vector<JacobianRun> run_block;
+	vector<bool> run_block_success;
+	int block_beg = 0;
+	int block_end = read_run_block(run_manager, block_beg, run_block, run_block_success);
 	// get base run parameters and observation for initial model run from run manager storage
 	{
-			run_manager.get_model_parameters(i_run,  base_run.ctl_pars);
-			bool success = run_manager.get_observations_vec(i_run, base_run.obs_vec);
+		base_run = run_block[0];
+		bool success = run_block_success[0];
 		if (!success)
 		{
 			throw(PestError("Error: Super-parameter base parameter run failed.  Can not compute the Jacobian"));
@@ -296,10 +324,14 @@ bool Jacobian::process_runs(ParamTransformSeq &par_transform,
 	base_numeric_par_names.clear();
 	for(; i_run<nruns; ++i_run)
 	{
-		run_list.push_back(JacobianRun());
-				run_manager. get_info(i_run, r_status, cur_par_name, cur_numeric_par_value);
-		run_manager.get_model_parameters(i_run,  run_list.back().ctl_pars);
-			bool success = run_manager.get_observations_vec(i_run, run_list.back().obs_vec);
+		if (i_run >= block_end)
+		{
+			block_beg = i_run;
+			block_end = block_beg + read_run_block(run_manager, block_beg, run_block, run_block_success);
+		}
+		run_list.push_back(run_block[i_run - block_beg]);
+		bool success = run_block_success[i_run - block_beg];
+		run_manager.get_info(i_run, r_status, cur_par_name, cur_numeric_par_value);
 		if (success)
 		{
 			par_transform.model2ctl_ip(run_list.back().ctl_pars);
@@ -345,6 +377,33 @@ bool Jacobian::process_runs(ParamTransformSeq &par_transform,
 	return true;
 }
 
+int Jacobian::read_run_block(RunManagerAbstract &run_manager, int run_beg, vector<JacobianRun> &run_block, vector<bool> &success_vec)
+{
+	// read a block of consecutive model runs starting at run_beg from the run manager storage.
+	// The number of runs read is limited so the block does not require more than max_run_block_byte_size
+	const vector<string> &model_par_names = run_manager.get_par_name_vec();
+	size_t n_obs = run_manager.get_obs_name_vec().size();
+	size_t run_byte_size = (model_par_names.size() + n_obs) * sizeof(double);
+	int n_block = max(size_t(1), max_run_block_byte_size / max(run_byte_size, size_t(1)));
+	int run_end = min(run_beg + n_block, run_manager.get_nruns());
+	vector<int> run_ids;
+	for (int i_run = run_beg; i_run < run_end; ++i_run)
+	{
+		run_ids.push_back(i_run);
+	}
+	Eigen::MatrixXd run_pars;
+	Eigen::MatrixXd run_obs;
+	run_manager.get_runs(run_ids, run_pars, run_obs, success_vec);
+	run_block.resize(run_ids.size());
+	for (size_t i = 0; i < run_ids.size(); ++i)
+	{
+		run_block[i].ctl_pars = Parameters(model_par_names, run_pars.row(i).transpose());
+		run_block[i].obs_vec.resize(n_obs);
+		Eigen::Map<Eigen::RowVectorXd>(run_block[i].obs_vec.data(), n_obs) = run_obs.row(i);
+	}
+	return run_ids.size();
+}
+
 bool Jacobian::get_derivative_parameters(const string &par_name, Parameters &numeric_pars, ParamTransformSeq &par_transform, const ParameterGroupInfo &group_info, const ParameterInfo &ctl_par_info, 
 		vector<double> &delta_numeric_par_vec, bool phiredswh_flag, set<string> &out_of_bound_par)
 {
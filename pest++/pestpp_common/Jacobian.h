@@ -89,6 +89,8 @@ public:
 	Jacobian& operator=(const Jacobian &rhs);
 	virtual const std::set<std::string>&  failed_runs_par_names(){ return  failed_parameter_names; }
 	virtual ~Jacobian();
+	// maximum memory used by a block of model runs read from the run manager storage
+	static const size_t max_run_block_byte_size = 16 * 1024 * 1024;
 protected:
 	vector<string> base_numeric_par_names;  //ordered names of base parameters used to calculate the jacobian
 	Parameters base_numeric_parameters;  //values of base parameters used to calculate the jacobian
@@ -112,6 +114,7 @@ protected:
 		vector<double> &delta_numeric_par_vec, bool phiredswh_flag, set<string> &out_of_bound_par);
 	virtual unordered_map<string, int> get_par2col_map() const;
 	virtual unordered_map<string, int> get_obs2row_map() const;
+	virtual int read_run_block(RunManagerAbstract &run_manager, int run_beg, std::vector<JacobianRun> &run_block, std::vector<bool> &success_vec);
 };
 
 #endif /* JACOBIAN_H_ */
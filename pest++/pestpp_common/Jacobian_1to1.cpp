@@ -72,6 +72,18 @@ bool Jacobian_1to1::build_runs(ModelRun &init_model_run, vector<string> numeric_
 	bool success;
 	Parameters base_derivative_parameters = par_transform.numeric2active_ctl_cp(base_numeric_parameters);
 	Parameters base_model_parameters = par_transform.numeric2model_cp(base_numeric_parameters);
+	// the perturbed parameter sets are accumulated and added to the run manager as a single batch
+	const vector<string> &model_par_names = run_manager.get_par_name_vec();
+	unordered_map<string, int> model_par_idx_map;
+	for (size_t i = 0; i < model_par_names.size(); ++i)
+	{
+		model_par_idx_map[model_par_names[i]] = i;
+	}
+	vector<double> model_par_vec = model_parameters.get_data_vec(model_par_names);
+	// the perturbed values are found first so the parameters of all the runs can be written straight into
+	// the matrix that is added to the run manager as a single batch
+	vector<pair<string, vector<double> > > par_del_vec;
+	size_t n_runs = 0;
 	//Loop through derivative parameters and build the parameter sets necessary for computing the jacobian
 	for (auto &i_name : numeric_par_names)
 	{
@@ -82,23 +94,8 @@ bool Jacobian_1to1::build_runs(ModelRun &init_model_run, vector<string> numeric_
 			tmp_del_numeric_par_vec, phiredswh_flag);
 		if (success && !tmp_del_numeric_par_vec.empty())
 		{
-			// update changed model parameters in model_parameters
-			for (const auto &par : tmp_del_numeric_par_vec)
-			{
-				Parameters new_pars;
-				new_pars.insert(make_pair(i_name, par));
-				par_transform.active_ctl2model_ip(new_pars);
-				for (auto &ipar : new_pars)
-				{
-					model_parameters[ipar.first] = ipar.second;
-				}
-				int id = run_manager.add_run(model_parameters, i_name, par);
-				//reset the perturbed parameters back to the values associated with the base condition
-				for (const auto &ipar : new_pars)
-				{
-					model_parameters[ipar.first] = base_model_parameters[ipar.first];
-				}
-			}
+			n_runs += tmp_del_numeric_par_vec.size();
+			par_del_vec.push_back(make_pair(i_name, tmp_del_numeric_par_vec));
 		}
 		else 
 		{
@@ -106,6 +103,37 @@ bool Jacobian_1to1::build_runs(ModelRun &init_model_run, vector<string> numeric_
 			failed_to_increment_parmaeters.insert(i_name, derivative_par_value);
 		}
 	}
+	Eigen::MatrixXd run_pars_mat(n_runs, model_par_names.size());
+	vector<string> run_info_txt_vec;
+	vector<double> run_info_value_vec;
+	size_t i_run = 0;
+	for (const auto &par_del : par_del_vec)
+	{
+		// update changed model parameters in model_parameters
+		for (const auto &par : par_del.second)
+		{
+			Parameters new_pars;
+			new_pars.insert(make_pair(par_del.first, par));
+			par_transform.active_ctl2model_ip(new_pars);
+			for (auto &ipar : new_pars)
+			{
+				model_par_vec[model_par_idx_map.at(ipar.first)] = ipar.second;
+			}
+			for (size_t j = 0; j < model_par_vec.size(); ++j)
+			{
+				run_pars_mat(i_run, j) = model_par_vec[j];
+			}
+			run_info_txt_vec.push_back(par_del.first);
+			run_info_value_vec.push_back(par);
+			++i_run;
+			//reset the perturbed parameters back to the values associated with the base condition
+			for (const auto &ipar : new_pars)
+			{
+				model_par_vec[model_par_idx_map.at(ipar.first)] = base_model_parameters[ipar.first];
+			}
+		}
+	}
+	run_manager.add_runs(run_pars_mat, run_info_txt_vec, run_info_value_vec);
 	ofstream &fout_restart = file_manager.get_ofstream("rst");
 	debug_print(failed_parameter_names);
 	debug_msg("Jacobian_1to1::build_runs end");
@@ -135,9 +163,14 @@ bool Jacobian_1to1::process_runs(ParamTransformSeq &par_transform,
 
 	JacobianRun base_run;
 	int i_run = 0;
+	// model runs are read from the run manager storage in blocks
+	vector<JacobianRun> run_block;
+	vector<bool> run_block_success;
+	int block_beg = 0;
+	int block_end = read_run_block(run_manager, block_beg, run_block, run_block_success);
 	// get base run parameters and observation for initial model run from run manager storage
-	run_manager.get_model_parameters(i_run,  base_run.ctl_pars);
-	bool success = run_manager.get_observations_vec(i_run, base_run.obs_vec);
+	base_run = run_block[0];
+	bool success = run_block_success[0];
 	if (!success)
 	{
 		throw(PestError("Error: Base parameter run failed.  Can not compute the Jacobian"));
@@ -161,10 +194,14 @@ bool Jacobian_1to1::process_runs(ParamTransformSeq &par_transform,
 	list<JacobianRun> run_list;
 	for(; i_run<nruns; ++i_run)
 	{
-		run_list.push_back(JacobianRun());
-		run_manager. get_info(i_run, r_status, cur_par_name, cur_numeric_par_value);
-		run_manager.get_model_parameters(i_run,  run_list.back().ctl_pars);
-	    bool success = run_manager.get_observations_vec(i_run, run_list.back().obs_vec);
+		if (i_run >= block_end)
+		{
+			block_beg = i_run;
+			block_end = block_beg + read_run_block(run_manager, block_beg, run_block, run_block_success);
+		}
+		run_list.push_back(run_block[i_run - block_beg]);
+		bool success = run_block_success[i_run - block_beg];
+		run_manager.get_info(i_run, r_status, cur_par_name, cur_numeric_par_value);
 		run_list.back().numeric_derivative_par = cur_numeric_par_value;
 
 		if (success)
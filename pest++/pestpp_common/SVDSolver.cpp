@@ -821,6 +821,11 @@ ModelRun SVDSolver::iteration_upgrd(RunManagerAbstract &run_manager, Termination
 		stringstream prf_message;
 
 		ofstream &fout_frz = file_manager.open_ofile_ext("fpr");
+		// the upgrade runs are accumulated and added to the run manager as a single batch
+		const vector<string> &model_par_names = run_manager.get_par_name_vec();
+		Eigen::MatrixXd upgrade_pars_mat(lambda_vec.size(), model_par_names.size());
+		vector<string> upgrade_info_txt_vec;
+		vector<Parameters> upgrade_frozen_pars_vec;
 		for (double i_lambda : lambda_vec)
 		{
 			prf_message.str("");
@@ -840,10 +845,16 @@ ModelRun SVDSolver::iteration_upgrd(RunManagerAbstract &run_manager, Termination
 				new_pars, MarquardtMatrix::IDENT, false);
 
 			par_transform.active_ctl2model_ip(new_pars);
-			int run_id = run_manager.add_run(new_pars, "upgrade_run", i_lambda);
-			save_frozen_pars(fout_frz, frozen_active_ctl_pars, run_id);
+			upgrade_pars_mat.row(upgrade_info_txt_vec.size()) = new_pars.get_data_eigen_vec(model_par_names).transpose();
+			upgrade_info_txt_vec.push_back("upgrade_run");
+			upgrade_frozen_pars_vec.push_back(frozen_active_ctl_pars);
 			performance_log->add_indent(-1);
 		}
+		vector<int> upgrade_run_ids = run_manager.add_runs(upgrade_pars_mat, upgrade_info_txt_vec, lambda_vec);
+		for (size_t i = 0; i < upgrade_run_ids.size(); ++i)
+		{
+			save_frozen_pars(fout_frz, upgrade_frozen_pars_vec[i], upgrade_run_ids[i]);
+		}
 		file_manager.close_file("fpr");
 		RestartController::write_upgrade_runs_built(fout_restart);
 	}
@@ -257,6 +257,16 @@ ostream& operator<< (ostream &os, const PestppOptions& val)
 	os << "    mat inv = " << left << setw(20) << val.get_mat_inv() << endl;
 	os << "    max run fail = " << left << setw(20) << val.get_max_run_fail() << endl;
 	os << "    max reg iter = " << left << setw(20) << val.get_max_reg_iter() << endl;	
+	os << "    storage mmap = " << left << setw(20) << boolalpha << val.get_storage_mmap() << noboolalpha << endl;
+	os << "    storage commit nruns = " << left << setw(20) << val.get_storage_commit_nruns() << endl;
+	os << "    storage commit msec = " << left << setw(20) << val.get_storage_commit_msec() << endl;
+	os << "    storage obs float32 = " << left << setw(20) << boolalpha << val.get_storage_obs_float32() << noboolalpha << endl;
+	os << "    storage tile nruns = " << left << setw(20) << val.get_storage_tile_nruns() << endl;
+	os << "    max run secs = " << left << setw(20) << val.get_max_run_secs() << endl;
+	os << "    yamr batch secs = " << left << setw(20) << val.get_yamr_batch_secs() << endl;
+	os << "    yamr recalibrate = " << left << setw(20) << boolalpha << val.get_yamr_recalibrate() << noboolalpha << endl;
+	os << "    yamr compress = " << left << setw(20) << boolalpha << val.get_yamr_compress() << noboolalpha << endl;
+	os << "    yamr obs tol = " << left << setw(20) << val.get_yamr_obs_tol() << endl;
 	os << "    lambdas = " << endl;
 	for (auto &lam : val.get_base_lambda_vec())
 	{
@@ -272,7 +282,10 @@ PestppOptions::PestppOptions(int _n_iter_base, int _n_iter_super, int _max_n_sup
 	: n_iter_base(_n_iter_base), n_iter_super(_n_iter_super), max_n_super(_max_n_super), super_eigthres(_super_eigthres), 
 	svd_pack(_svd_pack), mat_inv(_mat_inv), auto_norm(_auto_norm), super_relparmax(_super_relparmax),
 	max_run_fail(_max_run_fail), max_super_frz_iter(50), max_reg_iter(50), base_lambda_vec({ 0.1, 1.0, 10.0, 100.0, 1000.0 }),
-	iter_summary_flag(_iter_summary_flag), der_forgive(_der_forgive)
+	iter_summary_flag(_iter_summary_flag), der_forgive(_der_forgive), storage_mmap(false),
+	storage_commit_nruns(0), storage_commit_msec(0), storage_obs_float32(false), storage_tile_nruns(0),
+	max_run_secs(0.0), yamr_batch_secs(0.0), yamr_recalibrate(false),
+	yamr_compress(false), yamr_obs_tol(0.0)
 {
 }
 
@@ -354,6 +367,46 @@ void PestppOptions::parce_line(const string &line)
 			istringstream is(value);
 			is >> boolalpha >> der_forgive;
 		}
+		else if (key == "STORAGE_MMAP")
+		{
+			transform(value.begin(), value.end(), value.begin(), ::tolower);
+			istringstream is(value);
+			is >> boolalpha >> storage_mmap;
+		}
+		else if (key == "STORAGE_COMMIT_NRUNS"){
+			convert_ip(value, storage_commit_nruns);
+		}
+		else if (key == "STORAGE_COMMIT_MSEC"){
+			convert_ip(value, storage_commit_msec);
+		}
+		else if (key == "STORAGE_OBS_FLOAT32")
+		{
+			transform(value.begin(), value.end(), value.begin(), ::tolower);
+			istringstream is(value);
+			is >> boolalpha >> storage_obs_float32;
+		}
+		else if (key == "STORAGE_TILE_NRUNS"){
+			convert_ip(value, storage_tile_nruns);
+		}
+		else if (key == "YAMR_BATCH_SECS"){
+			convert_ip(value, yamr_batch_secs);
+		}
+		else if (key == "YAMR_RECALIBRATE"){
+			transform(value.begin(), value.end(), value.begin(), ::tolower);
+			istringstream is(value);
+			is >> boolalpha >> yamr_recalibrate;
+		}
+		else if (key == "YAMR_COMPRESS"){
+			transform(value.begin(), value.end(), value.begin(), ::tolower);
+			istringstream is(value);
+			is >> boolalpha >> yamr_compress;
+		}
+		else if (key == "YAMR_OBS_TOL"){
+			convert_ip(value, yamr_obs_tol);
+		}
+		else if (key == "MAX_RUN_SECS"){
+			convert_ip(value, max_run_secs);
+		}
 		else {
 			throw PestParsingError(line, "Invalid key word \"" + key +"\"");
 		}
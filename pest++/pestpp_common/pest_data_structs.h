@@ -213,6 +213,16 @@ public:
 	const vector<double>& get_base_lambda_vec() const {return base_lambda_vec;}	
 	bool get_iter_summary_flag() const { return iter_summary_flag;  }
 	bool get_der_forgive() const { return der_forgive; }
+	bool get_storage_mmap() const { return storage_mmap; }
+	int get_storage_commit_nruns() const { return storage_commit_nruns; }
+	int get_storage_commit_msec() const { return storage_commit_msec; }
+	bool get_storage_obs_float32() const { return storage_obs_float32; }
+	int get_storage_tile_nruns() const { return storage_tile_nruns; }
+	double get_max_run_secs() const { return max_run_secs; }
+	double get_yamr_batch_secs() const { return yamr_batch_secs; }
+	bool get_yamr_recalibrate() const { return yamr_recalibrate; }
+	bool get_yamr_compress() const { return yamr_compress; }
+	double get_yamr_obs_tol() const { return yamr_obs_tol; }
 	void set_max_n_super(int _max_n_super) {max_n_super = _max_n_super;}
 	void set_super_eigthres(double _super_eigthres) {super_eigthres = _super_eigthres;}
 	void set_n_iter_base(int _n_iter_base) {n_iter_base = _n_iter_base;}
@@ -225,6 +235,16 @@ public:
 	void set_max_super_frz_iter(int n) { max_super_frz_iter = n; }
 	void set_max_reg_iter(int n) { max_reg_iter = n; }	
 	void set_iter_summary_flag(bool _iter_summary_flag){iter_summary_flag = _iter_summary_flag;}
+	void set_storage_mmap(bool _storage_mmap) { storage_mmap = _storage_mmap; }
+	void set_storage_commit_nruns(int n) { storage_commit_nruns = n; }
+	void set_storage_commit_msec(int msec) { storage_commit_msec = msec; }
+	void set_storage_obs_float32(bool _storage_obs_float32) { storage_obs_float32 = _storage_obs_float32; }
+	void set_storage_tile_nruns(int n) { storage_tile_nruns = n; }
+	void set_max_run_secs(double secs) { max_run_secs = secs; }
+	void set_yamr_batch_secs(double sec) { yamr_batch_secs = sec; }
+	void set_yamr_recalibrate(bool _yamr_recalibrate) { yamr_recalibrate = _yamr_recalibrate; }
+	void set_yamr_compress(bool _yamr_compress) { yamr_compress = _yamr_compress; }
+	void set_yamr_obs_tol(double tol) { yamr_obs_tol = tol; }
 private:
 	int n_iter_base;
 	int n_iter_super;
@@ -240,6 +260,16 @@ private:
 	vector<double> base_lambda_vec;	
 	bool iter_summary_flag;
 	bool der_forgive;
+	bool storage_mmap;
+	int storage_commit_nruns;
+	int storage_commit_msec;
+	bool storage_obs_float32;
+	int storage_tile_nruns;
+	double max_run_secs;
+	double yamr_batch_secs;
+	bool yamr_recalibrate;
+	bool yamr_compress;
+	double yamr_obs_tol;
 };
 ostream& operator<< (ostream &os, const PestppOptions& val);
 ostream& operator<< (ostream &os, const ObservationInfo& val);
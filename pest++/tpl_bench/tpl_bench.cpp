@@ -0,0 +1,325 @@
+/*
+ Copyright 2012, David Welter
+
+This file is part of PEST++.
+
+PEST++ is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PEST++ is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <set>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "utilities.h"
+#include "template_writer.h"
+
+using namespace std;
+
+// Compares the time taken to write model input files with the fortran wrttpl routine and with
+// TemplateWriter.  For each run, random parameter values are written to the template files given on the
+// command line with both methods, and the input files and the values returned are checked to be identical.
+// The input files are written to the current directory and removed at the end.
+// With -values, TemplateWriter::format_value is compared with the fortran wrtsig routine for random values
+// and field widths instead.
+
+extern "C"
+{
+	void wrttpl_(int *,
+		char *,
+		char *,
+		int *,
+		char *,
+		double *,
+		int *);
+	void wrtsig_(int *,
+		double *,
+		char *,
+		int *,
+		int *,
+		double *,
+		int *,
+		int);
+}
+
+void usage(ostream &fout)
+{
+	fout << "--------------------------------------------------------" << endl;
+	fout << "usage:" << endl << endl;
+	fout << "  tpl_bench n_runs tpl_file [tpl_file ...]" << endl;
+	fout << "  tpl_bench -values n_values" << endl << endl;
+	fout << " where:" << endl;
+	fout << "  n_runs:      number of sets of parameter values to write" << endl;
+	fout << "  tpl_file:    PEST template file" << endl;
+	fout << "  n_values:    number of values to write with each field width" << endl;
+	fout << "--------------------------------------------------------" << endl;
+}
+
+// add the names of the parameters in a template file to par_set
+void read_par_names(const string &tpl_filename, set<string> &par_set)
+{
+	ifstream fin(tpl_filename);
+	string line;
+	if (!fin || !getline(fin, line) || line.size() < 5)
+	{
+		throw runtime_error("could not read template file: " + tpl_filename);
+	}
+	char marker = line[4];
+	while (getline(fin, line))
+	{
+		size_t end = 0;
+		while (true)
+		{
+			size_t start = line.find(marker, end);
+			if (start == string::npos) break;
+			end = line.find(marker, start + 1);
+			if (end == string::npos) break;
+			string name = line.substr(start + 1, end - start - 1);
+			pest_utils::strip_ip(name);
+			pest_utils::upper_ip(name);
+			par_set.insert(name);
+			++end;
+		}
+	}
+}
+
+string read_file(const string &filename)
+{
+	ifstream fin(filename, ios::binary);
+	stringstream buf;
+	buf << fin.rdbuf();
+	return buf.str();
+}
+
+// a random value for the format check.  The values are chosen to cover the whole double range, the range
+// written without an exponent and values close to rounding boundaries such as 9.9999995 and 0.00012345
+double random_value(mt19937_64 &rng)
+{
+	uniform_int_distribution<int> mode_dist(0, 4);
+	uniform_int_distribution<int> sign_dist(0, 1);
+	uniform_real_distribution<double> exp_dist(-10.0, 10.0);
+	uniform_int_distribution<int> exp10_dist(-40, 40);
+	uniform_int_distribution<int> n_digit_dist(1, 17);
+	double val = 0.0;
+	switch (mode_dist(rng))
+	{
+	case 0:
+		{
+			// any finite double
+			uint64_t bits;
+			do
+			{
+				bits = rng();
+				memcpy(&val, &bits, sizeof(val));
+			} while (!std::isfinite(val));
+			break;
+		}
+	case 1:
+		val = pow(10.0, exp_dist(rng));
+		break;
+	case 2:
+		{
+			// a run of nines, which carries into the next digit when it is rounded
+			int n_digit = n_digit_dist(rng);
+			double digits = pow(10.0, n_digit) - 1.0;
+			val = digits * pow(10.0, exp10_dist(rng) - n_digit);
+			break;
+		}
+	case 3:
+		{
+			// a value that ends in 5, half way between two shorter values
+			int n_digit = n_digit_dist(rng);
+			uniform_int_distribution<int64_t> digit_dist(0, int64_t(pow(10.0, n_digit - 1)) - 1);
+			double digits = double(digit_dist(rng)) * 10.0 + 5.0;
+			val = digits * pow(10.0, exp10_dist(rng) - n_digit);
+			break;
+		}
+	default:
+		{
+			// a short decimal value and its neighbours
+			uniform_int_distribution<int> short_dist(0, 9999);
+			val = short_dist(rng) * pow(10.0, exp10_dist(rng) / 4);
+			uniform_int_distribution<int> step_dist(-1, 1);
+			int step = step_dist(rng);
+			if (step != 0) val = nextafter(val, step * HUGE_VAL);
+			break;
+		}
+	}
+	// format_value writes negative zero as zero, where wrtsig writes -.00 or asterisks
+	if (val == 0.0) return 0.0;
+	return sign_dist(rng) ? -val : val;
+}
+
+// compare TemplateWriter::format_value with wrtsig for n_values random values and each field width
+int check_values(int n_values)
+{
+	mt19937_64 rng(2718);
+	int n_mismatch = 0;
+	long long n_checked = 0;
+	double f_sec = 0;
+	double c_sec = 0;
+	vector<double> values(n_values);
+	for (int width = 1; width <= TemplateWriter::MAX_VALUE_WIDTH + 2; ++width)
+	{
+		for (auto &val : values) val = random_value(rng);
+		vector<string> f_words(n_values);
+		vector<double> f_tvals(n_values);
+		vector<int> f_fails(n_values);
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < n_values; ++i)
+		{
+			char word[50];
+			int precis = 0;
+			int nopnt = 0;
+			wrtsig_(&f_fails[i], &values[i], word, &width, &precis, &f_tvals[i], &nopnt, 50);
+			int len = 50;
+			while (len > 0 && word[len - 1] == ' ') --len;
+			f_words[i].assign(word, len);
+		}
+		f_sec += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1.0E6;
+
+		vector<string> c_words(n_values);
+		vector<double> c_tvals(n_values);
+		start = chrono::steady_clock::now();
+		for (int i = 0; i < n_values; ++i)
+		{
+			char text[TemplateWriter::MAX_VALUE_WIDTH + 1];
+			int len = TemplateWriter::format_value(values[i], width, text, c_tvals[i]);
+			c_words[i].assign(text, len);
+		}
+		c_sec += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1.0E6;
+
+		for (int i = 0; i < n_values; ++i)
+		{
+			bool match;
+			if (f_fails[i] != 0) match = c_words[i].empty();
+			else match = (f_words[i] == c_words[i]
+				&& memcmp(&f_tvals[i], &c_tvals[i], sizeof(double)) == 0);
+			if (!match)
+			{
+				if (n_mismatch < 20)
+				{
+					char buf[40];
+					snprintf(buf, sizeof(buf), "%.17g", values[i]);
+					cerr << "  width " << width << ", value " << buf << ": wrtsig \"" << f_words[i]
+						<< "\", format_value \"" << c_words[i] << "\"" << endl;
+				}
+				++n_mismatch;
+			}
+			++n_checked;
+		}
+	}
+	cout << n_checked << " values" << endl;
+	cout << "  wrtsig: " << f_sec << " sec" << endl;
+	cout << "  format_value: " << c_sec << " sec" << endl;
+	cout << "  speedup: " << f_sec / max(c_sec, 1.0E-6) << endl;
+	cout << "  values with different output: " << n_mismatch << endl;
+	return (n_mismatch == 0) ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc == 3 && string(argv[1]) == "-values" && atoi(argv[2]) > 0)
+	{
+		return check_values(atoi(argv[2]));
+	}
+	if (argc < 3 || atoi(argv[1]) <= 0)
+	{
+		usage(cerr);
+		return 1;
+	}
+	int n_runs = atoi(argv[1]);
+	vector<string> tpl_vec(argv + 2, argv + argc);
+	set<string> par_set;
+	for (auto &tpl : tpl_vec)
+	{
+		read_par_names(tpl, par_set);
+	}
+	vector<string> par_names(par_set.begin(), par_set.end());
+	// wrttpl only accepts file names of up to 50 characters
+	vector<string> f_inp_vec;
+	vector<string> c_inp_vec;
+	for (size_t i = 0; i < tpl_vec.size(); ++i)
+	{
+		f_inp_vec.push_back("tpl_bench_" + to_string(i) + "_f.in");
+		c_inp_vec.push_back("tpl_bench_" + to_string(i) + "_c.in");
+	}
+
+	auto start = chrono::steady_clock::now();
+	TemplateWriter writer(tpl_vec, par_names);
+	double compile_sec = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1.0E6;
+	cout << tpl_vec.size() << " template files, " << par_names.size() << " parameters, " << n_runs << " runs" << endl;
+	cout << "  template compile: " << compile_sec << " sec" << endl;
+
+	mt19937 rng(2718);
+	uniform_real_distribution<double> exp_dist(-3.0, 3.0);
+	uniform_int_distribution<int> sign_dist(0, 1);
+	int ntpl = tpl_vec.size();
+	int npar = par_names.size();
+	double f_sec = 0;
+	double c_sec = 0;
+	int n_mismatch = 0;
+	for (int i_run = 0; i_run < n_runs; ++i_run)
+	{
+		vector<double> f_values;
+		for (int i = 0; i < npar; ++i)
+		{
+			double val = pow(10.0, exp_dist(rng));
+			f_values.push_back(sign_dist(rng) ? -val : val);
+		}
+		vector<double> c_values = f_values;
+
+		// the fortran arrays are built for every run in the same way as the run managers did
+		int ifail = 0;
+		start = chrono::steady_clock::now();
+		wrttpl_(&ntpl, pest_utils::StringvecFortranCharArray(tpl_vec, 50).get_prt(),
+			pest_utils::StringvecFortranCharArray(f_inp_vec, 50).get_prt(),
+			&npar, pest_utils::StringvecFortranCharArray(par_names, 50, pest_utils::TO_LOWER).get_prt(),
+			f_values.data(), &ifail);
+		f_sec += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1.0E6;
+		if (ifail != 0)
+		{
+			cerr << "wrttpl failed" << endl;
+			return 1;
+		}
+
+		start = chrono::steady_clock::now();
+		writer.write(c_values, c_inp_vec);
+		c_sec += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1.0E6;
+
+		bool match = (memcmp(f_values.data(), c_values.data(), npar * sizeof(double)) == 0);
+		for (int i = 0; i < ntpl && match; ++i)
+		{
+			match = (read_file(f_inp_vec[i]) == read_file(c_inp_vec[i]));
+		}
+		if (!match) ++n_mismatch;
+	}
+	for (int i = 0; i < ntpl; ++i)
+	{
+		remove(f_inp_vec[i].c_str());
+		remove(c_inp_vec[i].c_str());
+	}
+	cout << "  wrttpl: " << f_sec << " sec, " << n_runs / max(f_sec, 1.0E-6) << " runs/sec" << endl;
+	cout << "  TemplateWriter: " << c_sec << " sec, " << n_runs / max(c_sec, 1.0E-6) << " runs/sec" << endl;
+	cout << "  speedup: " << f_sec / max(c_sec, 1.0E-6) << endl;
+	cout << "  runs with different output: " << n_mismatch << endl;
+	return (n_mismatch == 0) ? 0 : 1;
+}
@@ -31,7 +31,7 @@ RunManagerAbstract::RunManagerAbstract(const vector<string> _comline_vec,
 	const vector<string> _tplfile_vec, const vector<string> _inpfile_vec,
 	const vector<string> _insfile_vec, const vector<string> _outfile_vec,
 	const string &stor_filename, int _max_n_failure)
-  : total_runs(0), max_n_failure(_max_n_failure), file_stor(stor_filename),
+  : total_runs(0), max_n_failure(_max_n_failure), max_run_secs(0), file_stor(stor_filename),
     comline_vec(_comline_vec), tplfile_vec(_tplfile_vec),
     inpfile_vec(_inpfile_vec), insfile_vec(_insfile_vec), outfile_vec(_outfile_vec)	
 {
@@ -85,6 +85,11 @@ int RunManagerAbstract::add_run(const Eigen::VectorXd &model_pars, const string
 	return run_id;
 }
 
+vector<int> RunManagerAbstract::add_runs(const Eigen::MatrixXd &model_pars, const vector<string> &info_txt_vec, const vector<double> &info_value_vec)
+{
+	return file_stor.add_runs(model_pars, info_txt_vec, info_value_vec);
+}
+
 void RunManagerAbstract::update_run(int run_id, const Parameters &pars, const Observations &obs)
 {
 
@@ -138,6 +143,17 @@ bool RunManagerAbstract::get_run(int run_id, vector<double> &pars_vec, vector<do
 	return get_run(run_id, pars_vec, obs_vec, info_txt, info_value);
 }
 
+void RunManagerAbstract::get_runs(const vector<int> &run_ids, Eigen::MatrixXd &pars, Eigen::MatrixXd &obs, vector<bool> &success_vec)
+{
+	vector<int> status_vec;
+	file_stor.get_runs(run_ids, pars, obs, status_vec);
+	success_vec.resize(status_vec.size());
+	for (size_t i = 0; i < status_vec.size(); ++i)
+	{
+		success_vec[i] = status_vec[i] > 0;
+	}
+}
+
 bool  RunManagerAbstract::get_run(int run_id, double *pars, size_t npars, double *obs, size_t nobs, string &info_txt, double &info_value)
 {
 	bool success = false;
@@ -176,9 +192,9 @@ bool RunManagerAbstract::n_run_failures_exceeded(int id)
 
 const std::set<int> RunManagerAbstract::get_failed_run_ids()
 {
+	// only unfinished runs can have exceeded the maximum number of failures
 	std::set<int> failed_runs;
-	int n_runs = file_stor.get_nruns();
-	for (int id=0; id<n_runs; ++id)
+	for (int id : file_stor.get_unfinished_run_ids())
 	{
 		if(n_run_failures_exceeded(id))
 		 {
@@ -191,8 +207,7 @@ const std::set<int> RunManagerAbstract::get_failed_run_ids()
 int RunManagerAbstract::get_num_failed_runs(void)
 {
 	int n_failed = 0;
-	int n_runs = file_stor.get_nruns();
-	for (int id=0; id<n_runs; ++id)
+	for (int id : file_stor.get_unfinished_run_ids())
 	 {
 		if(n_run_failures_exceeded(id))
 		{
@@ -251,9 +266,9 @@ bool RunManagerAbstract::get_observations_vec(int run_id, vector<double> &data_v
 
  vector<int> RunManagerAbstract::get_outstanding_run_ids()
  {
+	 // completed and canceled runs are not tracked in the unfinished run set
 	 vector<int> run_ids;
-	 int n_runs = file_stor.get_nruns();
-	 for (int id=0; id<n_runs; ++id)
+	 for (int id : file_stor.get_unfinished_run_ids())
 	 {
 		 if(run_requried(id))
 		 {
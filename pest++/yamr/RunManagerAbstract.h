@@ -45,6 +45,8 @@ public:
 	virtual int add_run(const Parameters &model_pars, const std::string &info_txt="", double info_value=RunStorage::no_data);
 	virtual int add_run(const std::vector<double> &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
 	virtual int add_run(const Eigen::VectorXd &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
+	virtual std::vector<int> add_runs(const Eigen::MatrixXd &model_pars, const std::vector<std::string> &info_txt_vec = std::vector<std::string>(),
+		const std::vector<double> &info_value_vec = std::vector<double>());
 	virtual void update_run(int run_id, const Parameters &pars, const Observations &obs);
 	virtual void run() = 0;
 	virtual const std::vector<std::string> &get_par_name_vec() const;
@@ -56,6 +58,7 @@ public:
 	virtual bool get_run(int run_id, double *pars, size_t npars, double *obs, size_t nobs);
 	virtual bool get_run(int run_id, std::vector<double> &pars_vec, std::vector<double> &obs_vec, std::string &info_txt, double &info_value);
 	virtual bool get_run(int run_id, std::vector<double> &pars_vec, std::vector<double> &obs_vec);
+	virtual void get_runs(const std::vector<int> &run_ids, Eigen::MatrixXd &pars, Eigen::MatrixXd &obs, std::vector<bool> &success_vec);
 	virtual const std::set<int> get_failed_run_ids();
 	virtual bool get_model_parameters(int run_num, Parameters &pars);
 	virtual bool get_observations_vec(int run_id, std::vector<double> &data_vec);
@@ -68,10 +71,15 @@ public:
 	virtual std::vector<int> get_outstanding_run_ids();
 	virtual ~RunManagerAbstract(void) {}
 	virtual std::string get_run_filename() { return file_stor.get_filename(); }
+	virtual void set_storage_mmap(bool use_mmap) { file_stor.set_use_mmap(use_mmap); }
+	virtual void set_storage_group_commit(int commit_nruns, int commit_msec) { file_stor.set_group_commit(commit_nruns, commit_msec); }
+	virtual void set_storage_format(bool obs_float32, int tile_nruns) { file_stor.set_format(obs_float32, tile_nruns); }
+	virtual void set_max_run_secs(double secs) { max_run_secs = secs; }
 protected:
 	int total_runs;
 	int max_n_failure; // maximium number of times to retry a failed model run
 	int cur_group_id;  // used in some of the derived classes (ie YAMR)
+	double max_run_secs; // local model runs are killed after this many seconds (no limit if <= 0)
 	RunStorage file_stor;
 	std::vector<std::string> comline_vec;
 	std::vector<std::string> tplfile_vec;
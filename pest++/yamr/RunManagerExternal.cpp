@@ -13,6 +13,8 @@ RunManagerExternal::RunManagerExternal(const vector<string> _comline_vec,
 	_insfile_vec, _outfile_vec, stor_filename, _max_n_failure),
 	ext_filename(_ext_filename), exi_filename(_exi_filename)
 {
+	// the external run manager reads the run storage file directly and only understands the legacy layout
+	file_stor.set_legacy_format(true);
 	cout << "              starting external run manager ..." << endl << endl;
 }
 
@@ -24,6 +26,8 @@ void RunManagerExternal::run()
 	//exit so the external run manager can be involked
 	if (!waiting_run_ids.empty())
 	{
+		//make sure the run storage file is complete before the external run manager reads it
+		file_stor.flush();
 		ofstream fout_ext(ext_filename);
 		fout_ext << get_run_filename() << endl;
 		fout_ext << max_n_failure << endl;
@@ -54,6 +58,14 @@ void RunManagerExternal::run()
 
 }
 
+void RunManagerExternal::set_storage_format(bool obs_float32, int tile_nruns)
+{
+	if (obs_float32 || tile_nruns > 0)
+	{
+		cout << "  storage_obs_float32 and storage_tile_nruns are ignored by the external run manager" << endl;
+	}
+}
+
 RunManagerExternal::~RunManagerExternal()
 {
 }
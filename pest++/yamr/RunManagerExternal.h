@@ -34,6 +34,8 @@ public:
 		const std::string &stor_filename, const std::string &_ext_filename, const std::string &_exi_filename, int _max_n_failure = 1);
 	virtual ~RunManagerExternal();
 	virtual void run();
+	// the storage file is always written in the legacy format
+	virtual void set_storage_format(bool obs_float32, int tile_nruns);
 private:
 	std::string ext_filename;
 	std::string exi_filename;
@@ -26,81 +26,20 @@
 #include <cstring>
 #include <map>
 #include <algorithm>
+#include <future>
+#include <chrono>
 #include "system_variables.h"
 #include "Transformable.h"
 #include "utilities.h"
 #include "iopp.h"
 
 #include "network_wrapper.h"
+#include "model_launcher.h"
 
 using namespace std;
 using namespace pest_utils;
 
 
-extern "C"
-{
-
-	void wrttpl_(int *,
-		char *,
-		char *,
-		int *,
-		char *,
-		double *,
-		int *);
-
-	void readins_(int *,
-		char *,
-		char *,
-		int *,
-		char *,
-		double *,
-		int *);
-}
-
-string RunManagerSerial::tpl_err_msg(int i)
-{
-	string err_msg;
-	switch (i)
-	{
-	case 0:
-		err_msg = "Routine completed successfully";
-		break;
-	case 1:
-		err_msg = "TPL file does not exist";
-		break;
-	case 2:
-		err_msg = "Not all parameters listed in TPL file";
-		break;
-	case 3:
-		err_msg = "Illegal header specified in TPL file";
-		break;
-	case 4:
-		err_msg = "Error getting parameter name from template";
-		break;
-	case 5:
-		err_msg = "Error getting parameter name from template";
-		break;
-	case 10:
-		err_msg = "Error writing to model input file";
-	}
-	return err_msg;
-}
-
-
-string RunManagerSerial::ins_err_msg(int i)
-{
-	string err_msg;
-	switch (i)
-	{
-	case 0:
-		err_msg = "Routine completed successfully";
-		break;
-	default:
-		err_msg = "";
-	}
-	return err_msg;
-}
-
 RunManagerSerial::RunManagerSerial(const vector<string> _comline_vec,
 	const vector<string> _tplfile_vec, const vector<string> _inpfile_vec,
 	const vector<string> _insfile_vec, const vector<string> _outfile_vec,
@@ -114,19 +53,11 @@ RunManagerSerial::RunManagerSerial(const vector<string> _comline_vec,
 
 void RunManagerSerial::run()
 {
-	int ifail;
 	int success_runs = 0;
 	int prev_sucess_runs = 0;
 	const vector<string> &par_name_vec = file_stor.get_par_name_vec();
 	const vector<string> &obs_name_vec = file_stor.get_obs_name_vec();
-	int npar = par_name_vec.size();
-	int nobs = obs_name_vec.size();
-	int ntpl = tplfile_vec.size();
-	int nins = insfile_vec.size();
 	stringstream message;		
-	bool isDouble = true;
-	bool forceRadix = true;
-	//TemplateFiles tpl_files(isDouble, forceRadix, tplfile_vec, inpfile_vec, par_name_vec);
 	//InstructionFiles ins_files(insfile_vec, outfile_vec);
 	std::vector<double> obs_vec;
 	// This is necessary to support restart as some run many already be complete
@@ -165,27 +96,38 @@ void RunManagerSerial::run()
 				{
 					throw PestError("Error running model: invalid parameter value returned");
 				}
-				wrttpl_(&ntpl, StringvecFortranCharArray(tplfile_vec, 50).get_prt(),
-					StringvecFortranCharArray(inpfile_vec, 50).get_prt(),
-					&npar, StringvecFortranCharArray(par_name_vec, 50, pest_utils::TO_LOWER).get_prt(),
-					&par_values[0], &ifail);
-				if (ifail != 0)
+				if (!tpl_writer)
 				{
-					throw PestError("Error processing template file");
-				}								
-				for (int i = 0, n_exec = comline_vec.size(); i < n_exec; ++i)
+					// the template files are read for the first run and reused for the following runs
+					tpl_writer.reset(new TemplateWriter(tplfile_vec, par_name_vec));
+				}
+				tpl_writer->write(par_values, inpfile_vec);								
+				RunUsage usage;
+				// the model is run in a separate thread so the completed runs held by the storage in group commit
+				// mode can be committed once they are due while the model runs
+				future<ModelLauncher::Status> model_run = async(launch::async, [&]() {
+					return ModelLauncher::run(comline_vec, "", nullptr, max_run_secs, usage); });
+				while (model_run.wait_for(chrono::milliseconds(OperSys::thread_sleep_milli_secs)) != future_status::ready)
 				{
-					system(comline_vec[i].c_str());
+					file_stor.commit_if_due();
 				}
-				obs_vec.resize(nobs, RunStorage::no_data);
-				readins_(&nins, StringvecFortranCharArray(insfile_vec, 50).get_prt(),
-					StringvecFortranCharArray(outfile_vec, 50).get_prt(),
-					&nobs, StringvecFortranCharArray(obs_name_vec, 50, pest_utils::TO_LOWER).get_prt(),
-					&obs_vec[0], &ifail);
-				if (ifail != 0)
+				ModelLauncher::Status status = model_run.get();
+				if (status == ModelLauncher::Status::START_FAILED)
 				{
-					throw PestError("Error processing instruction file");
-				}				
+					throw PestError("Error running model: could not start model command");
+				}
+				if (status == ModelLauncher::Status::TIMED_OUT)
+				{
+					stringstream ss;
+					ss << "Error running model: run killed after " << max_run_secs << " sec";
+					throw PestError(ss.str());
+				}
+				if (!ins_reader)
+				{
+					// the instruction files are read for the first run and reused for the following runs
+					ins_reader.reset(new InstructionReader(insfile_vec, obs_name_vec));
+				}
+				ins_reader->read(outfile_vec, obs_vec);
 				// check parameters and observations for inf and nan
 				if (std::any_of(par_values.begin(), par_values.end(), OperSys::double_is_invalid))
 				{
@@ -202,9 +144,6 @@ void RunManagerSerial::run()
 				{
 				system(comline_vec[i].c_str());
 				}
-				//pest_utils::thread_flag* tf1(false);
-				//pest_utils::thread_flag* tf2(false);
-				//w_run_commands(tf1,tf2,comline_vec);
 				ins_files.read(obs_name_vec, obs);
 				*/
 
@@ -231,8 +170,10 @@ void RunManagerSerial::run()
 				cerr << "  Error running model" << endl;
 				cerr << "  Aborting model run" << endl << endl;
 			}
+			file_stor.commit_if_due();
 		}
 	}
+	file_stor.commit();
 
 	total_runs += success_runs;
 	std::cout << string(message.str().size(), '\b');
@@ -20,7 +20,10 @@
 #define RUNMANAGERSERIAL_H
 
 #include "RunManagerAbstract.h"
+#include "template_writer.h"
+#include "instruction_reader.h"
 #include <string>
+#include <memory>
 
 class RunManagerSerial : public RunManagerAbstract
 {
@@ -33,8 +36,8 @@ public:
 	~RunManagerSerial(void);
 private:
 	std::string run_dir;
-	static std::string tpl_err_msg(int i);
-	static std::string ins_err_msg(int i);
+	std::unique_ptr<TemplateWriter> tpl_writer;
+	std::unique_ptr<InstructionReader> ins_reader;
 };
 
 #endif /* RUNMANAGERSERIAL_H */
\ No newline at end of file
@@ -0,0 +1,276 @@
+/*  
+	 Copyright 2012, David Welter
+	
+	This file is part of PEST++.
+   
+	PEST++ is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PEST++ is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+#include "RunManagerThreaded.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <set>
+#include "system_variables.h"
+#include "Transformable.h"
+#include "utilities.h"
+#include "model_launcher.h"
+
+using namespace std;
+using namespace pest_utils;
+
+
+const string RunManagerThreaded::worker_dir_prefix = "pestpp_worker_";
+// extensions of the files PEST++ writes for a case.  The model does not need them so they are not copied to the
+// worker directories
+const vector<string> RunManagerThreaded::pestpp_file_exts = { "rns", "rnj", "rnu", "rnr", "jco", "jcb", "jcs",
+	"rei", "rec", "rst", "rmr", "par", "parb", "bpa", "iobj", "ipar", "isen", "sen", "svd", "pfm", "fpr", "mio",
+	"msn", "mos", "raw", "rtj", "dbg", "ext", "exi" };
+
+RunManagerThreaded::RunManagerThreaded(const vector<string> _comline_vec,
+	const vector<string> _tplfile_vec, const vector<string> _inpfile_vec,
+	const vector<string> _insfile_vec, const vector<string> _outfile_vec,
+	const string &stor_filename, const string &_run_dir, int _n_workers, int _max_run_fail)
+	: RunManagerAbstract(_comline_vec, _tplfile_vec, _inpfile_vec,
+	_insfile_vec, _outfile_vec, stor_filename, _max_run_fail),
+	run_dir(_run_dir)
+{
+	cout << "              starting threaded run manager ..." << endl << endl;
+	init_workers(max(_n_workers, 1));
+}
+
+void RunManagerThreaded::init_workers(int n_workers)
+{
+	vector<string> file_vec(inpfile_vec);
+	file_vec.insert(file_vec.end(), outfile_vec.begin(), outfile_vec.end());
+	for (auto &file : file_vec)
+	{
+		if (OperSys::is_absolute_path(file))
+		{
+			throw PestError("model input and output files must be relative to the model directory when using several workers: " + file);
+		}
+	}
+	// the run storage and output files of the case are not copied.  Run storage files may have a journal
+	string case_name = pest_utils::remove_file_ext(pest_utils::get_filename(file_stor.get_filename()));
+	set<string> skip_names;
+	for (const auto &ext : pestpp_file_exts)
+	{
+		skip_names.insert(case_name + "." + ext);
+		skip_names.insert(case_name + "." + ext + ".jnl");
+	}
+	// each worker gets its own copy of the model directory.  This is done once and the copies are reused for every run
+	for (int i = 1; i <= n_workers; ++i)
+	{
+		stringstream ss;
+		if (run_dir != ".") ss << run_dir << OperSys::DIR_SEP;
+		ss << worker_dir_prefix << i;
+		string work_dir = ss.str();
+		cout << "copying model directory to worker directory " << work_dir << "...";
+		OperSys::copy_dir(run_dir, work_dir, worker_dir_prefix, skip_names);
+		cout << "done" << endl;
+		worker_dirs.push_back(work_dir);
+	}
+	cout << endl;
+}
+
+void RunManagerThreaded::run()
+{
+	int success_runs = 0;
+	stringstream message;
+	const vector<string> &par_name_vec = file_stor.get_par_name_vec();
+	vector<int> run_id_vec;
+	int nruns = get_outstanding_run_ids().size();
+	// runs that fail are repeated until they reach the maximum number of failures
+	while (!(run_id_vec = get_outstanding_run_ids()).empty())
+	{
+		// the parameters are read here as only this thread uses the run storage
+		for (int run_id : run_id_vec)
+		{
+			Parameters pars;
+			file_stor.get_parameters(run_id, pars);
+			WorkerRun run(run_id);
+			for (auto &name : par_name_vec)
+			{
+				run.par_values.push_back(pars.get_rec(name));
+			}
+			waiting_runs.push_back(move(run));
+		}
+		vector<thread> workers;
+		int n_workers = min(worker_dirs.size(), run_id_vec.size());
+		for (int i = 0; i < n_workers; ++i)
+		{
+			workers.push_back(thread(&RunManagerThreaded::run_worker, this, i));
+		}
+		for (size_t i_run = 0; i_run < run_id_vec.size(); ++i_run)
+		{
+			WorkerRun run;
+			{
+				unique_lock<mutex> lock(queue_mutex);
+				// commit the completed runs held by the storage in group commit mode once they are due while
+				// the models run
+				while (!finished_cv.wait_for(lock, chrono::milliseconds(OperSys::thread_sleep_milli_secs),
+					[this]() { return !finished_runs.empty(); }))
+				{
+					lock.unlock();
+					file_stor.commit_if_due();
+					lock.lock();
+				}
+				run = move(finished_runs.front());
+				finished_runs.pop_front();
+			}
+			if (run.success)
+			{
+				vector<char> serial_data(sizeof(double) * (run.par_values.size() + run.obs_values.size()));
+				memcpy(serial_data.data(), run.par_values.data(), sizeof(double) * run.par_values.size());
+				memcpy(serial_data.data() + sizeof(double) * run.par_values.size(), run.obs_values.data(),
+					sizeof(double) * run.obs_values.size());
+				file_stor.update_run(run.run_id, serial_data);
+				++success_runs;
+			}
+			else
+			{
+				file_stor.update_run_failed(run.run_id);
+			}
+			std::cout << string(message.str().size(), '\b');
+			message.str("");
+			message << "(" << success_runs << "/" << nruns << " runs complete)";
+			std::cout << message.str();
+			file_stor.commit_if_due();
+		}
+		for (auto &worker : workers)
+		{
+			worker.join();
+		}
+	}
+	file_stor.commit();
+
+	total_runs += success_runs;
+	std::cout << string(message.str().size(), '\b');
+	message.str("");
+	message << "(" << success_runs << "/" << nruns << " runs complete)";
+	std::cout << message.str();
+	if (success_runs < nruns)
+	{
+		cout << endl << endl;
+		cout << "WARNING: " << nruns - success_runs << " out of " << nruns << " runs failed" << endl << endl;
+	}
+	std::cout << endl << endl;
+}
+
+void RunManagerThreaded::run_worker(int i_worker)
+{
+	const string &work_dir = worker_dirs[i_worker];
+	while (true)
+	{
+		WorkerRun run;
+		{
+			lock_guard<mutex> lock(queue_mutex);
+			if (waiting_runs.empty()) return;
+			run = move(waiting_runs.front());
+			waiting_runs.pop_front();
+		}
+		try
+		{
+			run_model(work_dir, run);
+			run.success = true;
+		}
+		catch (const std::exception& ex)
+		{
+			cerr << endl;
+			cerr << "  " << ex.what() << endl;
+			cerr << "  Aborting model run in " << work_dir << endl << endl;
+			run.success = false;
+		}
+		catch (...)
+		{
+			cerr << endl;
+			cerr << "  Error running model" << endl;
+			cerr << "  Aborting model run in " << work_dir << endl << endl;
+			run.success = false;
+		}
+		{
+			lock_guard<mutex> lock(queue_mutex);
+			finished_runs.push_back(move(run));
+		}
+		finished_cv.notify_one();
+	}
+}
+
+void RunManagerThreaded::run_model(const string &work_dir, WorkerRun &run)
+{
+	const vector<string> &par_name_vec = file_stor.get_par_name_vec();
+	const vector<string> &obs_name_vec = file_stor.get_obs_name_vec();
+	string dir_prefix = (run_dir == ".") ? string() : run_dir + OperSys::DIR_SEP;
+	vector<string> worker_tplfile_vec;
+	vector<string> worker_inpfile_vec;
+	vector<string> worker_insfile_vec;
+	vector<string> worker_outfile_vec;
+	for (auto &file : tplfile_vec) worker_tplfile_vec.push_back(dir_prefix + file);
+	for (auto &file : inpfile_vec) worker_inpfile_vec.push_back(work_dir + OperSys::DIR_SEP + file);
+	for (auto &file : insfile_vec) worker_insfile_vec.push_back(dir_prefix + file);
+	for (auto &file : outfile_vec) worker_outfile_vec.push_back(work_dir + OperSys::DIR_SEP + file);
+	//first delete any existing input and output files
+	for (auto &out_file : worker_outfile_vec)
+	{
+		if ((check_exist_out(out_file)) && (remove(out_file.c_str()) != 0))
+			throw PestError("model interface error: Cannot delete existing model output file " + out_file);
+	}
+	for (auto &in_file : worker_inpfile_vec)
+	{
+		if ((check_exist_out(in_file)) && (remove(in_file.c_str()) != 0))
+			throw PestError("model interface error: Cannot delete existing model input file " + in_file);
+	}
+	if (std::any_of(run.par_values.begin(), run.par_values.end(), OperSys::double_is_invalid))
+	{
+		throw PestError("Error running model: invalid parameter value returned");
+	}
+	{
+		lock_guard<mutex> io_lock(io_mutex);
+		if (!tpl_writer) tpl_writer.reset(new TemplateWriter(worker_tplfile_vec, par_name_vec));
+		if (!ins_reader) ins_reader.reset(new InstructionReader(worker_insfile_vec, obs_name_vec));
+	}
+	tpl_writer->write(run.par_values, worker_inpfile_vec);
+	// the commands are run as child processes in the worker directory
+	RunUsage usage;
+	ModelLauncher::Status status = ModelLauncher::run(comline_vec, work_dir, nullptr, max_run_secs, usage);
+	if (status == ModelLauncher::Status::START_FAILED)
+	{
+		throw PestError("Error running model: could not start model command");
+	}
+	if (status == ModelLauncher::Status::TIMED_OUT)
+	{
+		stringstream ss;
+		ss << "Error running model: run killed after " << max_run_secs << " sec";
+		throw PestError(ss.str());
+	}
+	// the workers read their output files at the same time as read() does not modify the reader
+	ins_reader->read(worker_outfile_vec, run.obs_values);
+	// check parameters and observations for inf and nan
+	if (std::any_of(run.par_values.begin(), run.par_values.end(), OperSys::double_is_invalid))
+	{
+		throw PestError("Error running model: invalid parameter value returned");
+	}
+	if (std::any_of(run.obs_values.begin(), run.obs_values.end(), OperSys::double_is_invalid))
+	{
+		throw PestError("Error running model: invalid observation value returned");
+	}
+}
+
+RunManagerThreaded::~RunManagerThreaded(void)
+{
+}
@@ -0,0 +1,72 @@
+/*  
+	 Copyright 2012, David Welter
+	
+	This file is part of PEST++.
+   
+	PEST++ is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PEST++ is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+#ifndef RUNMANAGERTHREADED_H
+#define RUNMANAGERTHREADED_H
+
+#include "RunManagerAbstract.h"
+#include "template_writer.h"
+#include "instruction_reader.h"
+#include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// RunManagerThreaded makes several model runs at the same time on the local computer.  The model directory
+// is copied once into a directory for each worker and the workers run the model commands in their own
+// directory as child processes, so the working directory of PEST++ is never changed.  Only the thread
+// calling run() reads from and writes to the run storage file.  Failed runs are repeated up to
+// max_n_failure times as with the serial run manager
+class RunManagerThreaded : public RunManagerAbstract
+{
+public:
+	RunManagerThreaded(const std::vector<std::string> _comline_vec,
+		const std::vector<std::string> _tplfile_vec, const std::vector<std::string> _inpfile_vec,
+		const std::vector<std::string> _insfile_vec, const std::vector<std::string> _outfile_vec,
+		const std::string &stor_filename, const std::string &run_dir, int _n_workers, int _max_run_fail=1);
+	virtual void run();
+	~RunManagerThreaded(void);
+private:
+	class WorkerRun
+	{
+	public:
+		WorkerRun(int _run_id=-1) : run_id(_run_id), success(false) {}
+		int run_id;
+		bool success;
+		std::vector<double> par_values; // ordered as get_par_name_vec()
+		std::vector<double> obs_values; // ordered as get_obs_name_vec()
+	};
+	static const std::string worker_dir_prefix;
+	static const std::vector<std::string> pestpp_file_exts;
+	std::string run_dir;
+	std::vector<std::string> worker_dirs;
+	std::deque<WorkerRun> waiting_runs;
+	std::deque<WorkerRun> finished_runs;
+	std::mutex queue_mutex;
+	std::condition_variable finished_cv;
+	std::mutex io_mutex; // held while the template writer and instruction reader are created
+	std::unique_ptr<TemplateWriter> tpl_writer; // created by the first run and shared by the workers
+	std::unique_ptr<InstructionReader> ins_reader; // created by the first run and shared by the workers
+	void init_workers(int n_workers);
+	void run_worker(int i_worker);
+	void run_model(const std::string &work_dir, WorkerRun &run);
+};
+
+#endif /* RUNMANAGERTHREADED_H */
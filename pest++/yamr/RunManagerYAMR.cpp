@@ -33,8 +33,10 @@
 #include <deque>
 #include <utility>
 #include <algorithm>
+#include <cmath>
 #include "network_wrapper.h"
 #include "network_package.h"
+#include "model_launcher.h"
 #include "Transformable.h"
 #include "utilities.h"
 #include "Serialization.h"
@@ -47,38 +49,134 @@ YamrModelRun::YamrModelRun(int _run_id, int _sockfd) : sockfd(_sockfd), run_id(_
 {
 }
 
+void YamrRunTable::insert(const YamrModelRun &run)
+{
+	int sock_id = run.get_socket();
+	erase(sock_id, run.get_id());
+	sock_map[sock_id].push_back(run);
+	run_map[run.get_id()].push_back(sock_id);
+	++n_runs;
+}
+
+const YamrModelRun* YamrRunTable::find(int sock_id, int run_id) const
+{
+	auto it = sock_map.find(sock_id);
+	if (it == sock_map.end()) return nullptr;
+	for (const auto &run : it->second)
+	{
+		if (run.get_id() == run_id) return &run;
+	}
+	return nullptr;
+}
+
+bool YamrRunTable::erase(int sock_id, int run_id)
+{
+	auto it = sock_map.find(sock_id);
+	if (it == sock_map.end()) return false;
+	vector<YamrModelRun> &run_vec = it->second;
+	auto it_sock_run = find_if(run_vec.begin(), run_vec.end(), [run_id](const YamrModelRun &r) { return r.get_id() == run_id; });
+	if (it_sock_run == run_vec.end()) return false;
+	run_vec.erase(it_sock_run);
+	if (run_vec.empty()) sock_map.erase(it);
+	auto it_run = run_map.find(run_id);
+	assert(it_run != run_map.end());
+	vector<int> &sock_vec = it_run->second;
+	sock_vec.erase(std::find(sock_vec.begin(), sock_vec.end(), sock_id));
+	if (sock_vec.empty()) run_map.erase(it_run);
+	--n_runs;
+	return true;
+}
+
+size_t YamrRunTable::erase_socket(int sock_id)
+{
+	vector<YamrModelRun> run_vec = get_runs(sock_id);
+	for (const auto &run : run_vec)
+	{
+		erase(sock_id, run.get_id());
+	}
+	return run_vec.size();
+}
+
+vector<YamrModelRun> YamrRunTable::get_runs(int sock_id) const
+{
+	auto it = sock_map.find(sock_id);
+	if (it == sock_map.end()) return vector<YamrModelRun>();
+	return it->second;
+}
+
+vector<YamrModelRun> YamrRunTable::get_runs() const
+{
+	vector<YamrModelRun> run_vec;
+	for (const auto &i_sock : sock_map)
+	{
+		run_vec.insert(run_vec.end(), i_sock.second.begin(), i_sock.second.end());
+	}
+	return run_vec;
+}
+
+vector<int> YamrRunTable::get_sockets(int run_id) const
+{
+	auto it_run = run_map.find(run_id);
+	if (it_run == run_map.end()) return vector<int>();
+	return it_run->second;
+}
+
+size_t YamrRunTable::count(int run_id) const
+{
+	auto it_run = run_map.find(run_id);
+	if (it_run == run_map.end()) return 0;
+	return it_run->second.size();
+}
+
+void YamrRunTable::clear()
+{
+	sock_map.clear();
+	run_map.clear();
+	n_runs = 0;
+}
+
 SlaveInfo::SlaveRec::SlaveRec()
 {
 	state = SlaveInfo::State::NEW;
 	work_dir = "";
 	linpack_time = std::chrono::hours(-500);
 	run_time = std::chrono::hours(-500);
+	run_time_var = 0;
 	start_time = std::chrono::system_clock::now();
 	last_ping_time = std::chrono::system_clock::now();
+	last_recv_time = last_ping_time;
 	ping = false;
 	failed_pings = 0;
+	conn_id = 0;
+	n_slots = 1;
+	delta_pars = false;
+	base_pars_group = -1;
+	sparse_obs = false;
+	base_obs_group = -1;
 }
 
 bool SlaveInfo::CompareTimes::operator() (int a, int b)
 {
-	bool ret = false;
+	// fastest slaves first.  Slaves that have not completed a run yet follow in order of their linpack time
 	auto &info_map = my_class_ptr->slave_info_map;
 	auto ita = info_map.find(a);
 	assert(ita != info_map.end());
 	auto itb = info_map.find(b);
 	assert(itb != info_map.end());
-	if (itb->second.run_time > std::chrono::milliseconds(0) && ita->second.run_time > std::chrono::milliseconds(0))
+	bool a_has_run = ita->second.run_time > std::chrono::milliseconds(0);
+	bool b_has_run = itb->second.run_time > std::chrono::milliseconds(0);
+	if (a_has_run != b_has_run)
 	{
-		ret = ! (itb->second.run_time > ita->second.run_time);
+		return a_has_run;
 	}
-	else if (itb->second.linpack_time > std::chrono::milliseconds(0) && ita->second.linpack_time > std::chrono::milliseconds(0))
+	if (a_has_run)
 	{
-		ret = ! (itb->second.linpack_time > ita->second.linpack_time);
+		return ita->second.run_time < itb->second.run_time;
 	}
-	return ret;
+	return ita->second.linpack_time < itb->second.linpack_time;
 }
 
-SlaveInfo::SlaveInfo()
+SlaveInfo::SlaveInfo() : last_conn_id(0)
 {
 }
 
@@ -88,7 +186,10 @@ SlaveInfo::~SlaveInfo()
 
 void SlaveInfo::add(int sock_id)
 {
-	slave_info_map[sock_id] = SlaveInfo::SlaveRec();
+	SlaveRec &rec = slave_info_map[sock_id];
+	rec = SlaveInfo::SlaveRec();
+	rec.conn_id = ++last_conn_id;
+	rec.sock_name = w_getnameinfo_vec(sock_id);
 }
 
 void SlaveInfo::erase(int sock_id)
@@ -96,6 +197,97 @@ void SlaveInfo::erase(int sock_id)
 	slave_info_map.erase(sock_id);
 }
 
+int SlaveInfo::get_conn_id(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	if (it == slave_info_map.end()) return -1;
+	return it->second.conn_id;
+}
+
+const vector<string> &SlaveInfo::get_sock_name(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return it->second.sock_name;
+}
+
+std::chrono::system_clock::time_point SlaveInfo::get_start_time(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return it->second.start_time;
+}
+
+void SlaveInfo::set_slots(int sock_id, int n_slots)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	it->second.n_slots = max(n_slots, 1);
+}
+
+int SlaveInfo::get_slots(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return it->second.n_slots;
+}
+
+void SlaveInfo::set_delta_pars(int sock_id, bool delta_pars)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	it->second.delta_pars = delta_pars;
+}
+
+bool SlaveInfo::get_delta_pars(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return it->second.delta_pars;
+}
+
+void SlaveInfo::set_base_pars_group(int sock_id, int group_id)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	it->second.base_pars_group = group_id;
+}
+
+int SlaveInfo::get_base_pars_group(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return it->second.base_pars_group;
+}
+
+void SlaveInfo::set_sparse_obs(int sock_id, bool sparse_obs)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	it->second.sparse_obs = sparse_obs;
+}
+
+bool SlaveInfo::get_sparse_obs(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return it->second.sparse_obs;
+}
+
+void SlaveInfo::set_base_obs_group(int sock_id, int group_id)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	it->second.base_obs_group = group_id;
+}
+
+int SlaveInfo::get_base_obs_group(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return it->second.base_obs_group;
+}
+
 size_t SlaveInfo::size() const
 {
 	return slave_info_map.size();
@@ -137,20 +329,24 @@ void SlaveInfo::start_timer(int sock_id)
 	it->second.start_time = std::chrono::system_clock::now();
 }
 
-void SlaveInfo::end_run(int sock_id)
+void SlaveInfo::end_run(int sock_id, std::chrono::system_clock::time_point run_start_time)
 {
 	auto it = slave_info_map.find(sock_id);
 	assert(it != slave_info_map.end());
 	auto &run_time = it->second.run_time;
-	auto dt = std::chrono::system_clock::now() - it->second.start_time;
+	auto dt = std::chrono::system_clock::now() - run_start_time;
 	if (run_time > std::chrono::hours(0))
 	{
-		run_time = run_time + dt;
-		run_time /= 2;
+		double mean_sec = std::chrono::duration_cast<std::chrono::microseconds>(run_time).count() / 1.0e6;
+		double diff = std::chrono::duration_cast<std::chrono::microseconds>(dt).count() / 1.0e6 - mean_sec;
+		mean_sec += RUNTIME_WEIGHT * diff;
+		it->second.run_time_var = (1.0 - RUNTIME_WEIGHT) * (it->second.run_time_var + RUNTIME_WEIGHT * diff * diff);
+		run_time = std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds((long long)(mean_sec * 1.0e6)));
 	}
 	else
 	{
 		run_time = dt;
+		it->second.run_time_var = 0;
 	}
 }
 
@@ -162,6 +358,13 @@ void SlaveInfo::end_linpack(int sock_id)
 	linpack_time = std::chrono::system_clock::now() - it->second.start_time;
 }
 
+void SlaveInfo::end_linpack(int sock_id, double linpack_secs)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	it->second.linpack_time = chrono::duration_cast<chrono::system_clock::duration>(chrono::duration<double>(linpack_secs));
+}
+
 double SlaveInfo::get_duration_sec(int sock_id)
 {
 	auto it = slave_info_map.find(sock_id);
@@ -175,7 +378,7 @@ double SlaveInfo::get_duration_minute(int sock_id)
 	return this->get_duration_sec(sock_id) / 60.0;
 }
 
-double SlaveInfo::get_runtime_sec(int sock_id)
+double SlaveInfo::get_runtime_sec(int sock_id) const
 {
 	auto it = slave_info_map.find(sock_id);
 	assert(it != slave_info_map.end());
@@ -183,6 +386,13 @@ double SlaveInfo::get_runtime_sec(int sock_id)
 	return(double)std::chrono::duration_cast<std::chrono::milliseconds>(run_time).count() / 1000.0;
 }
 
+double SlaveInfo::get_runtime_sd_sec(int sock_id) const
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return sqrt(it->second.run_time_var);
+}
+
 double SlaveInfo::get_runtime_minute(int sock_id)
 {
 	auto it = slave_info_map.find(sock_id);
@@ -279,14 +489,31 @@ int SlaveInfo::seconds_since_last_ping_time(int sock_id)
 		(chrono::system_clock::now() - it->second.last_ping_time).count();
 }
 
+void SlaveInfo::reset_last_recv_time(int sock_id)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	it->second.last_recv_time = chrono::system_clock::now();
+}
+
+int SlaveInfo::seconds_since_last_recv_time(int sock_id)
+{
+	auto it = slave_info_map.find(sock_id);
+	assert(it != slave_info_map.end());
+	return chrono::duration_cast<std::chrono::seconds>
+		(chrono::system_clock::now() - it->second.last_recv_time).count();
+}
+
 
 RunManagerYAMR::RunManagerYAMR(const vector<string> _comline_vec,
 	const vector<string> _tplfile_vec, const vector<string> _inpfile_vec,
 	const vector<string> _insfile_vec, const vector<string> _outfile_vec,
-	const string &stor_filename, const string &_port, ofstream &_f_rmr, int _max_n_failure)
+	const string &stor_filename, const string &_port, ofstream &_f_rmr, int _max_n_failure, double _batch_secs,
+	bool _recalibrate, bool _compress, double _obs_tol)
 	: RunManagerAbstract(_comline_vec, _tplfile_vec, _inpfile_vec,
 	_insfile_vec, _outfile_vec, stor_filename, _max_n_failure),
-	port(_port), f_rmr(_f_rmr)
+	port(_port), broker_fd(-1), f_rmr(_f_rmr), batch_secs(_batch_secs),
+	recalibrate(_recalibrate), compress(_compress), base_pars_group(-1), base_obs_group(-1), obs_tol(_obs_tol)
 {
 	w_init();
 	int status;
@@ -320,43 +547,69 @@ RunManagerYAMR::RunManagerYAMR(const vector<string> _comline_vec,
 	w_listen(listener, BACKLOG);
 	//free servinfo
 	freeaddrinfo(servinfo);
-	fdmax = listener;
-	FD_ZERO(&master);
-	FD_SET(listener, &master);	
+	poller.add(listener);
 	return;
 }
 
-unordered_multimap<int, YamrModelRun>::iterator RunManagerYAMR::get_active_run_id(int socket)
+void RunManagerYAMR::report_throughput(const NetPackage::ByteCounts &start_counts, chrono::system_clock::time_point start_time)
 {
-	auto i = active_runs.begin();
-	auto end = active_runs.end();
-
-	for(; i!=end && i->second.get_socket() != socket; ++i)
-	{}
-	return i;
+	NetPackage::ByteCounts counts = NetPackage::get_byte_counts();
+	double secs = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - start_time).count() / 1000.0;
+	secs = max(secs, 0.001);
+	const double mb = 1024.0 * 1024.0;
+	double data_recv = (counts.data_recv - start_counts.data_recv) / mb;
+	double wire_recv = (counts.wire_recv - start_counts.wire_recv) / mb;
+	double data_sent = (counts.data_sent - start_counts.data_sent) / mb;
+	double wire_sent = (counts.wire_sent - start_counts.wire_sent) / mb;
+	stringstream ss;
+	ss << setprecision(4) << "network received: " << data_recv << " MB of data in " << wire_recv << " MB ("
+		<< wire_recv / secs << " MB/sec, compression ratio " << data_recv / max(wire_recv, 1.0e-9) << "); sent: "
+		<< data_sent << " MB of data in " << wire_sent << " MB (" << wire_sent / secs << " MB/sec, compression ratio "
+		<< data_sent / max(wire_sent, 1.0e-9) << ")";
+	report(ss.str(), false);
 }
 
-unordered_multimap<int, YamrModelRun>::iterator RunManagerYAMR::get_zombie_run_id(int socket)
+void RunManagerYAMR::connect_broker(const string &host, const string &broker_port)
 {
-	auto i = zombie_runs.begin();
-	auto end = zombie_runs.end();
-
-	for (; i != end && i->second.get_socket() != socket; ++i)
+	struct addrinfo hints;
+	struct addrinfo *servinfo;
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (w_getaddrinfo(host.c_str(), broker_port.c_str(), &hints, &servinfo) != 0)
 	{
+		throw PestError("Error: unable to resolve YAMR broker address " + host + ":" + broker_port);
 	}
-	return i;
+	addrinfo *connect_addr = w_connect_first_avl(servinfo, broker_fd);
+	freeaddrinfo(servinfo);
+	if (connect_addr == nullptr)
+	{
+		broker_fd = -1;
+		throw PestError("Error: unable to connect to YAMR broker " + host + ":" + broker_port);
+	}
+	NetPackage::reset_connection(broker_fd);
+	// the broker connects its slaves to the port this master is listening on.  The connection is kept open
+	// until the master is done so the broker knows when to stop sending slaves
+	NetPackage net_pack(NetPackage::PackType::REQ_SLAVES, 0, 0, "");
+	if (net_pack.send(broker_fd, port.c_str(), port.size()) == -1)
+	{
+		throw PestError("Error: unable to register with YAMR broker " + host + ":" + broker_port);
+	}
+	cout << "registered with YAMR broker: " << host << ":" << broker_port << endl;
+	report("registered with YAMR broker: " + host + ":" + broker_port, false);
 }
 
-
 void RunManagerYAMR::initialize(const Parameters &model_pars, const Observations &obs, const string &_filename)
 {
 	RunManagerAbstract::initialize(model_pars, obs, _filename);
+	run_type_map.clear();
 	cur_group_id = NetPackage::get_new_group_id();
 }
 
 void RunManagerYAMR::initialize_restart(const std::string &_filename)
 {
 	file_stor.init_restart(_filename);
+	run_type_map.clear();
 	waiting_runs.clear();
 	completed_runs.clear();
 	zombie_runs.clear();
@@ -376,6 +629,7 @@ void RunManagerYAMR::reinitialize(const std::string &_filename)
 	zombie_runs.clear();
 	failure_map.clear();
 	concurrent_map.clear();
+	run_type_map.clear();
 	RunManagerAbstract::reinitialize(_filename);
 	cur_group_id = NetPackage::get_new_group_id();
 }
@@ -386,11 +640,13 @@ void  RunManagerYAMR::free_memory()
 	completed_runs.clear();
 	zombie_runs.clear();
 	failure_map.clear();
+	run_type_map.clear();
 }
 
 int RunManagerYAMR::add_run(const Parameters &model_pars, const string &info_txt, double info_value)
 {
 	int run_id = file_stor.add_run(model_pars, info_txt, info_value);
+	run_type_map[run_id] = info_txt;
 	YamrModelRun new_run(run_id);
 	waiting_runs.push_back(new_run);
 	return run_id;
@@ -399,6 +655,7 @@ int RunManagerYAMR::add_run(const Parameters &model_pars, const string &info_txt
 int RunManagerYAMR::add_run(const std::vector<double> &model_pars, const string &info_txt, double info_value)
 {
 	int run_id = file_stor.add_run(model_pars, info_txt, info_value);
+	run_type_map[run_id] = info_txt;
 	YamrModelRun new_run(run_id);
 	waiting_runs.push_back(new_run);
 	return run_id;
@@ -407,17 +664,31 @@ int RunManagerYAMR::add_run(const std::vector<double> &model_pars, const string
 int RunManagerYAMR::add_run(const Eigen::VectorXd &model_pars, const string &info_txt, double info_value)
 {
 	int run_id = file_stor.add_run(model_pars, info_txt, info_value);
+	run_type_map[run_id] = info_txt;
 	YamrModelRun new_run(run_id);
 	waiting_runs.push_back(new_run);
 	return run_id;
 }
 
+vector<int> RunManagerYAMR::add_runs(const Eigen::MatrixXd &model_pars, const vector<string> &info_txt_vec, const vector<double> &info_value_vec)
+{
+	vector<int> run_id_vec = file_stor.add_runs(model_pars, info_txt_vec, info_value_vec);
+	for (size_t i = 0; i < run_id_vec.size(); ++i)
+	{
+		waiting_runs.push_back(YamrModelRun(run_id_vec[i]));
+		run_type_map[run_id_vec[i]] = (i < info_txt_vec.size()) ? info_txt_vec[i] : string();
+	}
+	return run_id_vec;
+}
+
 void RunManagerYAMR::run()
 {
 	stringstream message;
 	NetPackage net_pack;
 	model_runs_done = 0;
 	model_runs_failed = 0;
+	NetPackage::ByteCounts start_counts = NetPackage::get_byte_counts();
+	chrono::system_clock::time_point start_time = chrono::system_clock::now();
 	cout << "    running model " << waiting_runs.size() << " times" << endl;
 	f_rmr << "running model " << waiting_runs.size() << " times" << endl;
 	if(slave_info.size() == 0) // first entry is the listener, slave apper after this
@@ -434,7 +705,10 @@ void RunManagerYAMR::run()
 		schedule_runs();
 		// get and process incomming messages
 		listen();		
+		// commit completed runs held by the storage in group commit mode once they are due
+		file_stor.commit_if_due();
 	}
+	file_stor.commit();
 	total_runs += model_runs_done;
 	echo();
 	//kill any remaining active runs
@@ -442,6 +716,7 @@ void RunManagerYAMR::run()
 	message  << "    " << completed_runs.size() << " runs complete";
 	cout << endl << "---------------------" << endl << message.str() << endl << endl;
 	f_rmr << endl << "---------------------" << endl << message.str() << endl << endl;
+	report_throughput(start_counts, start_time);
 	concurrent_map.clear();
 	//if (success_runs < i_run)
 	//{
@@ -454,62 +729,90 @@ void RunManagerYAMR::run()
 void RunManagerYAMR::listen()
 {
 	struct sockaddr_storage remote_addr;
-	fd_set read_fds; // temp file descriptor list for select()
 	socklen_t addr_len;
-	timeval tv;
-	tv.tv_sec = 1;
-	tv.tv_usec = 0;
-	read_fds = master; // copy it
-	if (w_select(fdmax+1, &read_fds, NULL, NULL, &tv) == -1) 
+	vector<int> ready_fds;
+	if (poller.wait(1000, ready_fds) == -1)
 	{
 		return;
 	}
-	// run through the existing connections looking for data to read
-	for(int i = 0; i <= fdmax; i++) {
-		if (FD_ISSET(i, &read_fds)) { // we got one!!
-			if (i == listener)  // handle new connections
+	// run through the connections with data to read
+	for (int i : ready_fds)
+	{
+		if (i == listener)  // handle new connections
+		{
+			int newfd;
+			addr_len = sizeof remote_addr;
+			newfd = w_accept(listener,(struct sockaddr *)&remote_addr, &addr_len);
+			if (newfd == -1) {}
+			else 
 			{
-				int newfd;
-				addr_len = sizeof remote_addr;
-				newfd = w_accept(listener,(struct sockaddr *)&remote_addr, &addr_len);
-				if (newfd == -1) {}
-				else 
+				NetPackage::reset_connection(newfd);
+				try
 				{
-					FD_SET(newfd, &master); // add to master set
-					if (newfd > fdmax) { // keep track of the max
-						fdmax = newfd;
-					}
-					vector<string> sock_name = w_getnameinfo_vec(newfd);
-					slave_info.add(newfd);
+					poller.add(newfd);
 				}
+				catch (PestError &e)
+				{
+					report(e.what(), true);
+					w_close(newfd);
+					continue;
+				}
+				slave_info.add(newfd);
 			}
-			else  // handle data from a client
-			{				
-				//set the ping flag since the slave sent something back
-				slave_info.set_ping(i, false);
-				process_message(i);				
-			} // END handle data from client
-		} // END got new incoming connection
+		}
+		else if (poller.contains(i))  // handle data from a client
+		{				
+			//set the ping flag since the slave sent something back
+			slave_info.set_ping(i, false);
+			slave_info.reset_last_recv_time(i);
+			process_message(i);				
+		} // END handle data from client
+	} // END looping through ready sockets
+	// send pings and check for overdue runs that are due
+	process_timers();
+}
+
+void RunManagerYAMR::process_timers()
+{
+	vector<YamrTimer> expired;
+	timer_wheel.expire(TimerWheel<YamrTimer>::Clock::now(), expired);
+	for (const auto &timer : expired)
+	{
+		// ignore timers of slaves that have since been closed
+		if (slave_info.get_conn_id(timer.sock_id) != timer.conn_id) continue;
+		if (timer.type == YamrTimer::Type::PING)
+		{
+			ping(timer.sock_id);
+		}
 		else
-		{						
-			for (auto it_slv = slave_info.begin(); it_slv != slave_info.end(); ++it_slv)
-			{
-				if ((i == it_slv->first) && (slave_info.get_state(i) == SlaveInfo::State::ACTIVE))
-				{					
-					ping(i);
-					break;
-				}
-			}			
+		{
+			check_overdue(timer);
 		}
-	} // END looping through file descriptors
+	}
+}
+
+void RunManagerYAMR::schedule_ping(int i_sock, double delay_sec)
+{
+	YamrTimer timer(YamrTimer::Type::PING, i_sock, slave_info.get_conn_id(i_sock));
+	timer_wheel.schedule_in(timer, chrono::milliseconds((long long)(delay_sec * 1000.0)));
 }
 
 void RunManagerYAMR::ping(int i_sock)
 {				
-	vector<string> sock_name = w_getnameinfo_vec(i_sock);
-	fd_set read_fds = master;
+	//check if it is time to ping again.  Only slaves that have not sent anything since the last ping
+	//or run are pinged
+	double duration = (double)min(slave_info.seconds_since_last_ping_time(i_sock),
+		slave_info.seconds_since_last_recv_time(i_sock));
+	double ping_time = max(double(PING_INTERVAL_SECS), slave_info.get_runtime_sec(i_sock));
+	if (duration < ping_time)
+	{
+		// a run was started or a message received since this ping was scheduled
+		schedule_ping(i_sock, ping_time - duration);
+		return;
+	}
+	vector<string> sock_name = slave_info.get_sock_name(i_sock);
 	//if the slave hasn't communicated since the last ping request
-	if ((!FD_ISSET(i_sock,&read_fds)) && (slave_info.get_ping(i_sock)))
+	if (slave_info.get_ping(i_sock))
 	{
 		int fails = slave_info.add_failed_ping(i_sock);		
 		report("failed to receive ping response from slave: "+sock_name[0]+"$"+slave_info.get_work_dir(i_sock),false);		
@@ -520,54 +823,55 @@ void RunManagerYAMR::ping(int i_sock)
 			return;
 		}		
 	}
-	//check if it is time to ping again...
-	double duration = (double)slave_info.seconds_since_last_ping_time(i_sock);
-	double ping_time = max(double(PING_INTERVAL_SECS), slave_info.get_runtime_sec(i_sock));
-	if (duration >= ping_time)
-	{		
-		const char* data = "\0";
-		NetPackage net_pack(NetPackage::PackType::PING, 0, 0, "");
-		int err = net_pack.send(i_sock, data, 0);
-		if (err <= 0)
+	const char* data = "\0";
+	NetPackage net_pack(NetPackage::PackType::PING, 0, 0, "");
+	int err = net_pack.send(i_sock, data, 0);
+	if (err <= 0)
+	{
+		int fails = slave_info.add_failed_ping(i_sock);			
+		report("failed to send ping request to slave:"+sock_name[0]+"$"+slave_info.get_work_dir(i_sock),false);			
+		if (fails >= MAX_FAILED_PINGS)
 		{
-			int fails = slave_info.add_failed_ping(i_sock);			
-			report("failed to send ping request to slave:"+sock_name[0]+"$"+slave_info.get_work_dir(i_sock),false);			
-			if (fails >= MAX_FAILED_PINGS)
-			{
-				report("max failed ping communications since last successful run for slave:" + sock_name[0] + "$" + slave_info.get_work_dir(i_sock) + "  -> terminating", true);
-				close_slave(i_sock);
-				return;
-			}
+			report("max failed ping communications since last successful run for slave:" + sock_name[0] + "$" + slave_info.get_work_dir(i_sock) + "  -> terminating", true);
+			close_slave(i_sock);
+			return;
 		}
-		else slave_info.set_ping(i_sock, true);
+	}
+	else slave_info.set_ping(i_sock, true);
 #ifdef _DEBUG
-		//report("ping sent to slave:" + sock_name[0] + "$" + slave_info.get_work_dir(i_sock), false);
+	//report("ping sent to slave:" + sock_name[0] + "$" + slave_info.get_work_dir(i_sock), false);
 #endif
-	}
+	schedule_ping(i_sock, ping_time);
 }
 
 void RunManagerYAMR::close_slave(int i_sock)
 {	
-	vector<string> sock_name = w_getnameinfo_vec(i_sock);
+	vector<string> sock_name = slave_info.get_sock_name(i_sock);
+	poller.remove(i_sock); // stop monitoring the socket
 	w_close(i_sock); // bye!
-	FD_CLR(i_sock, &master); // remove from master set
 	slave_info.erase(i_sock); // remove information on this slave
-	//remove slave from slave_fd 
-	auto it_sfd = find(slave_fd.begin(), slave_fd.end(), i_sock);
-	if (it_sfd != slave_fd.end())
+	//remove the free slots of the slave from slave_fd 
+	slave_fd.erase(remove(slave_fd.begin(), slave_fd.end(), i_sock), slave_fd.end());
+	// remove runs from active queue and return them to the waiting queue
+	for (const auto &active_run : active_runs.get_runs(i_sock))
 	{
-		slave_fd.erase(it_sfd);
+		if (completed_runs.find(active_run.get_id()) == completed_runs.end()) //check if run has already finish on another node
+		{
+			waiting_runs.push_front(active_run);
+		}
 	}
-	// remove run from active queue and return it to the waiting queue
-	auto it_active = get_active_run_id(i_sock);
-	if (it_active != active_runs.end())
+	active_runs.erase_socket(i_sock);
+	// zombie runs on this slave will never report back
+	zombie_runs.erase_socket(i_sock);
+	// return runs that were sent in a batch but not started to the waiting queue
+	auto it_queue = queued_runs.find(i_sock);
+	if (it_queue != queued_runs.end())
 	{
-		YamrModelRun &cur_run = it_active->second;
-		if (completed_runs.find(cur_run.get_id()) == completed_runs.end()) //check if run has already finish on another node
+		for (auto it_run = it_queue->second.rbegin(); it_run != it_queue->second.rend(); ++it_run)
 		{
-			waiting_runs.push_front(it_active->second);
+			waiting_runs.push_front(YamrModelRun(*it_run));
 		}
-		active_runs.erase(it_active);
+		queued_runs.erase(it_queue);
 	}
 	stringstream ss;
 	
@@ -578,7 +882,11 @@ void RunManagerYAMR::close_slave(int i_sock)
 
 bool RunManagerYAMR::schedule_run(int run_id)
 {
-	bool scheduled = false;
+	return schedule_run(run_id, find_slave_slot(run_id));
+}
+
+deque<int>::iterator RunManagerYAMR::find_slave_slot(int run_id)
+{
 	auto it_sock = slave_fd.end(); // iterator to current socket
 
 	if (completed_runs.count(run_id) > 0)
@@ -587,9 +895,8 @@ bool RunManagerYAMR::schedule_run(int run_id)
 	}
 	else if (failure_map.count(run_id) == 0 || failure_map.count(run_id) >= slave_fd.size())
 	{
-		// schedule a run on a slave
-		NetPackage net_pack(NetPackage::PackType::START_RUN, cur_group_id, run_id, "");
-		it_sock = slave_fd.begin();
+		// schedule a run on a slave that is not already working on it in another slot
+		for (it_sock = slave_fd.begin(); it_sock != slave_fd.end() && active_runs.find(*it_sock, run_id) != nullptr; ++it_sock) {}
 	}
 	else if (failure_map.count(run_id) > 0)
 	{
@@ -602,7 +909,7 @@ bool RunManagerYAMR::schedule_run(int run_id)
 				i != fail_iter_pair.second && i->second != *it_sock;
 				++i) {
 			}
-			if (i == fail_iter_pair.second)  // This is slave has not previously failed on this run
+			if (i == fail_iter_pair.second && active_runs.find(*it_sock, run_id) == nullptr)  // This is slave has not previously failed on this run
 			{
 				// This run has not previously failed on this slave
 				// Schedule run on it_sock
@@ -610,36 +917,24 @@ bool RunManagerYAMR::schedule_run(int run_id)
 			}
 		}
 	}
+	return it_sock;
+}
+
+bool RunManagerYAMR::schedule_run(int run_id, deque<int>::iterator it_sock)
+{
+	bool scheduled = false;
 	if (it_sock != slave_fd.end())
 	{
 		YamrModelRun tmp_run(run_id, *it_sock);
-		vector<char> data = file_stor.get_serial_pars(run_id);
-		vector<string> sock_name = w_getnameinfo_vec(*it_sock);
-		NetPackage net_pack(NetPackage::PackType::START_RUN, cur_group_id, run_id, "");
-		int err = net_pack.send(*it_sock, &data[0], data.size());
+		vector<string> sock_name = slave_info.get_sock_name(*it_sock);
+		int err = send_start_run(*it_sock, run_id);
 		if (err != -1)
 		{
-			//start run timer
-			slave_info.start_timer(*it_sock);
-			int concur;
-			auto it_concur = concurrent_map.find(run_id);
-			if (it_concur != concurrent_map.end())
-			{
-				concurrent_map[it_concur->first]++;
-				concur = it_concur->second;
-			}
-			else
-			{
-				concur = 1;
-				concurrent_map.insert(pair<int, int>(run_id, concur));				
-			}
-
+			int concur = start_run(*it_sock, run_id);
 			stringstream ss;
-			ss << "Sending run " << run_id << " to: " << sock_name[0] << "$" << slave_info.get_work_dir(*it_sock) << "  (group id = " << cur_group_id << ", run id = " << run_id << ", concurrent runs = " << concur << ")";
+			ss << "Sending run " << run_id << " to: " << sock_name[0] << "$" << slave_info.get_work_dir(*it_sock) << "  (group id = " << cur_group_id << ", run id = " << run_id << ", concurrent runs = " << concur << 
+				", expected run time = " << get_expected_runtime_sec(*it_sock, run_id) << " sec)";
 			report(ss.str(), false);
-			active_runs.insert(pair<int, YamrModelRun>(run_id, tmp_run));
-			//reset the last ping time so we don't ping immediately after run is started
-			slave_info.reset_last_ping_time(*it_sock);
 			slave_fd.erase(it_sock);
 			scheduled = true;			
 		}
@@ -647,12 +942,224 @@ bool RunManagerYAMR::schedule_run(int run_id)
 	return scheduled;
 }
 
+int RunManagerYAMR::send_start_run(int i_sock, int run_id)
+{
+	int err;
+	size_t par_size = file_stor.get_serial_pars_size();
+	size_t n_par = par_size / sizeof(double);
+	bool use_delta = slave_info.get_delta_pars(i_sock);
+	bool use_sparse = slave_info.get_sparse_obs(i_sock) && base_obs_group == cur_group_id;
+	if ((use_delta || use_sparse) && base_pars_group != cur_group_id && file_stor.get_nruns() > 0)
+	{
+		// the first run of the group (the base run of a jacobian) is the base the other runs are compared to
+		base_pars = file_stor.get_serial_pars(0);
+		base_pars_group = cur_group_id;
+	}
+	// the parameters are sent straight from the memory mapped run storage file when it is available
+	vector<char> data;
+	const char *par_ptr = file_stor.get_serial_pars_ptr(run_id);
+	if (par_ptr == nullptr)
+	{
+		data = file_stor.get_serial_pars(run_id);
+		par_ptr = data.data();
+	}
+	if ((use_delta || use_sparse) && base_pars_group == cur_group_id)
+	{
+		// START_RUN_DELTA data: the number of changed parameters followed by the index and value of each
+		vector<char> delta_data(sizeof(int32_t));
+		const size_t max_delta_size = par_size / 2;
+		size_t n_changed = 0;
+		for (size_t i = 0; i < n_par && n_changed * 2 <= n_par; ++i)
+		{
+			if (memcmp(par_ptr + i * sizeof(double), &base_pars[i * sizeof(double)], sizeof(double)) != 0)
+			{
+				int32_t idx = i;
+				delta_data.insert(delta_data.end(), (char*)&idx, (char*)&idx + sizeof(idx));
+				delta_data.insert(delta_data.end(), par_ptr + i * sizeof(double), par_ptr + (i + 1) * sizeof(double));
+				++n_changed;
+			}
+		}
+		// the observations of runs with parameters close to the base run are likely to be close to its
+		// results as well
+		if (use_sparse && n_changed * 2 <= n_par && slave_info.get_base_obs_group(i_sock) != cur_group_id)
+		{
+			vector<char> obs_data(sizeof(obs_tol));
+			memcpy(obs_data.data(), &obs_tol, sizeof(obs_tol));
+			obs_data.insert(obs_data.end(), base_obs.begin(), base_obs.end());
+			NetPackage obs_pack(NetPackage::PackType::BASE_OBS, cur_group_id, 0, "");
+			err = obs_pack.send(i_sock, obs_data.data(), obs_data.size());
+			if (err == -1)
+			{
+				return err;
+			}
+			slave_info.set_base_obs_group(i_sock, cur_group_id);
+		}
+		if (use_delta && n_changed * 2 <= n_par && delta_data.size() <= max_delta_size)
+		{
+			if (slave_info.get_base_pars_group(i_sock) != cur_group_id)
+			{
+				NetPackage base_pack(NetPackage::PackType::BASE_PARS, cur_group_id, 0, "");
+				err = base_pack.send(i_sock, base_pars.data(), base_pars.size());
+				if (err == -1)
+				{
+					return err;
+				}
+				slave_info.set_base_pars_group(i_sock, cur_group_id);
+			}
+			int32_t n_delta = n_changed;
+			memcpy(delta_data.data(), &n_delta, sizeof(n_delta));
+			NetPackage net_pack(NetPackage::PackType::START_RUN_DELTA, cur_group_id, run_id, "");
+			return net_pack.send(i_sock, delta_data.data(), delta_data.size());
+		}
+	}
+	NetPackage net_pack(NetPackage::PackType::START_RUN, cur_group_id, run_id, "");
+	return net_pack.send(i_sock, par_ptr, par_size);
+}
+
+int RunManagerYAMR::start_run(int i_sock, int run_id)
+{
+	int concur;
+	auto it_concur = concurrent_map.find(run_id);
+	if (it_concur != concurrent_map.end())
+	{
+		concurrent_map[it_concur->first]++;
+		concur = it_concur->second;
+	}
+	else
+	{
+		concur = 1;
+		concurrent_map.insert(pair<int, int>(run_id, concur));				
+	}
+	//start run timer
+	YamrModelRun model_run(run_id, i_sock);
+	model_run.set_start_time(chrono::system_clock::now());
+	active_runs.insert(model_run);
+	//reset the last ping time so we don't ping immediately after run is started
+	slave_info.reset_last_ping_time(i_sock);
+	//check if the run is overdue once a second until the slave's average runtime is known
+	YamrTimer timer(YamrTimer::Type::OVERDUE, i_sock, slave_info.get_conn_id(i_sock), run_id,
+		model_run.get_start_time());
+	timer_wheel.schedule_in(timer, chrono::seconds(1));
+	return concur;
+}
+
+int RunManagerYAMR::get_batch_size(int i_sock, size_t n_free_slaves) const
+{
+	if (batch_secs <= 0 || slave_info.get_slots(i_sock) > 1) return 1;
+	// the runtime of a slave is not known until it completes its first run
+	double runtime_sec = slave_info.get_runtime_sec(i_sock);
+	if (!(runtime_sec > 0)) return 1;
+	double n_batch = batch_secs / runtime_sec;
+	// leave enough runs for the other idle slaves
+	size_t fair_share = (waiting_runs.size() + n_free_slaves - 1) / max(n_free_slaves, size_t(1));
+	n_batch = min(n_batch, double(fair_share));
+	n_batch = min(n_batch, double(MAX_BATCH_RUNS));
+	return max(int(n_batch), 1);
+}
+
+bool RunManagerYAMR::schedule_batch(int i_sock, const vector<int> &run_id_vec)
+{
+	// START_RUN_BATCH data: the number of runs, the run ids and then the parameter values of each run.
+	// The parameter values are gathered from the run storage without being copied into one buffer
+	vector<int32_t> head_data;
+	int32_t n_runs = run_id_vec.size();
+	head_data.push_back(n_runs);
+	head_data.insert(head_data.end(), run_id_vec.begin(), run_id_vec.end());
+	vector<pair<const char*, size_t>> data_bufs;
+	data_bufs.push_back(make_pair((const char*)head_data.data(), head_data.size() * sizeof(int32_t)));
+	size_t par_size = file_stor.get_serial_pars_size();
+	vector<vector<char>> par_data_vec;
+	par_data_vec.reserve(run_id_vec.size());
+	for (int run_id : run_id_vec)
+	{
+		const char *par_ptr = file_stor.get_serial_pars_ptr(run_id);
+		if (par_ptr == nullptr)
+		{
+			par_data_vec.push_back(file_stor.get_serial_pars(run_id));
+			par_ptr = par_data_vec.back().data();
+		}
+		data_bufs.push_back(make_pair(par_ptr, par_size));
+	}
+	NetPackage net_pack(NetPackage::PackType::START_RUN_BATCH, cur_group_id, run_id_vec[0], "");
+	int err = net_pack.send(i_sock, data_bufs);
+	if (err == -1)
+	{
+		return false;
+	}
+	vector<string> sock_name = slave_info.get_sock_name(i_sock);
+	int concur = start_run(i_sock, run_id_vec[0]);
+	stringstream ss;
+	ss << "Sending batch of " << n_runs << " runs to: " << sock_name[0] << "$" << slave_info.get_work_dir(i_sock) << "  (group id = " << cur_group_id << ", run ids = " << run_id_vec.front() << "..." << run_id_vec.back() << ")";
+	report(ss.str(), false);
+	ss.str("");
+	ss << "starting run " << run_id_vec[0] << " on: " << sock_name[0] << "$" << slave_info.get_work_dir(i_sock) << "  (group id = " << cur_group_id << ", run id = " << run_id_vec[0] << ", concurrent runs = " << concur << ")";
+	report(ss.str(), false);
+	queued_runs[i_sock].assign(run_id_vec.begin() + 1, run_id_vec.end());
+	return true;
+}
+
+void RunManagerYAMR::start_queued_run(int i_sock)
+{
+	auto it_queue = queued_runs.find(i_sock);
+	if (it_queue == queued_runs.end())
+	{
+		return;
+	}
+	int run_id = it_queue->second.front();
+	it_queue->second.pop_front();
+	if (it_queue->second.empty())
+	{
+		queued_runs.erase(it_queue);
+	}
+	int concur = start_run(i_sock, run_id);
+	vector<string> sock_name = slave_info.get_sock_name(i_sock);
+	stringstream ss;
+	ss << "starting run " << run_id << " on: " << sock_name[0] << "$" << slave_info.get_work_dir(i_sock) << "  (group id = " << cur_group_id << ", run id = " << run_id << ", concurrent runs = " << concur << ")";
+	report(ss.str(), false);
+}
+
+void RunManagerYAMR::schedule_batches()
+{
+	size_t n_free_slaves = slave_fd.size();
+	for (auto it_sock = slave_fd.begin(); it_sock != slave_fd.end() && !waiting_runs.empty();)
+	{
+		int n_batch = get_batch_size(*it_sock, n_free_slaves);
+		// runs that have failed are scheduled one at a time so they can be sent to a different slave
+		vector<int> run_id_vec;
+		for (auto it_run = waiting_runs.begin(); it_run != waiting_runs.end() && int(run_id_vec.size()) < n_batch; ++it_run)
+		{
+			int run_id = it_run->get_id();
+			if (failure_map.count(run_id) == 0 && completed_runs.count(run_id) == 0)
+			{
+				run_id_vec.push_back(run_id);
+			}
+		}
+		if (run_id_vec.size() > 1 && schedule_batch(*it_sock, run_id_vec))
+		{
+			set<int> batch_ids(run_id_vec.begin(), run_id_vec.end());
+			waiting_runs.erase(remove_if(waiting_runs.begin(), waiting_runs.end(),
+				[&batch_ids](const YamrModelRun &r) { return batch_ids.count(r.get_id()) > 0; }), waiting_runs.end());
+			it_sock = slave_fd.erase(it_sock);
+		}
+		else
+		{
+			++it_sock;
+		}
+	}
+}
+
 void RunManagerYAMR::schedule_runs()
 {
 	NetPackage net_pack;
 	slave_info.sort_queue(slave_fd);
 	
-	//first try to schedule waiting runs
+	//send batches of runs to slaves whose runtime is short compared to batch_secs
+	if (batch_secs > 0)
+	{
+		schedule_batches();
+	}
+	//schedule the remaining waiting runs one at a time.  The most expensive runs are sent to the fastest slaves
+	sort_waiting_runs();
 	for (auto it_run = waiting_runs.begin(); !slave_fd.empty() && it_run != waiting_runs.end();)
 	{
 		bool success = schedule_run(it_run->get_id());
@@ -665,51 +1172,174 @@ void RunManagerYAMR::schedule_runs()
 			++it_run;
 		}
 	}
+	//use idle slaves to make copies of the runs expected to finish last
+	schedule_speculative_runs();
+}
 
-	//check for overdue runs
-	double duration, avg_runtime;
-	double global_avg_runtime = slave_info.get_global_runtime_minute();
-	bool should_schedule = false;
-	for (auto it_active = active_runs.begin(); !slave_fd.empty() && it_active != active_runs.end();++it_active)
-	{		
-		should_schedule = false;
-		int act_sock_id = it_active->second.get_socket();
-		int run_id = it_active->second.get_id();
-		unordered_map<int, int>::iterator it_concur;
-		duration = slave_info.get_duration_minute(act_sock_id);
-		avg_runtime = slave_info.get_runtime_minute(act_sock_id);
-		if (avg_runtime <= 0) avg_runtime = global_avg_runtime;
-		if (avg_runtime <= 0) avg_runtime = 1.0E+10;
-		if (duration > avg_runtime*PERCENT_OVERDUE_GIVEUP)
+const string& RunManagerYAMR::get_run_type(int run_id)
+{
+	auto it = run_type_map.find(run_id);
+	if (it == run_type_map.end())
+	{
+		// runs read from a restart file
+		int run_status;
+		string info_txt;
+		double info_value;
+		file_stor.get_info(run_id, run_status, info_txt, info_value);
+		it = run_type_map.insert(make_pair(run_id, info_txt)).first;
+	}
+	return it->second;
+}
+
+double RunManagerYAMR::get_run_cost(int run_id)
+{
+	auto it = run_cost_map.find(get_run_type(run_id));
+	if (it == run_cost_map.end()) return 1.0;
+	return it->second;
+}
+
+void RunManagerYAMR::update_run_cost(int i_sock, int run_id, double run_sec)
+{
+	double slave_sec = slave_info.get_runtime_sec(i_sock);
+	if (!(slave_sec > 0) || !(run_sec > 0)) return;
+	double cost = run_sec / slave_sec;
+	const string &run_type = get_run_type(run_id);
+	auto it = run_cost_map.find(run_type);
+	if (it == run_cost_map.end())
+	{
+		run_cost_map[run_type] = cost;
+	}
+	else
+	{
+		it->second += RUN_COST_WEIGHT * (cost - it->second);
+	}
+}
+
+double RunManagerYAMR::get_expected_runtime_sec(int i_sock, int run_id)
+{
+	double runtime_sec = slave_info.get_runtime_sec(i_sock);
+	if (!(runtime_sec > 0)) runtime_sec = slave_info.get_global_runtime_minute() * 60.0;
+	// nothing is known until the first run has completed
+	if (!(runtime_sec > 0)) return 0;
+	return runtime_sec * get_run_cost(run_id);
+}
+
+void RunManagerYAMR::sort_waiting_runs()
+{
+	// there is nothing to choose from until the cost of more than one type of run is known
+	if (run_cost_map.size() < 2 || waiting_runs.size() < 2 || slave_fd.empty()) return;
+	vector<pair<double, YamrModelRun>> cost_vec;
+	for (const auto &run : waiting_runs)
+	{
+		cost_vec.push_back(make_pair(get_run_cost(run.get_id()), run));
+	}
+	// most expensive runs first.  Runs of the same cost stay in the order they were added
+	stable_sort(cost_vec.begin(), cost_vec.end(),
+		[](const pair<double, YamrModelRun> &a, const pair<double, YamrModelRun> &b) { return a.first > b.first; });
+	waiting_runs.clear();
+	for (const auto &i_cost : cost_vec)
+	{
+		waiting_runs.push_back(i_cost.second);
+	}
+}
+
+void RunManagerYAMR::schedule_speculative_runs()
+{
+	// near the end of a set of runs slaves become idle while the last runs are still being made.  A copy of a run
+	// is started on an idle slave if it is expected to finish there before the copies already running
+	if (!waiting_runs.empty() || slave_fd.empty() || active_runs.empty()) return;
+	auto now = chrono::system_clock::now();
+	unordered_map<int, double> remaining_map; // expected time in seconds until the first copy of each run finishes
+	for (const auto &run : active_runs.get_runs())
+	{
+		int run_id = run.get_id();
+		auto it_concur = concurrent_map.find(run_id);
+		if (it_concur != concurrent_map.end() && it_concur->second >= MAX_CONCURRENT_RUNS) continue;
+		double expected_sec = get_expected_runtime_sec(run.get_socket(), run_id);
+		if (!(expected_sec > 0)) continue;
+		double elapsed_sec = chrono::duration_cast<chrono::milliseconds>(now - run.get_start_time()).count() / 1000.0;
+		// allow for the run taking one standard deviation longer than expected
+		double remaining_sec = max(expected_sec - elapsed_sec, 0.0) +
+			slave_info.get_runtime_sd_sec(run.get_socket()) * get_run_cost(run_id);
+		auto it_remain = remaining_map.find(run_id);
+		if (it_remain == remaining_map.end() || remaining_sec < it_remain->second)
 		{
-			vector<string> sock_name = w_getnameinfo_vec(act_sock_id);
-			stringstream ss;
-			ss << "killing overdue run " << run_id << " (" << duration << "|" << avg_runtime <<
-				" minutes) on: " << sock_name[0] << "$" << slave_info.get_work_dir(act_sock_id);
- 			report(ss.str(), false);
-			NetPackage net_pack(NetPackage::PackType::REQ_KILL, 0, 0, "");
-			char data = '\0';
-			int err = net_pack.send(act_sock_id, &data, sizeof(data));
-			if (err <= 0)
-			{
-				report("error sending kill request to slave:" + sock_name[0] + "$" +
-					slave_info.get_work_dir(act_sock_id), true);
-				close_slave(act_sock_id);
-			}			
+			remaining_map[run_id] = remaining_sec;
 		}
-		if (duration > avg_runtime*PERCENT_OVERDUE_RESCHED)
+	}
+	vector<pair<double, int>> remaining_vec;
+	for (const auto &i_remain : remaining_map)
+	{
+		remaining_vec.push_back(make_pair(i_remain.second, i_remain.first));
+	}
+	// runs expected to finish last first
+	sort(remaining_vec.begin(), remaining_vec.end(), [](const pair<double, int> &a, const pair<double, int> &b) { return a.first > b.first; });
+	for (const auto &i_remain : remaining_vec)
+	{
+		if (slave_fd.empty()) break;
+		int run_id = i_remain.second;
+		// the copy is costed on the slave it would be sent to
+		auto it_sock = find_slave_slot(run_id);
+		if (it_sock == slave_fd.end()) continue;
+		double copy_sec = get_expected_runtime_sec(*it_sock, run_id);
+		if (!(copy_sec > 0) || copy_sec >= i_remain.first) continue;
+		if (schedule_run(run_id, it_sock))
 		{
-			//check how many concurrent runs are going			
-			it_concur = concurrent_map.find(it_active->first);
-			if (it_concur == concurrent_map.end()) throw PestError("active run id not found in concurrent map");
-			if (it_concur->second < MAX_CONCURRENT_RUNS) should_schedule = true;			
+			stringstream ss;
+			ss << "speculative copy of run " << run_id << " (type = \"" << get_run_type(run_id) << "\", expected remaining time = " <<
+				i_remain.first << " sec, expected time of copy = " << copy_sec << " sec)";
+			report(ss.str(), false);
 		}
+	}
+}
 
-		if (should_schedule)
+void RunManagerYAMR::check_overdue(const YamrTimer &timer)
+{
+	int act_sock_id = timer.sock_id;
+	int run_id = timer.run_id;
+	// ignore the timer if the slave has finished this run or has started it again since
+	const YamrModelRun *active_run = active_runs.find(act_sock_id, run_id);
+	if (active_run == nullptr || active_run->get_start_time() != timer.start_time)
+	{
+		return;
+	}
+	chrono::system_clock::duration dt = chrono::system_clock::now() - active_run->get_start_time();
+	double duration = chrono::duration_cast<chrono::milliseconds>(dt).count() / 60000.0;
+	double avg_runtime = slave_info.get_runtime_minute(act_sock_id);
+	if (!(avg_runtime > 0)) avg_runtime = slave_info.get_global_runtime_minute();
+	if (!(avg_runtime > 0))
+	{
+		// no runs have completed yet so there is nothing to compare the duration with
+		timer_wheel.schedule_in(timer, chrono::seconds(PING_INTERVAL_SECS));
+		return;
+	}
+	if (duration > avg_runtime*PERCENT_OVERDUE_GIVEUP)
+	{
+		vector<string> sock_name = slave_info.get_sock_name(act_sock_id);
+		stringstream ss;
+		ss << "killing overdue run " << run_id << " (" << duration << "|" << avg_runtime <<
+			" minutes) on: " << sock_name[0] << "$" << slave_info.get_work_dir(act_sock_id);
+		report(ss.str(), false);
+		NetPackage net_pack(NetPackage::PackType::REQ_KILL, cur_group_id, run_id, "");
+		char data = '\0';
+		int err = net_pack.send(act_sock_id, &data, sizeof(data));
+		if (err <= 0)
 		{
-			vector<string> sock_name = w_getnameinfo_vec(act_sock_id);
+			report("error sending kill request to slave:" + sock_name[0] + "$" +
+				slave_info.get_work_dir(act_sock_id), true);
+			close_slave(act_sock_id);
+			return;
+		}
+	}
+	if (duration > avg_runtime*PERCENT_OVERDUE_RESCHED)
+	{
+		//check how many concurrent runs are going			
+		auto it_concur = concurrent_map.find(run_id);
+		if (it_concur == concurrent_map.end()) throw PestError("active run id not found in concurrent map");
+		if (it_concur->second < MAX_CONCURRENT_RUNS && !slave_fd.empty())
+		{
+			vector<string> sock_name = slave_info.get_sock_name(act_sock_id);
 			stringstream ss;
-			int run_id = it_active->second.get_id();
 			ss << "rescheduling overdue run " << run_id << " (" << duration << "|" <<
 				avg_runtime << " minutes) on: " << sock_name[0] << "$" << 
 				slave_info.get_work_dir(act_sock_id);
@@ -718,7 +1348,7 @@ void RunManagerYAMR::schedule_runs()
 			if (success)
 			{
 				stringstream ss;
-				ss << concurrent_map[it_concur->first] << " concurrent runs for run id = " << run_id;
+				ss << concurrent_map[run_id] << " concurrent runs for run id = " << run_id;
 				report(ss.str(), false);
 			}
 			else
@@ -728,6 +1358,13 @@ void RunManagerYAMR::schedule_runs()
 				report(ss.str(), false);
 			}
 		}
+		// check again shortly in case a slave becomes available or the run needs to be killed
+		timer_wheel.schedule_in(timer, chrono::seconds(1));
+	}
+	else
+	{
+		double wait_sec = (avg_runtime*PERCENT_OVERDUE_RESCHED - duration) * 60.0;
+		timer_wheel.schedule_in(timer, chrono::milliseconds((long long)(wait_sec * 1000.0) + 1));
 	}
 }
 
@@ -759,7 +1396,7 @@ void RunManagerYAMR::process_message(int i_sock)
 	echo();
 	NetPackage net_pack;
 	int err;
-	vector<string> sock_name = w_getnameinfo_vec(i_sock);
+	vector<string> sock_name = slave_info.get_sock_name(i_sock);
 	//std::time_t tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 	if(( err=net_pack.recv(i_sock)) <=0) // error or lost connection
 	{
@@ -782,20 +1419,52 @@ void RunManagerYAMR::process_message(int i_sock)
 	}
 	else if (net_pack.get_type() == NetPackage::PackType::LINPACK)
 	{
-		slave_info.end_linpack(i_sock);
 		slave_info.set_state(i_sock, SlaveInfo::State::LINPACK_RCV);
+		// the slave sends the number of runs it can make at the same time followed by its calibrated
+		// benchmark time.  Older slaves send nothing and are timed by the master
+		const vector<char> &data = net_pack.get_data();
+		int32_t n_slots = 1;
+		double linpack_secs = -1;
+		if (data.size() >= sizeof(n_slots))
+		{
+			memcpy(&n_slots, data.data(), sizeof(n_slots));
+		}
+		if (data.size() >= sizeof(n_slots) + sizeof(linpack_secs))
+		{
+			memcpy(&linpack_secs, data.data() + sizeof(n_slots), sizeof(linpack_secs));
+		}
+		int32_t features = 0;
+		if (data.size() >= sizeof(n_slots) + sizeof(linpack_secs) + sizeof(features))
+		{
+			memcpy(&features, data.data() + sizeof(n_slots) + sizeof(linpack_secs), sizeof(features));
+		}
+		slave_info.set_delta_pars(i_sock, (features & NetPackage::FEATURE_DELTA_PARS) != 0);
+		slave_info.set_sparse_obs(i_sock, (features & NetPackage::FEATURE_SPARSE_OBS) != 0);
+		if (linpack_secs > 0)
+		{
+			slave_info.end_linpack(i_sock, linpack_secs);
+		}
+		else
+		{
+			slave_info.end_linpack(i_sock);
+			linpack_secs = slave_info.get_duration_sec(i_sock);
+		}
+		slave_info.set_slots(i_sock, n_slots);
 		stringstream ss;
-		ss << "new slave ready: " << sock_name[0] << ":" << sock_name[1];
+		ss << "new slave ready: " << sock_name[0] << ":" << sock_name[1] << "; number of slots: " << slave_info.get_slots(i_sock)
+			<< "; benchmark time: " << linpack_secs << " sec";
 		report(ss.str(), false);
 	}
 	else if (net_pack.get_type() == NetPackage::PackType::READY)
 	{
-		// ready message received from slave add slave to slave_fd
+		// ready message received from slave add slave to slave_fd.  Slaves with several slots send one
+		// ready message for each slot that becomes free
 		slave_fd.push_back(i_sock);
 		
 	}
 
-	else if (net_pack.get_type() == NetPackage::PackType::RUN_FINISH && net_pack.get_groud_id() != cur_group_id)
+	else if ((net_pack.get_type() == NetPackage::PackType::RUN_FINISH || net_pack.get_type() == NetPackage::PackType::RUN_FINISH_SPARSE)
+		&& net_pack.get_groud_id() != cur_group_id)
 	{		
 		// this is an old run that did not finish on time
 		// just ignore it
@@ -806,7 +1475,7 @@ void RunManagerYAMR::process_message(int i_sock)
 		ss << "run " << run_id << " received from unexpected group id: " << group_id << ", should be group: " << cur_group_id;
 		throw PestError(ss.str());
 	}
-	else if (net_pack.get_type() == NetPackage::PackType::RUN_FINISH)
+	else if (net_pack.get_type() == NetPackage::PackType::RUN_FINISH || net_pack.get_type() == NetPackage::PackType::RUN_FINISH_SPARSE)
 	{		
 		int run_id = net_pack.get_run_id();
 		int group_id = net_pack.get_groud_id();
@@ -819,28 +1488,40 @@ void RunManagerYAMR::process_message(int i_sock)
 		
 
 		//check if this was a zombie run
-		auto it_zombie = get_zombie_run_id(i_sock);
-		if (it_zombie != zombie_runs.end())
+		if (zombie_runs.erase(i_sock, run_id))
 		{
 			stringstream ss;
 			ss << "zombie run " << run_id << " finished on: " << sock_name[0] << "$" << slave_info.get_work_dir(i_sock) << 
 				"  (run time = " << slave_info.get_runtime_minute(i_sock) << " min, group id = " << group_id <<
 				", run id = " << run_id << " concurrent = " << concur << ")";
 			report(ss.str(), false);
-			zombie_runs.erase(it_zombie);
 		}
 		else
 		{
 			// keep track of model run time
-			slave_info.end_run(i_sock);
+			const YamrModelRun *active_run = active_runs.find(i_sock, run_id);
+			if (active_run != nullptr)
+			{
+				chrono::system_clock::duration dt = chrono::system_clock::now() - active_run->get_start_time();
+				update_run_cost(i_sock, run_id, chrono::duration_cast<chrono::milliseconds>(dt).count() / 1000.0);
+				slave_info.end_run(i_sock, active_run->get_start_time());
+			}
 			stringstream ss;
 			ss << "run " << run_id << " received from: " << sock_name[0] << "$" << slave_info.get_work_dir(i_sock) << 
 				"  (run time = " << slave_info.get_runtime_minute(i_sock) << " min, group id = " << group_id <<
 				", run id = " << run_id << " concurrent = " << concur << ")";
+			// slaves report the resources used by the run in the description (older slaves leave it empty)
+			RunUsage usage;
+			if (usage.from_string(net_pack.get_desc()))
+			{
+				ss << "  (cpu time = " << usage.user_secs + usage.sys_secs << " sec, max memory = " <<
+					usage.max_rss_kb / 1024 << " MB)";
+			}
 			report(ss.str(), false);
 			process_model_run(i_sock, net_pack);
 		}
-
+		//start the next run of a batch
+		start_queued_run(i_sock);
 	}
 	else if (net_pack.get_type() == NetPackage::PackType::RUN_FAILED)
 	{
@@ -852,13 +1533,11 @@ void RunManagerYAMR::process_message(int i_sock)
 		concurrent_map[it_concur->first]--;
 		int concur = concurrent_map[it_concur->first];
 		// remove run from active queue and return it to the waiting queue
-		auto it_zombie = get_zombie_run_id(i_sock);
-		if (it_zombie != zombie_runs.end())
+		if (zombie_runs.erase(i_sock, run_id))
 		{
 			stringstream ss;
 			ss << "zombie run " << run_id << " killed on slave: " << sock_name[0] << "$" << slave_info.get_work_dir(i_sock) << ", run id = " << run_id << " concurrent = " << concur;
 			report(ss.str(),false);
-			zombie_runs.erase(it_zombie);
 		}
 		else
 		{
@@ -868,15 +1547,16 @@ void RunManagerYAMR::process_message(int i_sock)
 			model_runs_failed++;
 			file_stor.update_run_failed(run_id);
 			failure_map.insert(make_pair(run_id, i_sock));
-			auto it = get_active_run_id(i_sock);
-			active_runs.erase(it);
+			active_runs.erase(i_sock, run_id);
 			// TO DO add check for number of active nodes
-			if (failure_map.count(run_id) < max_n_failure)
+			if (failure_map.count(run_id) < size_t(max_n_failure))
 			{
 				//put model run back into the waiting queue
 				waiting_runs.push_front(YamrModelRun(run_id, i_sock));
 			}
 		}
+		//start the next run of a batch
+		start_queued_run(i_sock);
 	}
 	else if (net_pack.get_type() == NetPackage::PackType::PING)
 	{
@@ -898,6 +1578,42 @@ void RunManagerYAMR::process_message(int i_sock)
 	}
 }
 
+const vector<char> &RunManagerYAMR::get_run_data(int sock_id, NetPackage &net_pack)
+{
+	if (net_pack.get_type() != NetPackage::PackType::RUN_FINISH_SPARSE)
+	{
+		return net_pack.get_data();
+	}
+	// the data contains the parameters followed by the number of observations that differ from the base
+	// observations and the index and value of each
+	const vector<char> &data = net_pack.get_data();
+	const size_t par_size = file_stor.get_serial_pars_size();
+	const size_t entry_size = sizeof(int32_t) + sizeof(double);
+	int32_t n_sparse = -1;
+	if (data.size() >= par_size + sizeof(n_sparse)) memcpy(&n_sparse, &data[par_size], sizeof(n_sparse));
+	sparse_run_data.clear();
+	if (slave_info.get_base_obs_group(sock_id) != net_pack.get_groud_id() || base_obs_group != net_pack.get_groud_id()
+		|| n_sparse < 0 || data.size() != par_size + sizeof(n_sparse) + n_sparse * entry_size)
+	{
+		return sparse_run_data;
+	}
+	sparse_run_data.assign(data.begin(), data.begin() + par_size);
+	sparse_run_data.insert(sparse_run_data.end(), base_obs.begin(), base_obs.end());
+	for (int32_t i = 0; i < n_sparse; ++i)
+	{
+		int32_t idx;
+		const char *entry = &data[par_size + sizeof(n_sparse) + i * entry_size];
+		memcpy(&idx, entry, sizeof(idx));
+		if (idx < 0 || (idx + 1) * sizeof(double) > base_obs.size())
+		{
+			sparse_run_data.clear();
+			break;
+		}
+		memcpy(&sparse_run_data[par_size + idx * sizeof(double)], entry + sizeof(idx), sizeof(double));
+	}
+	return sparse_run_data;
+}
+
  bool RunManagerYAMR::process_model_run(int sock_id, NetPackage &net_pack)
  {
 	bool use_run = false;
@@ -906,45 +1622,62 @@ void RunManagerYAMR::process_message(int i_sock)
 	//check if another instance of this model run has already completed 
 	if (completed_runs.find(run_id) == completed_runs.end())
 	{
+		// the slave serializes the results in the order of the master's parameter and observation
+		// names so they can be written directly to the run storage without being unpacked
+		const vector<char> &run_data = get_run_data(sock_id, net_pack);
+		if (!file_stor.is_valid_serial_data(run_data))
+		{
+			vector<string> sock_name = slave_info.get_sock_name(sock_id);
+			stringstream ss;
+			ss << "invalid results received for run " << run_id << " from slave: " << sock_name[0] << "$" << slave_info.get_work_dir(sock_id) << " - treating run as failed";
+			report(ss.str(), true);
+			model_runs_failed++;
+			file_stor.update_run_failed(run_id);
+			failure_map.insert(make_pair(run_id, sock_id));
+			active_runs.erase(sock_id, run_id);
+			if (failure_map.count(run_id) < size_t(max_n_failure))
+			{
+				//put model run back into the waiting queue
+				waiting_runs.push_front(YamrModelRun(run_id, sock_id));
+			}
+			return use_run;
+		}
 		completed_runs.insert(pair<int, YamrModelRun>(run_id,  model_run));
-		Parameters pars;
-		Observations obs;
-		Serialization::unserialize(net_pack.get_data(), pars, get_par_name_vec(), obs, get_obs_name_vec());
-		file_stor.update_run(run_id, pars, obs);
+		file_stor.update_run(run_id, run_data);
+		if (run_id == 0)
+		{
+			// keep the observations of the base run before they are rounded by the run storage
+			base_obs.assign(run_data.begin() + file_stor.get_serial_pars_size(), run_data.end());
+			base_obs_group = cur_group_id;
+		}
 		use_run = true;
 		model_runs_done++;
 		//beopest-style screen output for run counting		
 		//cout << setw(7) << model_runs_done;
 		//if (model_runs_done % 9 == 0) cout << endl;				
 	}
-	auto range_pair = active_runs.equal_range(run_id);
 	//remaining runs with this id are not needed so mark them as zombies
-	for ( auto b=range_pair.first; b!=range_pair.second; ++b)
+	for (int act_sock_id : active_runs.get_sockets(run_id))
 	{
-		if ( (*b).second.get_socket() != model_run.get_socket())
+		if (act_sock_id != model_run.get_socket())
 		{
-			zombie_runs.insert(*b);
+			zombie_runs.insert(*active_runs.find(act_sock_id, run_id));
 		}
+		active_runs.erase(act_sock_id, run_id);
 	}
-	active_runs.erase(range_pair.first, range_pair.second);
 	//kill all zombies
-	for (auto it_zombie = zombie_runs.begin(); it_zombie != zombie_runs.end(); ++it_zombie)
+	for (int zombie_id : zombie_runs.get_sockets(run_id))
 	{
-		if (it_zombie->second.get_id() == run_id)
+		vector<string> sock_name = slave_info.get_sock_name(zombie_id);
+		stringstream ss;
+		ss << "killing zombie run " << run_id << " on slave : " << sock_name[0] << "$" << slave_info.get_work_dir(zombie_id);
+		report(ss.str(), false);
+		NetPackage net_pack(NetPackage::PackType::REQ_KILL, cur_group_id, run_id, "");
+		char data = '\0';
+		int err = net_pack.send(zombie_id, &data, sizeof(data));
+		if (err <= 0)
 		{
-
-			int zombie_id = it_zombie->second.get_socket();
-			vector<string> sock_name = w_getnameinfo_vec(zombie_id);
-			stringstream ss;
-			ss << "killing zombie run " << run_id << " on slave : " << sock_name[0] << "$" << slave_info.get_work_dir(zombie_id);
-			report(ss.str(), false);
-			NetPackage net_pack(NetPackage::PackType::REQ_KILL, 0, 0, "");
-			char data = '\0';
-			int err = net_pack.send(zombie_id, &data, sizeof(data));
-			if (err <= 0)
-			{
-				report("error sending kill request to slave:" + sock_name[0] + "$" + slave_info.get_work_dir(zombie_id), true);
-			}
+			report("error sending kill request to slave:" + sock_name[0] + "$" + slave_info.get_work_dir(zombie_id), true);
 		}
 	}
 	return use_run;
@@ -959,7 +1692,10 @@ void RunManagerYAMR::process_message(int i_sock)
 		SlaveInfo::State cur_state = slave_info.get_state(i_sock);
 		if (cur_state == SlaveInfo::State::NEW)
 		{
-			NetPackage net_pack(NetPackage::PackType::REQ_RUNDIR, 0, 0, "");
+			// the description tells the slave that this master understands version 2 headers and
+			// whether results should be compressed
+			NetPackage net_pack(NetPackage::PackType::REQ_RUNDIR, 0, 0,
+				compress ? NetPackage::V2_COMPRESS_TAG : NetPackage::V2_TAG);
 			char data = '\0';
 			int err = net_pack.send(i_sock, &data, sizeof(data));
 			if (err != -1)
@@ -991,7 +1727,7 @@ void RunManagerYAMR::process_message(int i_sock)
 		else if(cur_state == SlaveInfo::State::CMD_SENT)
 		{
 			NetPackage net_pack(NetPackage::PackType::REQ_LINPACK, 0, 0, "");
-			char data = '\0';
+			int32_t data = recalibrate ? 1 : 0;
 			int err = net_pack.send(i_sock, &data, sizeof(data));
 			if (err != -1)
 			{
@@ -1002,7 +1738,9 @@ void RunManagerYAMR::process_message(int i_sock)
 		else if(cur_state == SlaveInfo::State::LINPACK_RCV)
 		{
 			slave_info.set_state(i_sock, SlaveInfo::State::ACTIVE);
-			slave_fd.push_back(i_sock);			
+			// one entry for each slot of the slave
+			slave_fd.insert(slave_fd.end(), slave_info.get_slots(i_sock), i_sock);
+			schedule_ping(i_sock, PING_INTERVAL_SECS);
 		}
 	}
  }
@@ -1011,19 +1749,22 @@ RunManagerYAMR::~RunManagerYAMR(void)
 {
 	//close sockets and cleanup
 	int err;
+	poller.remove(listener);
 	err = w_close(listener);
-	FD_CLR(listener, &master);
+	if (broker_fd != -1)
+	{
+		w_close(broker_fd);
+	}
 	// this is needed to ensure that the first slave closes properly
 	w_sleep(2000);	
-	for(int i = 0; i <= fdmax; i++) {
-		if (FD_ISSET(i, &master)) 
-		{
-			NetPackage netpack(NetPackage::PackType::TERMINATE, 0, 0,"");
-			char data;
-			netpack.send(i, &data, 0);
-			err = w_close(i);
-			FD_CLR(i, &master);
-		}
+	set<int> sockets = poller.get_sockets();
+	for (int i : sockets)
+	{
+		NetPackage netpack(NetPackage::PackType::TERMINATE, 0, 0,"");
+		char data;
+		netpack.send(i, &data, 0);
+		poller.remove(i);
+		err = w_close(i);
 	}
 	w_cleanup();
 }
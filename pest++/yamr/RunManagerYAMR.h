@@ -20,12 +20,15 @@
 #define RUNMANAGERYAMR_H
 #include "network_wrapper.h"
 #include <string>
+#include <vector>
 #include <set>
 #include <deque>
 #include <unordered_map>
 #include <chrono>
 #include "network_wrapper.h"
 #include "network_package.h"
+#include "network_poller.h"
+#include "timer_wheel.h"
 #include "RunManagerAbstract.h"
 #include "RunStorage.h"
 
@@ -33,13 +36,47 @@ class YamrModelRun
 {
 public:
 	YamrModelRun(int _run_id, int _sockfd=0);
-	int get_id(){return run_id;}
+	int get_id() const {return run_id;}
 	void set_socket(int _sockfd) {sockfd = _sockfd;}
 	int get_socket() const  {return sockfd;}
+	void set_start_time(std::chrono::system_clock::time_point _start_time) {start_time = _start_time;}
+	std::chrono::system_clock::time_point get_start_time() const {return start_time;}
 	~YamrModelRun() {}
 private:
 	int sockfd;
 	int run_id;
+	std::chrono::system_clock::time_point start_time;
+};
+
+// Model runs assigned to slaves.  A slave works on one model run per slot, so the runs are indexed both by
+// socket and by run id.  This provides constant time lookup of the runs assigned to a slave and of all the
+// slaves working on the same run (ie. concurrent runs).
+class YamrRunTable
+{
+public:
+	YamrRunTable() : n_runs(0) {}
+	// add run to the table.  Replaces the same run if it is already assigned to the same socket
+	void insert(const YamrModelRun &run);
+	// returns run_id assigned to sock_id or nullptr if it is not in the table
+	const YamrModelRun* find(int sock_id, int run_id) const;
+	// removes run_id assigned to sock_id.  Returns false if it is not in the table
+	bool erase(int sock_id, int run_id);
+	// removes all runs assigned to sock_id.  Returns the number of runs removed
+	size_t erase_socket(int sock_id);
+	// returns the runs assigned to sock_id
+	std::vector<YamrModelRun> get_runs(int sock_id) const;
+	// returns all runs in the table
+	std::vector<YamrModelRun> get_runs() const;
+	// returns the sockets of all slaves working on run_id
+	std::vector<int> get_sockets(int run_id) const;
+	size_t count(int run_id) const;
+	size_t size() const { return n_runs; }
+	bool empty() const { return n_runs == 0; }
+	void clear();
+private:
+	std::unordered_map<int, std::vector<YamrModelRun>> sock_map;
+	std::unordered_map<int, std::vector<int>> run_map;
+	size_t n_runs;
 };
 
 
@@ -58,9 +95,18 @@ public:
 			State state;
 			std::chrono::system_clock::duration linpack_time;
 			std::chrono::system_clock::duration run_time;			
+			double run_time_var; // variance of the run time in seconds^2
 			std::chrono::system_clock::time_point start_time;
 			std::chrono::system_clock::time_point last_ping_time;
+			std::chrono::system_clock::time_point last_recv_time;
+			std::vector<std::string> sock_name; // host and port of the slave
 			std::string work_dir;
+			int conn_id;
+			int n_slots;
+			bool delta_pars;
+			int base_pars_group;
+			bool sparse_obs;
+			int base_obs_group;
 		};
 	typedef std::unordered_map<int, SlaveRec>::iterator iterator;
 	typedef std::unordered_map<int, SlaveRec>::const_iterator const_iterator;
@@ -70,19 +116,43 @@ public:
 	SlaveInfo::const_iterator end() const {return slave_info_map.end();}
 	SlaveInfo();
 	size_t size() const;
+	// add the slave connected on sock_id.  Its host name and port are looked up once here
 	void add(int sock_id);
 	void erase(int sock_id);
+	// unique id of the connection using sock_id or -1 if there is no slave on sock_id.  Socket numbers are
+	// reused by the operating system so this is used to check that a timer still refers to the same slave
+	int get_conn_id(int sock_id) const;
+	const std::vector<std::string> &get_sock_name(int sock_id) const;
+	std::chrono::system_clock::time_point get_start_time(int sock_id) const;
+	// number of model runs the slave can make at the same time
+	void set_slots(int sock_id, int n_slots);
+	int get_slots(int sock_id) const;
+	// true if the slave accepts parameters as differences from the base parameters of the group
+	void set_delta_pars(int sock_id, bool delta_pars);
+	bool get_delta_pars(int sock_id) const;
+	// group of the base parameters last sent to the slave or -1
+	void set_base_pars_group(int sock_id, int group_id);
+	int get_base_pars_group(int sock_id) const;
+	// true if the slave can return the observations that differ from the base observations of the group
+	void set_sparse_obs(int sock_id, bool sparse_obs);
+	bool get_sparse_obs(int sock_id) const;
+	// group of the base observations last sent to the slave or -1
+	void set_base_obs_group(int sock_id, int group_id);
+	int get_base_obs_group(int sock_id) const;
 	State get_state(int sock_id);
 	void set_state(int sock_id, const State);
 	void set_work_dir(int sock_id, const std::string & wkd);
 	std::string get_work_dir(int sock_id) const;
 	void start_timer(int sock_id);
-	void end_run(int sock_id);
+	void end_run(int sock_id, std::chrono::system_clock::time_point run_start_time);
 	void end_linpack(int sock_id);
+	// use the benchmark time reported by the slave instead of the time taken to reply
+	void end_linpack(int sock_id, double linpack_secs);
 	double get_runtime(int sock_id);
 	double get_duration_sec(int sock_id);
 	double get_duration_minute(int sock_id);
-	double get_runtime_sec(int sock_id);
+	double get_runtime_sec(int sock_id) const;
+	double get_runtime_sd_sec(int sock_id) const;
 	double get_runtime_minute(int sock_id);
 	double get_global_runtime_minute();
 	double get_linpack_time(int sock_id);
@@ -93,8 +163,13 @@ public:
 	void reset_failed_pings(int sock_id);
 	void reset_last_ping_time(int sock_id);	
 	int seconds_since_last_ping_time(int sock_id);
+	// any message received from the slave shows that it is alive, so pings are only sent to idle slaves
+	void reset_last_recv_time(int sock_id);
+	int seconds_since_last_recv_time(int sock_id);
 	~SlaveInfo();
 private:
+	// weight of the latest run in the exponentially weighted average and variance of the run time
+	const double RUNTIME_WEIGHT = 0.3;
 	class CompareTimes
 	{
 	public:
@@ -103,6 +178,7 @@ private:
 		SlaveInfo *my_class_ptr;
 	};
 	std::unordered_map<int, SlaveRec> slave_info_map;
+	int last_conn_id;
 };
 
 class RunManagerYAMR : public RunManagerAbstract
@@ -111,7 +187,8 @@ public:
 	RunManagerYAMR(const std::vector<std::string> _comline_vec,
 		const std::vector<std::string> _tplfile_vec, const std::vector<std::string> _inpfile_vec,
 		const std::vector<std::string> _insfile_vec, const std::vector<std::string> _outfile_vec,
-		const std::string &stor_filename, const std::string &port, std::ofstream &_f_rmr, int _max_n_failure=3);
+		const std::string &stor_filename, const std::string &port, std::ofstream &_f_rmr, int _max_n_failure=3,
+		double _batch_secs=0.0, bool _recalibrate=false, bool _compress=false, double _obs_tol=0.0);
 	virtual void initialize(const Parameters &model_pars, const Observations &obs, const std::string &_filename = std::string(""));
 	virtual void initialize_restart(const std::string &_filename);
 	virtual void reinitialize(const std::string &_filename = std::string(""));
@@ -119,7 +196,11 @@ public:
 	virtual int add_run(const Parameters &model_pars, const std::string &info_txt="", double info_value=RunStorage::no_data);
 	virtual int add_run(const std::vector<double> &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
 	virtual int add_run(const Eigen::VectorXd &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
+	virtual std::vector<int> add_runs(const Eigen::MatrixXd &model_pars, const std::vector<std::string> &info_txt_vec = std::vector<std::string>(),
+		const std::vector<double> &info_value_vec = std::vector<double>());
 	virtual void run();
+	// register with a YAMR broker (see YamrBroker) so it connects its slaves to this master
+	void connect_broker(const std::string &host, const std::string &broker_port);
 	~RunManagerYAMR(void);
 private:
 	std::string port;
@@ -127,35 +208,101 @@ private:
 	static const int MAX_FAILED_PINGS = 3;
 	static const int PING_INTERVAL_SECS = 5;
 	static const int MAX_CONCURRENT_RUNS = 3;
+	static const int MAX_BATCH_RUNS = 100;
 	const double PERCENT_OVERDUE_RESCHED = 1.15; //15% past average runtime
 	const double PERCENT_OVERDUE_GIVEUP = 10.0; //1000% past average runtime	
+	const double RUN_COST_WEIGHT = 0.3; //weight of the latest run in the cost estimate of a run type
+	class YamrTimer
+	{
+	public:
+		enum class Type { PING, OVERDUE };
+		YamrTimer(Type _type, int _sock_id, int _conn_id, int _run_id = -1,
+			std::chrono::system_clock::time_point _start_time = std::chrono::system_clock::time_point())
+			: type(_type), sock_id(_sock_id), conn_id(_conn_id), run_id(_run_id), start_time(_start_time) {}
+		Type type;
+		int sock_id;
+		int conn_id;
+		int run_id;
+		std::chrono::system_clock::time_point start_time;
+	};
 	int listener;
-	int fdmax;
+	int broker_fd;
 	int model_runs_done;
 	int model_runs_failed;
-	std::deque<int> slave_fd; // list of slaves ready to accept a model run
-	fd_set master; // master file descriptor list
+	std::deque<int> slave_fd; // list of slaves ready to accept a model run.  Contains a slave once for each free slot
+	NetPoller poller; // sockets of the listener and all slaves
+	TimerWheel<YamrTimer> timer_wheel; // ping and overdue run deadlines
 	std::deque<YamrModelRun> waiting_runs;
 	std::ofstream &f_rmr;
-	std::unordered_multimap<int, YamrModelRun> active_runs;
-	std::unordered_multimap<int, YamrModelRun> zombie_runs;
+	// target wall time in seconds of a batch of runs sent to a slave in one START_RUN_BATCH message.
+	// Runs are sent one at a time when batch_secs <= 0
+	double batch_secs;
+	// ask slaves to repeat their calibration instead of reporting the cached benchmark time
+	bool recalibrate;
+	// ask slaves to compress large payloads such as the results of model runs
+	bool compress;
+	// parameters of the first run of the group.  START_RUN_DELTA packages only contain the parameters
+	// that differ from them
+	std::vector<char> base_pars;
+	int base_pars_group;
+	// observations of the first run of the group.  Slaves that have them return RUN_FINISH_SPARSE packages
+	// containing the observations that differ from them by more than obs_tol (relative).  obs_tol = 0
+	// only leaves out observations that are identical
+	std::vector<char> base_obs;
+	int base_obs_group;
+	double obs_tol;
+	std::vector<char> sparse_run_data;
+	// serialized results of a RUN_FINISH or RUN_FINISH_SPARSE package.  Empty if the package is invalid
+	const std::vector<char> &get_run_data(int sock_id, NetPackage &net_pack);
+	std::unordered_map<int, std::deque<int>> queued_runs; // runs sent to a slave in a batch that have not started
+	YamrRunTable active_runs;
+	YamrRunTable zombie_runs;
 	std::unordered_map<int, YamrModelRun> completed_runs;
 	SlaveInfo slave_info;
 	std::unordered_multimap<int, int> failure_map;
 	std::unordered_map<int, int> concurrent_map;
+	// runs are grouped into types by their info_txt (ie. the perturbed parameter of a jacobian run).  The cost
+	// of a type is the exponentially weighted average of its runtimes relative to the average runtime of the
+	// slaves that made them
+	std::unordered_map<int, std::string> run_type_map;
+	std::unordered_map<std::string, double> run_cost_map;
 	void listen();
 	bool process_model_run(int sock_id, NetPackage &net_pack);
 	void process_message(int i);
 	bool schedule_run(int run_id);
+	// free slave slot that can take run_id: a slave that is not already making the run and, if the run has
+	// failed, one it has not failed on.  Returns slave_fd.end() if there is none
+	std::deque<int>::iterator find_slave_slot(int run_id);
+	// send run_id to the slave slot it_sock.  Returns true if the run was started
+	bool schedule_run(int run_id, std::deque<int>::iterator it_sock);
 	void schedule_runs();
+	int start_run(int i_sock, int run_id);
+	// send START_RUN, or START_RUN_DELTA preceded by BASE_PARS when the slave does not have the base
+	// parameters of the group yet.  BASE_OBS is sent first for runs close to the base run if the slave
+	// does not have the base observations of the group.  Returns -1 if a send failed
+	int send_start_run(int i_sock, int run_id);
+	// batches are only sent to slaves with a single slot
+	int get_batch_size(int i_sock, size_t n_free_slaves) const;
+	bool schedule_batch(int i_sock, const std::vector<int> &run_id_vec);
+	void schedule_batches();
+	void start_queued_run(int i_sock);
+	const std::string& get_run_type(int run_id);
+	double get_run_cost(int run_id);
+	void update_run_cost(int i_sock, int run_id, double run_sec);
+	double get_expected_runtime_sec(int i_sock, int run_id);
+	void sort_waiting_runs();
+	void schedule_speculative_runs();
 	void init_slaves();
 	void close_slave(int i_sock);
 	void ping(int i_sock);
+	void schedule_ping(int i_sock, double delay_sec);
+	void check_overdue(const YamrTimer &timer);
+	void process_timers();
 	void report(std::string message,bool to_cout);	
+	// write the bytes sent and received by NetPackage since start_counts and the throughput to the rmr file
+	void report_throughput(const NetPackage::ByteCounts &start_counts, std::chrono::system_clock::time_point start_time);
 	string get_time_string();
 	void echo();
-	std::unordered_multimap<int, YamrModelRun>::iterator get_active_run_id(int socket);
-	std::unordered_multimap<int, YamrModelRun>::iterator get_zombie_run_id(int socket);
 };
 
 #endif /* RUNMANAGERYAMR_H */
\ No newline at end of file
@@ -24,43 +24,445 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm> 
+#include <cstring>
+#include "config_os.h"
 #include "RunStorage.h"
 #include "Serialization.h"
 #include "Transformable.h"
+#include "system_variables.h"
 #include <limits>
 
+#ifdef OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef OS_WIN
+#include <io.h>
+#include <fcntl.h>
+#endif
+
 using std::numeric_limits;
 
 using namespace std;
 
 const double RunStorage::no_data = -9999.0;
 
-RunStorage::RunStorage(const string &_filename) :filename(_filename), run_byte_size(0)
+const char RunStorage::format_magic[8] = "PESTRNS";
+
+RunStorage::RunStorage(const string &_filename) :filename(_filename), use_mmap(false),
+	map_fd(-1), map_ptr(nullptr), map_size(0), file_end(0), n_runs(0), commit_nruns(0), commit_msec(0),
+	format_version(0), obs_value_size(sizeof(double)), tile_nruns(0), new_obs_float32(false), new_tile_nruns(0),
+	new_legacy_format(false), nruns_pos(0), run_head_byte_size(0), tile_byte_size(0), n_pending(0), n_failed(0), n_complete(0),
+	n_canceled(0), run_byte_size(0)
+{
+}
+
+void RunStorage::set_use_mmap(bool _use_mmap)
+{
+	// memory mapped access is only supported on linux.  Other systems
+	// silently fall back to stream based access
+#ifdef OS_LINUX
+	use_mmap = _use_mmap;
+#else
+	use_mmap = false;
+#endif
+}
+
+void RunStorage::open_storage(bool truncate)
+{
+	close_storage();
+#ifdef OS_LINUX
+	if (use_mmap)
+	{
+		int flags = O_RDWR;
+		if (truncate) flags |= O_CREAT | O_TRUNC;
+		map_fd = open(filename.c_str(), flags, 0644);
+		if (map_fd < 0)
+		{
+			throw PestFileError(filename);
+		}
+		struct stat file_stat;
+		fstat(map_fd, &file_stat);
+		file_end = file_stat.st_size;
+		return;
+	}
+#endif
+	if (truncate)
+	{
+		// a file needs to exist before it can be opened it with read and write 
+		// permission.   So open it with write permission to crteate it, close 
+		// and then reopen it with read and write permisssion.
+		buf_stream.open(filename.c_str(), ios_base::out | ios_base::binary);
+		buf_stream.close();
+		buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary);
+	}
+	else
+	{
+		buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary | ios_base::ate);
+	}
+	assert(buf_stream.good() == true);
+	if (!buf_stream.good())
+	{
+		throw PestFileError(filename);
+	}
+}
+
+void RunStorage::close_storage()
+{
+	commit();
+	if (buf_stream.is_open())
+	{
+		buf_stream.close();
+	}
+#ifdef OS_LINUX
+	if (map_fd >= 0)
+	{
+		if (map_ptr != nullptr)
+		{
+			munmap(map_ptr, map_size);
+		}
+		// trim the file back to the bytes that have actually been written
+		if (ftruncate(map_fd, file_end) != 0)
+		{
+			cerr << "RunStorage: unable to trim storage file " << filename << endl;
+		}
+		::close(map_fd);
+	}
+#endif
+	map_fd = -1;
+	map_ptr = nullptr;
+	map_size = 0;
+	file_end = 0;
+}
+
+void RunStorage::reserve_map(std::streamoff size)
+{
+#ifdef OS_LINUX
+	if (size <= map_size) return;
+	// grow the file and the mapping in large chunks so appending runs does
+	// not require a remap for every new record
+	std::streamoff new_size = ((size + mmap_chunk_size - 1) / mmap_chunk_size) * mmap_chunk_size;
+	if (ftruncate(map_fd, new_size) != 0)
+	{
+		throw PestFileErrorAccess(filename, " (unable to grow memory mapped storage file)");
+	}
+	void *new_ptr;
+	if (map_ptr == nullptr)
+	{
+		new_ptr = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, map_fd, 0);
+	}
+	else
+	{
+		new_ptr = mremap(map_ptr, map_size, new_size, MREMAP_MAYMOVE);
+	}
+	if (new_ptr == MAP_FAILED)
+	{
+		map_ptr = nullptr;
+		map_size = 0;
+		throw PestFileErrorAccess(filename, " (unable to memory map storage file)");
+	}
+	map_ptr = static_cast<char*>(new_ptr);
+	map_size = new_size;
+#endif
+}
+
+void RunStorage::write_bytes(std::streamoff pos, const void *data, size_t n_bytes)
+{
+	if (map_fd >= 0)
+	{
+		std::streamoff end_pos = pos + std::streamoff(n_bytes);
+		reserve_map(end_pos);
+		memcpy(map_ptr + pos, data, n_bytes);
+		file_end = max(file_end, end_pos);
+	}
+	else
+	{
+		buf_stream.seekp(pos, ios_base::beg);
+		buf_stream.write(static_cast<const char*>(data), n_bytes);
+	}
+}
+
+void RunStorage::read_bytes(std::streamoff pos, void *data, size_t n_bytes)
 {
+	if (map_fd >= 0)
+	{
+		// mimic a stream read.  Bytes past the end of the file are left unchanged
+		std::streamoff n_avl = min(std::streamoff(n_bytes), file_end - pos);
+		if (n_avl > 0)
+		{
+			reserve_map(pos + n_avl);
+			memcpy(data, map_ptr + pos, n_avl);
+		}
+	}
+	else
+	{
+		buf_stream.seekg(pos, ios_base::beg);
+		buf_stream.read(static_cast<char*>(data), n_bytes);
+		if (!buf_stream.good())
+		{
+			buf_stream.clear();
+		}
+	}
+}
+
+void RunStorage::flush_bytes()
+{
+	// writes to the memory map are visible to the operating system as soon as
+	// they are made so only the stream needs to be flushed
+	if (buf_stream.is_open())
+	{
+		buf_stream.flush();
+	}
+}
+
+void RunStorage::flush()
+{
+	commit();
+	flush_bytes();
+#ifdef OS_LINUX
+	if (map_fd >= 0 && map_ptr != nullptr)
+	{
+		// release the mapping and trim the file so it can be read by other processes.
+		// The mapping will be recreated the next time the file is accessed
+		munmap(map_ptr, map_size);
+		map_ptr = nullptr;
+		map_size = 0;
+		if (ftruncate(map_fd, file_end) != 0)
+		{
+			throw PestFileErrorAccess(filename, " (unable to trim memory mapped storage file)");
+		}
+	}
+#endif
+}
+
+void RunStorage::set_group_commit(int _commit_nruns, int _commit_msec)
+{
+	commit();
+	commit_nruns = max(0, _commit_nruns);
+	commit_msec = max(0, _commit_msec);
+}
+
+void RunStorage::journal_run(int run_id, std::int8_t r_status, const char *par_data, const char *obs_data)
+{
+	auto found = journal_idx_map.find(run_id);
+	if (found == journal_idx_map.end())
+	{
+		if (journal.empty())
+		{
+			journal_start_time = chrono::steady_clock::now();
+		}
+		found = journal_idx_map.insert(make_pair(run_id, journal.size())).first;
+		journal.push_back(JournalRec());
+	}
+	JournalRec &rec = journal[found->second];
+	size_t n_obs_bytes = run_data_byte_size - run_par_byte_size;
+	rec.run_id = run_id;
+	rec.r_status = r_status;
+	// a later update without parameters keeps the parameters from an earlier update of the same run
+	if (par_data != nullptr || rec.data.empty())
+	{
+		rec.has_pars = (par_data != nullptr);
+		rec.data.clear();
+		if (par_data != nullptr)
+		{
+			rec.data.insert(rec.data.end(), par_data, par_data + run_par_byte_size);
+		}
+		rec.data.insert(rec.data.end(), obs_data, obs_data + n_obs_bytes);
+	}
+	else
+	{
+		copy_n(obs_data, n_obs_bytes, rec.data.end() - n_obs_bytes);
+	}
+	cache_run_status(run_id, r_status);
+	commit_if_due();
+}
+
+void RunStorage::commit_if_due()
+{
+	if (journal.empty()) return;
+	bool due = (commit_nruns > 0 && journal.size() >= size_t(commit_nruns));
+	if (!due && commit_msec > 0)
+	{
+		auto age = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - journal_start_time);
+		due = (age.count() >= commit_msec);
+	}
+	if (due)
+	{
+		commit();
+	}
+}
+
+void RunStorage::commit_run(int run_id)
+{
+	if (journal_idx_map.find(run_id) != journal_idx_map.end())
+	{
+		commit();
+	}
+}
+
+void RunStorage::commit()
+{
+	if (journal.empty()) return;
+	string jnl_filename = get_journal_filename();
+	// write the journal file with a record count of zero, sync it and then set the record count.
+	// A journal with a record count of zero is ignored on restart
+	{
+		ofstream f_jnl(jnl_filename.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+		std::int64_t n_rec = 0;
+		f_jnl.write((char*)&n_rec, sizeof(n_rec));
+		for (const auto &rec : journal)
+		{
+			f_jnl.write((char*)&rec.run_id, sizeof(rec.run_id));
+			f_jnl.write((char*)&rec.r_status, sizeof(rec.r_status));
+			f_jnl.write((char*)&rec.has_pars, sizeof(rec.has_pars));
+			f_jnl.write(rec.data.data(), rec.data.size());
+		}
+		if (!f_jnl.good())
+		{
+			throw PestFileErrorAccess(jnl_filename, " (unable to write run storage journal)");
+		}
+	}
+	sync_file(jnl_filename);
+	{
+		fstream f_jnl(jnl_filename.c_str(), ios_base::out | ios_base::in | ios_base::binary);
+		std::int64_t n_rec = journal.size();
+		f_jnl.write((char*)&n_rec, sizeof(n_rec));
+		if (!f_jnl.good())
+		{
+			throw PestFileErrorAccess(jnl_filename, " (unable to write run storage journal)");
+		}
+	}
+	sync_file(jnl_filename);
+	// the journal is now safe on disk so it can be applied to the storage file
+	for (const auto &rec : journal)
+	{
+		apply_journal_rec(rec);
+	}
+	sync_storage();
+	remove(jnl_filename.c_str());
+	journal.clear();
+	journal_idx_map.clear();
+}
+
+void RunStorage::apply_journal_rec(const JournalRec &rec)
+{
+	const double *data = reinterpret_cast<const double*>(rec.data.data());
+	if (rec.has_pars)
+	{
+		write_run_record(rec.run_id, rec.r_status, data, data + par_names.size());
+	}
+	else
+	{
+		write_run_record(rec.run_id, rec.r_status, nullptr, data);
+	}
+}
+
+void RunStorage::replay_journal()
+{
+	string jnl_filename = get_journal_filename();
+	ifstream f_jnl(jnl_filename.c_str(), ios_base::in | ios_base::binary);
+	if (!f_jnl.is_open()) return;
+	std::int64_t n_rec = 0;
+	f_jnl.read((char*)&n_rec, sizeof(n_rec));
+	size_t n_obs_bytes = run_data_byte_size - run_par_byte_size;
+	JournalRec rec;
+	for (std::int64_t i_rec = 0; i_rec < n_rec && f_jnl.good(); ++i_rec)
+	{
+		f_jnl.read((char*)&rec.run_id, sizeof(rec.run_id));
+		f_jnl.read((char*)&rec.r_status, sizeof(rec.r_status));
+		f_jnl.read((char*)&rec.has_pars, sizeof(rec.has_pars));
+		rec.data.resize(rec.has_pars ? run_data_byte_size : n_obs_bytes);
+		f_jnl.read(rec.data.data(), rec.data.size());
+		if (!f_jnl.good() || rec.run_id < 0 || rec.run_id >= n_runs)
+		{
+			throw PestFileErrorAccess(jnl_filename, " (run storage journal is corrupt)");
+		}
+		apply_journal_rec(rec);
+	}
+	f_jnl.close();
+	sync_storage();
+	remove(jnl_filename.c_str());
+}
+
+void RunStorage::sync_storage()
+{
+	flush_bytes();
+#ifdef OS_LINUX
+	if (map_fd >= 0)
+	{
+		if ((map_ptr != nullptr && msync(map_ptr, map_size, MS_SYNC) != 0) || fsync(map_fd) != 0)
+		{
+			throw PestFileErrorAccess(filename, " (unable to sync memory mapped storage file)");
+		}
+		return;
+	}
+#endif
+	sync_file(filename);
+}
+
+void RunStorage::sync_file(const string &_filename)
+{
+	// force data written to _filename out of the operating system cache.  On linux
+	// this can be done through any file descriptor referencing the file.  On windows
+	// _commit (FlushFileBuffers) needs a handle opened for writing.
+	bool ok = false;
+#ifdef OS_LINUX
+	int fd = open(_filename.c_str(), O_RDONLY);
+	if (fd >= 0)
+	{
+		ok = (fsync(fd) == 0);
+		::close(fd);
+	}
+#endif
+#ifdef OS_WIN
+	int fd = _open(_filename.c_str(), _O_WRONLY | _O_BINARY);
+	if (fd >= 0)
+	{
+		ok = (_commit(fd) == 0);
+		_close(fd);
+	}
+#endif
+	if (!ok)
+	{
+		throw PestFileErrorAccess(_filename, " (unable to sync file to disk)");
+	}
+}
+
+void RunStorage::set_format(bool obs_float32, int _tile_nruns)
+{
+	new_obs_float32 = obs_float32;
+	new_tile_nruns = max(0, _tile_nruns);
 }
 
 void RunStorage::reset(const vector<string> &_par_names, const vector<string> &_obs_names, const string &_filename)
 {
+	// pending runs belong to the current file and must be committed before it is replaced
+	commit();
 	par_names = _par_names;
 	obs_names = _obs_names;
-	// a file needs to exist before it can be opened it with read and write 
-	// permission.   So open it with write permission to crteate it, close 
-	// and then reopen it with read and write permisssion.
 	if (_filename.size() > 0)
 	{
 		filename = _filename;
 	}
-	if (buf_stream.is_open())
+	// a journal left behind by an earlier run belongs to the file that is being replaced and must not be
+	// replayed into the new one on restart
+	remove(get_journal_filename().c_str());
+	open_storage(true);
+	// new files are written with the current format unless the legacy format was requested.  Version 1 is only
+	// written when restarting from a version 1 file
+	if (new_legacy_format)
 	{
-		buf_stream.close();
+		format_version = 0;
+		obs_value_size = sizeof(double);
+		tile_nruns = 0;
 	}
-	buf_stream.open(filename.c_str(), ios_base::out |  ios_base::binary);
-        buf_stream.close();
-	buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary);
-	assert(buf_stream.good() == true);
-	if (!buf_stream.good())
+	else
 	{
-		throw PestFileError(filename);
+		format_version = cur_format_version;
+		obs_value_size = new_obs_float32 ? sizeof(float) : sizeof(double);
+		tile_nruns = new_tile_nruns;
 	}
 	// calculate the number of bytes required to store parameter names
 	vector<char> serial_pnames(Serialization::serialize(par_names));
@@ -72,133 +474,370 @@ void RunStorage::reset(const vector<string> &_par_names, const vector<string> &_
 	run_par_byte_size = par_names.size() * sizeof(double);
 	run_data_byte_size = run_par_byte_size + obs_names.size() * sizeof(double);
 	//compute the amount of memeory required to store a single model run
-	// run_byte_size = size of run_status + size of info_txt + size of info_value + size of parameter oand observation data
-	run_byte_size =  sizeof(std::int8_t) + 41*sizeof(char) * sizeof(double) + run_data_byte_size;
+	// run_byte_size = size of run header (run_status, info_txt, info_value, parameter data and checksum)
+	//                 + size of observation data
+	set_record_layout();
+	if (format_version == 0)
+	{
+		// legacy files keep the padded run_size of the original format so external readers can step
+		// through the records
+		run_byte_size = sizeof(std::int8_t) + info_txt_length * sizeof(char) * sizeof(double) + run_data_byte_size;
+	}
+	else
+	{
+		run_byte_size = run_head_byte_size + obs_names.size() * obs_value_size;
+	}
 	std::int64_t  run_size_64 = run_byte_size;
-	beg_run0 = 4 * sizeof(std::int64_t) + serial_pnames.size() + serial_onames.size();
-	std::int64_t n_runs_64=0;
+	n_runs = 0;
+	clear_status_index();
 	// write header to file
-	buf_stream.seekp(0, ios_base::beg);
-	buf_stream.write((char*) &n_runs_64, sizeof(n_runs_64));
-	buf_stream.write((char*) &run_size_64, sizeof(run_size_64));
-	buf_stream.write((char*) &p_name_size_64, sizeof(p_name_size_64));
-	buf_stream.write((char*) &o_name_size_64, sizeof(o_name_size_64));
-	buf_stream.write(serial_pnames.data(), serial_pnames.size());
-	buf_stream.write(serial_onames.data(), serial_onames.size());
-	//add flag for double buffering
-	std::int8_t buf_status = 0;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	std::streamoff pos = 0;
+	if (format_version > 0)
+	{
+		std::int32_t version_32 = format_version;
+		std::int32_t obs_size_32 = obs_value_size;
+		std::int64_t tile_nruns_64 = tile_nruns;
+		std::int32_t info_len_32 = info_txt_length;
+		std::int32_t rec_flags_32 = rec_flag_crc32;
+		write_bytes(pos, format_magic, sizeof(format_magic));
+		pos += sizeof(format_magic);
+		write_bytes(pos, &version_32, sizeof(version_32));
+		pos += sizeof(version_32);
+		write_bytes(pos, &obs_size_32, sizeof(obs_size_32));
+		pos += sizeof(obs_size_32);
+		write_bytes(pos, &tile_nruns_64, sizeof(tile_nruns_64));
+		pos += sizeof(tile_nruns_64);
+		write_bytes(pos, &info_len_32, sizeof(info_len_32));
+		pos += sizeof(info_len_32);
+		write_bytes(pos, &rec_flags_32, sizeof(rec_flags_32));
+		pos += sizeof(rec_flags_32);
+	}
+	nruns_pos = pos;
+	write_bytes(pos, &n_runs, sizeof(n_runs));
+	pos += sizeof(n_runs);
+	write_bytes(pos, &run_size_64, sizeof(run_size_64));
+	pos += sizeof(run_size_64);
+	write_bytes(pos, &p_name_size_64, sizeof(p_name_size_64));
+	pos += sizeof(p_name_size_64);
+	write_bytes(pos, &o_name_size_64, sizeof(o_name_size_64));
+	pos += sizeof(o_name_size_64);
+	write_bytes(pos, serial_pnames.data(), serial_pnames.size());
+	pos += serial_pnames.size();
+	write_bytes(pos, serial_onames.data(), serial_onames.size());
+	pos += serial_onames.size();
+	beg_run0 = pos;
+	set_record_layout();
+	if (!has_run_crc())
+	{
+		//add flag for double buffering
+		std::int8_t buf_status = 0;
+		write_bytes(get_buffer_pos(), &buf_status, sizeof(buf_status));
+	}
+	flush_bytes();
+}
+
+bool RunStorage::has_run_crc() const
+{
+	return format_version >= 2;
+}
+
+void RunStorage::set_record_layout()
+{
+	run_head_byte_size = sizeof(std::int8_t) + sizeof(char)*info_txt_length + sizeof(double) + run_par_byte_size;
+	if (has_run_crc())
+	{
+		run_head_byte_size += sizeof(std::uint32_t);
+	}
+	tile_byte_size = tile_nruns * (run_head_byte_size + obs_names.size() * obs_value_size);
 }
 
 
 void RunStorage::init_restart(const std::string &_filename)
 {
+	commit();
 	filename = _filename;
 	par_names.clear();
 	obs_names.clear();
 
-	if (buf_stream.is_open())
-	{
-		buf_stream.close();
-	}
-
-	buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary | ios_base::ate);
-	assert(buf_stream.good() == true);
-	if (!buf_stream.good())
+	open_storage(false);
+	// read header
+	std::streamoff pos = 0;
+	char magic[sizeof(format_magic)] = {};
+	read_bytes(pos, magic, sizeof(magic));
+	format_version = 0;
+	obs_value_size = sizeof(double);
+	tile_nruns = 0;
+	if (memcmp(magic, format_magic, sizeof(format_magic)) == 0)
 	{
-		throw PestFileError(filename);
+		pos += sizeof(magic);
+		std::int32_t version_32 = 0;
+		read_bytes(pos, &version_32, sizeof(version_32));
+		pos += sizeof(version_32);
+		std::int32_t obs_size_32 = 0;
+		read_bytes(pos, &obs_size_32, sizeof(obs_size_32));
+		pos += sizeof(obs_size_32);
+		std::int64_t tile_nruns_64 = 0;
+		read_bytes(pos, &tile_nruns_64, sizeof(tile_nruns_64));
+		pos += sizeof(tile_nruns_64);
+		if (version_32 < 1 || version_32 > cur_format_version || (obs_size_32 != sizeof(float) && obs_size_32 != sizeof(double))
+			|| tile_nruns_64 < 0)
+		{
+			throw PestFileErrorAccess(filename, " (unsupported run storage file format)");
+		}
+		format_version = version_32;
+		obs_value_size = obs_size_32;
+		tile_nruns = tile_nruns_64;
+		if (format_version >= 2)
+		{
+			std::int32_t info_len_32 = 0;
+			read_bytes(pos, &info_len_32, sizeof(info_len_32));
+			pos += sizeof(info_len_32);
+			std::int32_t rec_flags_32 = 0;
+			read_bytes(pos, &rec_flags_32, sizeof(rec_flags_32));
+			pos += sizeof(rec_flags_32);
+			if (info_len_32 != info_txt_length || rec_flags_32 != rec_flag_crc32)
+			{
+				throw PestFileErrorAccess(filename, " (unsupported run storage record layout)");
+			}
+		}
 	}
-	// read header
-	buf_stream.seekg(0, ios_base::beg);
-
-	std::int64_t n_runs_64;
-	buf_stream.read((char*) &n_runs_64, sizeof(n_runs_64));
-	
-	std::int64_t  run_size_64;
-	buf_stream.read((char*) &run_size_64, sizeof(run_size_64));
+	nruns_pos = pos;
+	std::int64_t n_runs_64 = 0;
+	read_bytes(pos, &n_runs_64, sizeof(n_runs_64));
+	pos += sizeof(n_runs_64);
+	n_runs = n_runs_64;
+
+	std::int64_t  run_size_64 = 0;
+	read_bytes(pos, &run_size_64, sizeof(run_size_64));
+	pos += sizeof(run_size_64);
 	run_byte_size = run_size_64;
 
-	std::int64_t p_name_size_64;
-	buf_stream.read((char*) &p_name_size_64, sizeof(p_name_size_64));
+	std::int64_t p_name_size_64 = 0;
+	read_bytes(pos, &p_name_size_64, sizeof(p_name_size_64));
+	pos += sizeof(p_name_size_64);
 
-	std::int64_t o_name_size_64;
-	buf_stream.read((char*) &o_name_size_64, sizeof(o_name_size_64));
+	std::int64_t o_name_size_64 = 0;
+	read_bytes(pos, &o_name_size_64, sizeof(o_name_size_64));
+	pos += sizeof(o_name_size_64);
 
 	vector<char> serial_pnames;
 	serial_pnames.resize(p_name_size_64);
-	buf_stream.read(serial_pnames.data(), serial_pnames.size());
+	read_bytes(pos, serial_pnames.data(), serial_pnames.size());
+	pos += serial_pnames.size();
 	Serialization::unserialize(serial_pnames, par_names);
 
 	vector<char> serial_onames;
 	serial_onames.resize(o_name_size_64);
-	buf_stream.read(serial_onames.data(), serial_onames.size());
+	read_bytes(pos, serial_onames.data(), serial_onames.size());
+	pos += serial_onames.size();
 	Serialization::unserialize(serial_onames, obs_names);
 
-	beg_run0 = 4 * sizeof(std::int64_t) + serial_pnames.size() + serial_onames.size();
+	beg_run0 = pos;
 	run_par_byte_size = par_names.size() * sizeof(double);
 	run_data_byte_size = run_par_byte_size + obs_names.size() * sizeof(double);
+	set_record_layout();
+	if (format_version > 0 && run_byte_size != run_head_byte_size + std::streamoff(obs_names.size()) * obs_value_size)
+	{
+		throw PestFileErrorAccess(filename, " (run storage record size does not match the header)");
+	}
 
-	//check buffer to see if a write was improperly terminated
+	//check buffer to see if a write was improperly terminated.  Files with checksums do not use the buffer
 	std::int8_t r_status = 0;
 	std::int8_t buf_status = 0;
 	std::int32_t buf_run_id = 0;
 
-	int end_of_runs = get_nruns();
-	buf_stream.seekg(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
+	streamoff buf_pos = get_buffer_pos();
+	pos = buf_pos;
+	if (!has_run_crc())
+	{
+		read_bytes(pos, &buf_status, sizeof(buf_status));
+	}
+	pos += sizeof(buf_status);
 	if (buf_status == 1 || buf_status == 2)
 	{
-		buf_stream.read(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-		buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
+		read_bytes(pos, &buf_run_id, sizeof(buf_run_id));
+		pos += sizeof(buf_run_id);
+		read_bytes(pos, &r_status, sizeof(r_status));
+		pos += sizeof(r_status);
 		check_rec_id(buf_run_id);
 		size_t n_par = par_names.size();
 		size_t n_obs = obs_names.size();
 		vector<double> pars_vec(n_par, Parameters::no_data);
 		vector<double> obs_vec(n_obs, Observations::no_data);
 
-		buf_stream.read(reinterpret_cast<char*>(pars_vec.data()), n_par * sizeof(double));
-		buf_stream.read(reinterpret_cast<char*>(obs_vec.data()), n_obs * sizeof(double));
+		read_bytes(pos, pars_vec.data(), n_par * sizeof(double));
+		pos += n_par * sizeof(double);
+		read_bytes(pos, obs_vec.data(), n_obs * sizeof(double));
 
 		//write data
-		buf_stream.seekp(get_stream_pos(buf_run_id), ios_base::beg);
-		buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-		//skip over info_txt and info_value fields
-		buf_stream.seekp(sizeof(char)*info_txt_length + sizeof(double), ios_base::cur);
-		buf_stream.write(reinterpret_cast<char*>(pars_vec.data()), pars_vec.size() * sizeof(double));
-		buf_stream.write(reinterpret_cast<char*>(obs_vec.data()), obs_vec.size() * sizeof(double));
-		buf_stream.flush();
+		write_run_record(buf_run_id, r_status, pars_vec.data(), obs_vec.data());
+		flush_bytes();
 		//reset flag for buffer at end of file to 0 to signal it is no longer relavent
 		buf_status = 0;
-		buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-		buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-		buf_stream.flush();
+		write_bytes(buf_pos, &buf_status, sizeof(buf_status));
+		flush_bytes();
+	}
+	// apply any complete journal left behind by a group commit that was interrupted
+	replay_journal();
+	// rebuild the in memory run status index with a single sequential pass through the file.
+	// In the tiled layout the run headers of each tile are contiguous so the file is read one tile at a time.
+	// The checksums of completed runs are verified at the same time.  A completed run with an invalid
+	// checksum was only partially written and is reset to pending so it will be rerun
+	clear_status_index();
+	streamoff rec_stride = (tile_nruns > 0) ? run_head_byte_size : run_byte_size;
+	int max_block_runs = (tile_nruns > 0) ? tile_nruns : max(streamoff(1), max_block_byte_size / run_byte_size);
+	streamoff par_offset = sizeof(std::int8_t) + sizeof(char)*info_txt_length + sizeof(double);
+	size_t n_obs = obs_names.size();
+	vector<char> block;
+	vector<char> obs_block;
+	int n_torn = 0;
+	for (int i_beg = 0; i_beg < n_runs; i_beg += max_block_runs)
+	{
+		int n_block = min(std::int64_t(max_block_runs), n_runs - i_beg);
+		block.assign(n_block * rec_stride, '\0');
+		read_bytes(get_stream_pos(i_beg), block.data(), block.size());
+		if (has_run_crc() && tile_nruns > 0)
+		{
+			obs_block.assign(n_obs * tile_nruns * obs_value_size, '\0');
+			read_bytes(get_obs_pos(i_beg), obs_block.data(), obs_block.size());
+		}
+		for (int i = 0; i < n_block; ++i)
+		{
+			const char *rec = block.data() + i * rec_stride;
+			std::int8_t r_status = rec[0];
+			if (has_run_crc() && r_status > 0)
+			{
+				const char *obs_data = rec + run_head_byte_size;
+				size_t obs_stride = 1;
+				if (tile_nruns > 0)
+				{
+					obs_data = obs_block.data() + i * obs_value_size;
+					obs_stride = tile_nruns;
+				}
+				std::uint32_t crc;
+				memcpy(&crc, rec + par_offset + run_par_byte_size, sizeof(crc));
+				if (crc != calc_run_crc(rec + par_offset, obs_data, obs_stride))
+				{
+					r_status = 0;
+					write_bytes(get_stream_pos(i_beg + i), &r_status, sizeof(r_status));
+					++n_torn;
+				}
+			}
+			append_status(r_status);
+		}
 	}
+	if (n_torn > 0)
+	{
+		flush_bytes();
+		cerr << "RunStorage: " << n_torn << " incomplete run records in " << filename << " have been reset to pending" << endl;
+	}
+}
+
+std::uint32_t RunStorage::crc32(std::uint32_t crc, const char *data, size_t n_bytes)
+{
+	// standard CRC-32 (as used by zlib and png) computed one byte at a time with a lookup table
+	static const vector<std::uint32_t> table = []() {
+		vector<std::uint32_t> t(256);
+		for (std::uint32_t i = 0; i < 256; ++i)
+		{
+			std::uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			t[i] = c;
+		}
+		return t;
+	}();
+	crc = ~crc;
+	for (size_t i = 0; i < n_bytes; ++i)
+	{
+		crc = table[(crc ^ std::uint8_t(data[i])) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+std::uint32_t RunStorage::calc_run_crc(const char *par_data, const char *obs_data, size_t obs_stride) const
+{
+	// the checksum covers the stored parameter and observation values.  It does not include the run status
+	// so the status can be changed without rewriting the checksum
+	std::uint32_t crc = crc32(0, par_data, run_par_byte_size);
+	size_t n_obs = obs_names.size();
+	if (obs_stride == 1)
+	{
+		return crc32(crc, obs_data, n_obs * obs_value_size);
+	}
+	for (size_t i = 0; i < n_obs; ++i)
+	{
+		crc = crc32(crc, obs_data + i * obs_stride * obs_value_size, obs_value_size);
+	}
+	return crc;
+}
+
+void RunStorage::clear_status_index()
+{
+	run_status_vec.clear();
+	unfinished_run_ids.clear();
+	n_pending = 0;
+	n_failed = 0;
+	n_complete = 0;
+	n_canceled = 0;
+}
+
+void RunStorage::count_status(int run_id, std::int8_t r_status, int inc)
+{
+	if (r_status == 0)
+	{
+		n_pending += inc;
+	}
+	else if (r_status > 0)
+	{
+		n_complete += inc;
+	}
+	else if (r_status <= -100)
+	{
+		n_canceled += inc;
+	}
+	else
+	{
+		n_failed += inc;
+	}
+	if (r_status <= 0 && r_status > -100)
+	{
+		if (inc > 0)
+		{
+			unfinished_run_ids.insert(unfinished_run_ids.end(), run_id);
+		}
+		else
+		{
+			unfinished_run_ids.erase(run_id);
+		}
+	}
+}
+
+void RunStorage::append_status(std::int8_t r_status)
+{
+	run_status_vec.push_back(r_status);
+	count_status(run_status_vec.size() - 1, r_status, 1);
+}
+
+void RunStorage::cache_run_status(int run_id, std::int8_t r_status)
+{
+	count_status(run_id, run_status_vec[run_id], -1);
+	run_status_vec[run_id] = r_status;
+	count_status(run_id, r_status, 1);
 }
 
 int RunStorage::get_nruns()
 {
-	streamoff init_pos = buf_stream.tellg();
-	buf_stream.seekg(0, ios_base::beg);
-	std::int64_t n_runs_64;
-	buf_stream.read((char*) &n_runs_64, sizeof(n_runs_64));
-	int n_runs = n_runs_64;
-	buf_stream.seekg(init_pos);
 	return n_runs;
 }
 
 int RunStorage::increment_nruns()
 {
-	buf_stream.seekg(0, ios_base::beg);
-	std::int64_t n_runs_64;
-	buf_stream.read((char*) &n_runs_64, sizeof(n_runs_64));
-	++n_runs_64;
-	buf_stream.seekp(0, ios_base::beg);
-	buf_stream.write((char*) &n_runs_64, sizeof(n_runs_64));
-	int n_runs = n_runs_64;
-	buf_stream.flush();
+	++n_runs;
+	write_bytes(nruns_pos, &n_runs, sizeof(n_runs));
+	flush_bytes();
 	return n_runs;
 }
 const std::vector<string>& RunStorage::get_par_name_vec()const
@@ -213,51 +852,195 @@ const std::vector<string>& RunStorage::get_obs_name_vec()const
 
 streamoff RunStorage::get_stream_pos(int run_id)
 {
+	if (tile_nruns > 0)
+	{
+		return beg_run0 + (run_id / tile_nruns) * tile_byte_size + (run_id % tile_nruns) * run_head_byte_size;
+	}
 	streamoff pos = beg_run0 + run_byte_size*run_id;
 	return pos;
 }
 
- int RunStorage::add_run(const vector<double> &model_pars, const string &info_txt, double info_value)
- {
-	std::int8_t r_status = 0;
-	int run_id = increment_nruns() - 1;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-	copy_n(info_txt.begin(), min(info_txt.size(), size_t(info_txt_length)-1) , info_txt_buf.begin());
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(reinterpret_cast<char*>(info_txt_buf.data()), sizeof(char)*info_txt_buf.size());
-	buf_stream.write(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.write(reinterpret_cast<const char*>(&model_pars[0]), model_pars.size()*sizeof(double));
-	//add flag for double buffering
-	std::int8_t buf_status = 0;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
-	return run_id;
- }
+streamoff RunStorage::get_obs_pos(int run_id)
+{
+	if (tile_nruns > 0)
+	{
+		return beg_run0 + (run_id / tile_nruns) * tile_byte_size + tile_nruns * run_head_byte_size
+			+ (run_id % tile_nruns) * obs_value_size;
+	}
+	return get_stream_pos(run_id) + run_head_byte_size;
+}
+
+streamoff RunStorage::get_buffer_pos()
+{
+	// the double buffer follows the last run.  In the tiled layout this is the end of the last tile
+	if (tile_nruns > 0)
+	{
+		return beg_run0 + ((n_runs + tile_nruns - 1) / tile_nruns) * tile_byte_size;
+	}
+	return get_stream_pos(n_runs);
+}
+
+void RunStorage::encode_obs(const double *obs_data, size_t n_obs, char *buf) const
+{
+	if (obs_value_size == sizeof(double))
+	{
+		memcpy(buf, obs_data, n_obs * sizeof(double));
+		return;
+	}
+	for (size_t i = 0; i < n_obs; ++i)
+	{
+		float val = float(obs_data[i]);
+		memcpy(buf + i * sizeof(float), &val, sizeof(float));
+	}
+}
 
- int RunStorage::add_run(const Eigen::VectorXd &model_pars, const string &info_txt, double info_value)
- {
+void RunStorage::decode_obs(const char *buf, size_t n_obs, size_t stride, double *obs_data) const
+{
+	// stride is the number of stored values between consecutive observations of the same run
+	size_t stride_bytes = stride * obs_value_size;
+	if (obs_value_size == sizeof(double))
+	{
+		if (stride == 1)
+		{
+			memcpy(obs_data, buf, n_obs * sizeof(double));
+			return;
+		}
+		for (size_t i = 0; i < n_obs; ++i)
+		{
+			memcpy(obs_data + i, buf + i * stride_bytes, sizeof(double));
+		}
+		return;
+	}
+	float val;
+	for (size_t i = 0; i < n_obs; ++i)
+	{
+		memcpy(&val, buf + i * stride_bytes, sizeof(float));
+		obs_data[i] = val;
+	}
+}
+
+void RunStorage::write_run_obs(int run_id, const char *obs_buf)
+{
+	// obs_buf contains the observation values in their stored encoding
+	size_t n_obs = obs_names.size();
+	streamoff pos = get_obs_pos(run_id);
+	if (tile_nruns == 0)
+	{
+		write_bytes(pos, obs_buf, n_obs * obs_value_size);
+		return;
+	}
+	// observation-major tile: consecutive observations of a run are tile_nruns values apart
+	streamoff stride_bytes = tile_nruns * obs_value_size;
+	for (size_t i = 0; i < n_obs; ++i)
+	{
+		write_bytes(pos + i * stride_bytes, obs_buf + i * obs_value_size, obs_value_size);
+	}
+}
+
+void RunStorage::read_run_obs(int run_id, double *obs_data, size_t n_obs)
+{
+	streamoff pos = get_obs_pos(run_id);
+	if (tile_nruns == 0 && obs_value_size == sizeof(double))
+	{
+		read_bytes(pos, obs_data, n_obs * sizeof(double));
+		return;
+	}
+	vector<char> buf(n_obs * obs_value_size, '\0');
+	if (tile_nruns == 0)
+	{
+		read_bytes(pos, buf.data(), buf.size());
+	}
+	else
+	{
+		streamoff stride_bytes = tile_nruns * obs_value_size;
+		for (size_t i = 0; i < n_obs; ++i)
+		{
+			read_bytes(pos + i * stride_bytes, buf.data() + i * obs_value_size, obs_value_size);
+		}
+	}
+	decode_obs(buf.data(), n_obs, 1, obs_data);
+}
+
+void RunStorage::write_run_record(int run_id, std::int8_t r_status, const double *par_data, const double *obs_data)
+{
+	size_t n_obs = obs_names.size();
+	const char *obs_buf = reinterpret_cast<const char*>(obs_data);
+	vector<char> obs_encoded;
+	if (obs_value_size != sizeof(double))
+	{
+		obs_encoded.resize(n_obs * obs_value_size);
+		encode_obs(obs_data, n_obs, obs_encoded.data());
+		obs_buf = obs_encoded.data();
+	}
+	streamoff pos = get_stream_pos(run_id);
+	//skip over info_txt and info_value fields
+	streamoff par_pos = pos + sizeof(r_status) + sizeof(char)*info_txt_length + sizeof(double);
+	if (!has_run_crc())
+	{
+		write_bytes(pos, &r_status, sizeof(r_status));
+		if (par_data != nullptr)
+		{
+			write_bytes(par_pos, par_data, run_par_byte_size);
+		}
+		write_run_obs(run_id, obs_buf);
+		return;
+	}
+	// write the data and its checksum before the status so an interrupted write either leaves the
+	// run pending or is detected by the checksum on restart
+	vector<double> par_buf;
+	if (par_data == nullptr)
+	{
+		par_buf.resize(par_names.size());
+		read_bytes(par_pos, par_buf.data(), run_par_byte_size);
+		par_data = par_buf.data();
+	}
+	else
+	{
+		write_bytes(par_pos, par_data, run_par_byte_size);
+	}
+	write_run_obs(run_id, obs_buf);
+	std::uint32_t crc = calc_run_crc(reinterpret_cast<const char*>(par_data), obs_buf, 1);
+	write_bytes(par_pos + run_par_byte_size, &crc, sizeof(crc));
+	write_bytes(pos, &r_status, sizeof(r_status));
+}
+
+int RunStorage::add_run_native(const double *model_pars, size_t npars, const string &info_txt, double info_value)
+{
 	std::int8_t r_status = 0;
-	int run_id = increment_nruns() - 1;
+	int run_id = n_runs;
 	vector<char> info_txt_buf;
 	info_txt_buf.resize(info_txt_length, '\0');
 	copy_n(info_txt.begin(), min(info_txt.size(), size_t(info_txt_length)-1) , info_txt_buf.begin());
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(reinterpret_cast<char*>(info_txt_buf.data()), sizeof(char)*info_txt_buf.size());
-	buf_stream.write(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.write(reinterpret_cast<const char*>(&model_pars(0)), model_pars.size()*sizeof(model_pars(0)));
-	//add flag for double buffering
-	std::int8_t buf_status = 0;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	streamoff pos = get_stream_pos(run_id);
+	write_bytes(pos, &r_status, sizeof(r_status));
+	pos += sizeof(r_status);
+	write_bytes(pos, info_txt_buf.data(), sizeof(char)*info_txt_buf.size());
+	pos += sizeof(char)*info_txt_buf.size();
+	write_bytes(pos, &info_value, sizeof(double));
+	pos += sizeof(double);
+	write_bytes(pos, model_pars, npars*sizeof(double));
+	// the run is only counted once its record has been written
+	increment_nruns();
+	append_status(r_status);
+	if (!has_run_crc())
+	{
+		//add flag for double buffering
+		std::int8_t buf_status = 0;
+		write_bytes(get_buffer_pos(), &buf_status, sizeof(buf_status));
+	}
+	flush_bytes();
 	return run_id;
- }
+}
+
+int RunStorage::add_run(const vector<double> &model_pars, const string &info_txt, double info_value)
+{
+	return add_run_native(model_pars.data(), model_pars.size(), info_txt, info_value);
+}
+
+int RunStorage::add_run(const Eigen::VectorXd &model_pars, const string &info_txt, double info_value)
+{
+	return add_run_native(model_pars.data(), model_pars.size(), info_txt, info_value);
+}
 
 
 int RunStorage::add_run(const Parameters &pars, const string &info_txt, double info_value)
@@ -267,6 +1050,128 @@ int RunStorage::add_run(const Parameters &pars, const string &info_txt, double i
 	return run_id;
 }
 
+vector<int> RunStorage::add_runs(const Eigen::MatrixXd &model_pars, const vector<string> &info_txt_vec, const vector<double> &info_value_vec)
+{
+	size_t n_new = model_pars.rows();
+	size_t n_par = par_names.size();
+	if (model_pars.cols() != static_cast<Eigen::MatrixXd::Index>(n_par))
+	{
+		throw(PestIndexError("RunStorage::add_runs: parameter dimension in incorrect"));
+	}
+	if (!info_txt_vec.empty() && info_txt_vec.size() != n_new)
+	{
+		throw(PestIndexError("RunStorage::add_runs: info_txt_vec dimension in incorrect"));
+	}
+	if (!info_value_vec.empty() && info_value_vec.size() != n_new)
+	{
+		throw(PestIndexError("RunStorage::add_runs: info_value_vec dimension in incorrect"));
+	}
+	vector<int> run_id_vec;
+	if (n_new == 0) return run_id_vec;
+
+	// build the new records in memory so they can be written as a single block.
+	// Unused bytes (observations and padding) are zero, matching what add_run leaves in the file.
+	// In the tiled layout only the run headers are built and they are written one tile at a time
+	streamoff rec_stride = (tile_nruns > 0) ? run_head_byte_size : run_byte_size;
+	vector<char> block(n_new * rec_stride, '\0');
+	for (size_t i = 0; i < n_new; ++i)
+	{
+		char *rec = block.data() + i * rec_stride;
+		// run_status is 0 so the first byte is left unchanged
+		char *info_txt = rec + sizeof(std::int8_t);
+		if (!info_txt_vec.empty())
+		{
+			const string &i_txt = info_txt_vec[i];
+			copy_n(i_txt.begin(), min(i_txt.size(), size_t(info_txt_length) - 1), info_txt);
+		}
+		double info_value = info_value_vec.empty() ? no_data : info_value_vec[i];
+		memcpy(info_txt + info_txt_length, &info_value, sizeof(double));
+		double *pars = reinterpret_cast<double*>(info_txt + info_txt_length + sizeof(double));
+		for (size_t j = 0; j < n_par; ++j)
+		{
+			double val = model_pars(i, j);
+			memcpy(pars + j, &val, sizeof(double));
+		}
+	}
+	int run_id_0 = n_runs;
+	size_t i_beg = 0;
+	while (i_beg < n_new)
+	{
+		size_t i_end = n_new;
+		if (tile_nruns > 0)
+		{
+			i_end = min(n_new, size_t(tile_nruns - (run_id_0 + i_beg) % tile_nruns) + i_beg);
+		}
+		write_bytes(get_stream_pos(run_id_0 + i_beg), block.data() + i_beg * rec_stride, (i_end - i_beg) * rec_stride);
+		i_beg = i_end;
+	}
+	n_runs += n_new;
+	for (size_t i = 0; i < n_new; ++i)
+	{
+		append_status(0);
+	}
+	write_bytes(nruns_pos, &n_runs, sizeof(n_runs));
+	if (!has_run_crc())
+	{
+		//add flag for double buffering
+		std::int8_t buf_status = 0;
+		write_bytes(get_buffer_pos(), &buf_status, sizeof(buf_status));
+	}
+	flush_bytes();
+	for (size_t i = 0; i < n_new; ++i)
+	{
+		run_id_vec.push_back(run_id_0 + i);
+	}
+	return run_id_vec;
+}
+
+void RunStorage::store_run(int run_id, std::int8_t r_status, const double *par_data, const double *obs_data, std::int8_t buf_flag)
+{
+	if (group_commit_enabled())
+	{
+		journal_run(run_id, r_status, (const char*)par_data, (const char*)obs_data);
+		return;
+	}
+	if (has_run_crc())
+	{
+		// the record checksum replaces the double buffer
+		write_run_record(run_id, r_status, par_data, obs_data);
+		flush_bytes();
+		cache_run_status(run_id, r_status);
+		return;
+	}
+	size_t n_obs = obs_names.size();
+	//write data to buffer at end of file and set buffer flag to buf_flag
+	std::int8_t buf_status = 0;
+	std::int32_t buf_run_id = run_id;
+	streamoff buf_pos = get_buffer_pos();
+	streamoff pos = buf_pos;
+	write_bytes(pos, &buf_status, sizeof(buf_status));
+	pos += sizeof(buf_status);
+	write_bytes(pos, &buf_run_id, sizeof(buf_run_id));
+	pos += sizeof(buf_run_id);
+	write_bytes(pos, &r_status, sizeof(r_status));
+	pos += sizeof(r_status);
+	//the parameter section is skipped when only the observations are being updated
+	if (par_data != nullptr)
+	{
+		write_bytes(pos, par_data, run_par_byte_size);
+	}
+	pos += run_par_byte_size;
+	write_bytes(pos, obs_data, n_obs * sizeof(double));
+	buf_status = buf_flag;
+	write_bytes(buf_pos, &buf_status, sizeof(buf_status));
+	flush_bytes();
+	//write data
+	write_run_record(run_id, r_status, par_data, obs_data);
+	flush_bytes();
+	//reset flag for buffer at end of file to 0 to signal it is no longer relavent
+	buf_status = 0;
+	write_bytes(buf_pos, &buf_status, sizeof(buf_status));
+	flush_bytes();
+	cache_run_status(run_id, r_status);
+}
+
 void RunStorage::update_run(int run_id, const Parameters &pars, const Observations &obs)
 {
 	//set run status flage to complete
@@ -274,33 +1179,7 @@ void RunStorage::update_run(int run_id, const Parameters &pars, const Observatio
 	check_rec_id(run_id);
 	vector<double> par_data(pars.get_data_vec(par_names));
 	vector<double> obs_data(obs.get_data_vec(obs_names));
-	//write data to buffer at end of file and set buffer flag to 1
-	std::int8_t buf_status = 0;
-	std::int32_t buf_run_id = run_id;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.write(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(reinterpret_cast<char*>(par_data.data()), par_data.size() * sizeof(double));
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_status = 1;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
-	//write data
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over info_txt and info_value fields
-	buf_stream.seekp(sizeof(char)*info_txt_length+sizeof(double), ios_base::cur);
-	buf_stream.write(reinterpret_cast<char*>(par_data.data()), par_data.size() * sizeof(double));
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_stream.flush();
-	//reset flag for buffer at end of file to 0 to signal it is no longer relavent
-	buf_status = 0;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	store_run(run_id, r_status, par_data.data(), obs_data.data(), 1);
 }
 
 void RunStorage::update_run(int run_id, const Observations &obs)
@@ -309,73 +1188,28 @@ void RunStorage::update_run(int run_id, const Observations &obs)
 	std::int8_t r_status = 1;
 	check_rec_id(run_id);
 	vector<double> obs_data(obs.get_data_vec(obs_names));
-	size_t n_pars = par_names.size();
-
-	//write data to buffer at end of file and set buffer flag to 1
-	std::int8_t buf_status = 0;
-	std::int32_t buf_run_id = run_id;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.write(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over parameter section
-	buf_stream.seekp(n_pars * sizeof(double), ios_base::cur);
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_status = 1;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
-
-	//write data to main part of file
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over info_txt and info_value fields
-	buf_stream.seekp(sizeof(char)*info_txt_length + sizeof(double), ios_base::cur);
-	//skip over parameter section
-	buf_stream.seekp(n_pars * sizeof(double), ios_base::cur);
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_stream.flush();
-	//reset flag for buffer at end of file to 0 to signal it is no longer relavent
-	buf_status = 0;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	store_run(run_id, r_status, nullptr, obs_data.data(), 1);
 }
 
-void RunStorage::update_run(int run_id, const vector<char> serial_data)
+void RunStorage::update_run(int run_id, const vector<char> &serial_data)
 {
 	//set run status flage to complete
 	std::int8_t r_status = 1;
 	check_rec_size(serial_data);
 	check_rec_id(run_id);
-	//write data to buffer at end of file and set buffer flag to 2
-	std::int8_t buf_status = 0;
-	std::int32_t buf_run_id = run_id;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.write(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(serial_data.data(), serial_data.size());
-	buf_status = 2;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
-	//write data
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over info_txt and info_value fields
-	buf_stream.seekp(sizeof(char)*info_txt_length+sizeof(double), ios_base::cur);
-	buf_stream.write(serial_data.data(), serial_data.size());
-	buf_stream.flush();
-	//reset flag for buffer at end of file to 0 to signal it is no longer relavent
-	buf_status = 0;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	const double *data = reinterpret_cast<const double*>(serial_data.data());
+	store_run(run_id, r_status, data, data + par_names.size(), 2);
 }
 
+void RunStorage::set_run_status(int run_id, std::int8_t r_status)
+{
+	check_rec_id(run_id);
+	commit_run(run_id);
+	//update run status flag
+	write_bytes(get_stream_pos(run_id), &r_status, sizeof(r_status));
+	flush_bytes();
+	cache_run_status(run_id, r_status);
+}
 
 void RunStorage::update_run_failed(int run_id)
 {
@@ -383,31 +1217,20 @@ void RunStorage::update_run_failed(int run_id)
 	if (r_status < 1)
 	{
 		--r_status;
-		check_rec_id(run_id);
-		//update run status flag
-		buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-		buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-		buf_stream.flush();
+		set_run_status(run_id, r_status);
 	}
 }
 
 void RunStorage::set_run_nfailed(int run_id, int nfail)
 {
 	std::int8_t r_status = -nfail;
-	check_rec_id(run_id);
-	//update run status flag
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.flush();
+	set_run_status(run_id, r_status);
 }
 
 std::int8_t RunStorage::get_run_status_native(int run_id)
 {
-	std::int8_t  r_status;
 	check_rec_id(run_id);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	return r_status;
+	return run_status_vec[run_id];
 }
 
 int RunStorage::get_run_status(int run_id)
@@ -422,10 +1245,13 @@ void RunStorage::get_info(int run_id, int &run_status, string &info_txt, double
 	vector<char> info_txt_buf;
 	info_txt_buf.resize(info_txt_length, '\0');
 
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
+	commit_run(run_id);
+	streamoff pos = get_stream_pos(run_id);
+	read_bytes(pos, &r_status, sizeof(r_status));
+	pos += sizeof(r_status);
+	read_bytes(pos, &info_txt_buf[0], sizeof(char)*info_txt_length);
+	pos += sizeof(char)*info_txt_length;
+	read_bytes(pos, &info_value, sizeof(double));
 
 	run_status = r_status;
 	info_txt = info_txt_buf.data();
@@ -464,6 +1290,7 @@ int RunStorage::get_run(int run_id, double *pars, size_t npars, double *obs, siz
 	info_txt_buf.resize(info_txt_length, '\0');
 
 	check_rec_id(run_id);
+	commit_run(run_id);
 
 	size_t p_size = par_names.size();
 	size_t o_size = obs_names.size();
@@ -480,12 +1307,15 @@ int RunStorage::get_run(int run_id, double *pars, size_t npars, double *obs, siz
 
 	p_size = min(p_size, npars);
 	o_size = min(o_size, nobs);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(pars), p_size * sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(obs), o_size * sizeof(double));
+	streamoff pos = get_stream_pos(run_id);
+	read_bytes(pos, &r_status, sizeof(r_status));
+	pos += sizeof(r_status);
+	read_bytes(pos, &info_txt_buf[0], sizeof(char)*info_txt_length);
+	pos += sizeof(char)*info_txt_length;
+	read_bytes(pos, &info_value, sizeof(double));
+	pos += sizeof(double);
+	read_bytes(pos, pars, p_size * sizeof(double));
+	read_run_obs(run_id, obs, o_size);
 	int status = r_status;
 	info_txt = info_txt_buf.data();
 	return status;
@@ -493,27 +1323,13 @@ int RunStorage::get_run(int run_id, double *pars, size_t npars, double *obs, siz
 
 int RunStorage::get_run(int run_id, vector<double> &pars_vec, vector<double> &obs_vec, string &info_txt, double &info_value)
 {
-	std::int8_t  r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-
 	size_t n_par = par_names.size();
 	size_t n_obs = obs_names.size();
       
 	pars_vec.resize(n_par);
 	obs_vec.resize(n_obs);
 
-	check_rec_id(run_id);
-	
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(&pars_vec[0]), n_par * sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(&obs_vec[0]), n_obs * sizeof(double));
-	int status = r_status;
-	info_txt = info_txt_buf.data();
-	return status;
+	return get_run(run_id, pars_vec.data(), n_par, obs_vec.data(), n_obs, info_txt, info_value);
 }
 
 int RunStorage::get_run(int run_id, vector<double> &pars_vec, vector<double> &obs_vec)
@@ -530,76 +1346,148 @@ int RunStorage::get_run(int run_id, double *pars, size_t npars, double *obs, siz
 	return get_run(run_id, pars, npars, obs, nobs, info_txt, info_value);
 }
 
+void RunStorage::get_runs(const vector<int> &run_ids, Eigen::MatrixXd &pars, Eigen::MatrixXd &obs, vector<int> &run_status)
+{
+	size_t n_par = par_names.size();
+	size_t n_obs = obs_names.size();
+	size_t n_ids = run_ids.size();
+	commit();
+	pars.resize(n_ids, n_par);
+	obs.resize(n_ids, n_obs);
+	run_status.resize(n_ids);
+
+	streamoff data_offset = sizeof(std::int8_t) + sizeof(char)*info_txt_length + sizeof(double);
+	// in the tiled layout a block is limited to the runs of one tile.  The run headers of the tile are
+	// read as one block and the observation-major observation block of the tile is read as a second block
+	streamoff rec_stride = (tile_nruns > 0) ? run_head_byte_size : run_byte_size;
+	int max_block_runs = (tile_nruns > 0) ? tile_nruns : max(streamoff(1), max_block_byte_size / run_byte_size);
+	vector<char> block;
+	vector<char> obs_block;
+	vector<double> obs_vec(n_obs);
+	size_t i_beg = 0;
+	while (i_beg < n_ids)
+	{
+		// find the run of consecutive ids starting at i_beg
+		check_rec_id(run_ids[i_beg]);
+		int max_end_id = run_ids[i_beg] + max_block_runs;
+		if (tile_nruns > 0)
+		{
+			max_end_id -= run_ids[i_beg] % tile_nruns;
+		}
+		size_t i_end = i_beg + 1;
+		while (i_end < n_ids && run_ids[i_end] < max_end_id && run_ids[i_end] == run_ids[i_end - 1] + 1)
+		{
+			++i_end;
+		}
+		check_rec_id(run_ids[i_end - 1]);
+		size_t n_block = i_end - i_beg;
+		block.assign(n_block * rec_stride, '\0');
+		read_bytes(get_stream_pos(run_ids[i_beg]), block.data(), block.size());
+		if (tile_nruns > 0)
+		{
+			// read the observation block of the tile
+			streamoff obs_row_bytes = tile_nruns * obs_value_size;
+			obs_block.assign(n_obs * obs_row_bytes, '\0');
+			read_bytes(get_obs_pos(run_ids[i_beg]) - (run_ids[i_beg] % tile_nruns) * obs_value_size, obs_block.data(), obs_block.size());
+		}
+		for (size_t i = i_beg; i < i_end; ++i)
+		{
+			const char *data = block.data() + (i - i_beg) * rec_stride + data_offset;
+			pars.row(i) = Eigen::Map<const Eigen::RowVectorXd>(reinterpret_cast<const double*>(data), n_par);
+			if (tile_nruns > 0)
+			{
+				decode_obs(obs_block.data() + (run_ids[i] % tile_nruns) * obs_value_size, n_obs, tile_nruns, obs_vec.data());
+				obs.row(i) = Eigen::Map<const Eigen::RowVectorXd>(obs_vec.data(), n_obs);
+			}
+			else
+			{
+				const char *obs_data = block.data() + (i - i_beg) * rec_stride + run_head_byte_size;
+				decode_obs(obs_data, n_obs, 1, obs_vec.data());
+				obs.row(i) = Eigen::Map<const Eigen::RowVectorXd>(obs_vec.data(), n_obs);
+			}
+			run_status[i] = run_status_vec[run_ids[i]];
+		}
+		i_beg = i_end;
+	}
+}
+
 vector<char> RunStorage::get_serial_pars(int run_id)
 {
 	check_rec_id(run_id);
+	commit_run(run_id);
 	std::int8_t r_status;
 
 	vector<char> serial_data;
 	serial_data.resize(run_par_byte_size);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.seekg(sizeof(r_status)+sizeof(char)*info_txt_length+sizeof(double), ios_base::cur);
-	buf_stream.read(serial_data.data(), serial_data.size());
+	streamoff pos = get_stream_pos(run_id) + sizeof(r_status) + sizeof(char)*info_txt_length + sizeof(double);
+	read_bytes(pos, serial_data.data(), serial_data.size());
 	return serial_data;
 }
 
-int  RunStorage::get_parameters(int run_id, Parameters &pars)
+const char *RunStorage::get_serial_pars_ptr(int run_id)
 {
+	if (map_fd < 0) return nullptr;
+	check_rec_id(run_id);
+	commit_run(run_id);
 	std::int8_t r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-	double info_value;
+	streamoff pos = get_stream_pos(run_id) + sizeof(r_status) + sizeof(char)*info_txt_length + sizeof(double);
+	// map the whole file so pointers returned for other runs are not invalidated by a remap
+	reserve_map(max(file_end, pos + run_par_byte_size));
+	return map_ptr + pos;
+}
 
+int  RunStorage::get_parameters(int run_id, Parameters &pars)
+{
 	check_rec_id(run_id);
+	commit_run(run_id);
 
 	size_t n_par = par_names.size();
 	vector<double> par_data;
 	par_data.resize(n_par);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-
-	buf_stream.read(reinterpret_cast<char*>(par_data.data()), n_par*sizeof(double));
+	streamoff pos = get_stream_pos(run_id) + sizeof(std::int8_t) + sizeof(char)*info_txt_length + sizeof(double);
+	read_bytes(pos, par_data.data(), n_par*sizeof(double));
 	pars.update(par_names, par_data);
-	int status = r_status;
+	int status = run_status_vec[run_id];
 	return status;
 }
 
 
 int  RunStorage::get_observations_vec(int run_id, vector<double> &obs_data)
 {
-	std::int8_t r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-	double info_value;
-
 	check_rec_id(run_id);
+	commit_run(run_id);
 
-	size_t n_par = par_names.size();
 	size_t n_obs = obs_names.size();
 	obs_data.resize(n_obs);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.seekg(n_par*sizeof(double), ios_base::cur);
-	buf_stream.read(reinterpret_cast<char*>(obs_data.data()), n_obs*sizeof(double));
-	int status = r_status;
+	read_run_obs(run_id, obs_data.data(), n_obs);
+	int status = run_status_vec[run_id];
 	return status;
 }
 
 void RunStorage::free_memory()
 {
-	if (buf_stream.is_open()) {
-		buf_stream.close();
+	// the file is being deleted so there is no reason to commit the journal
+	journal.clear();
+	journal_idx_map.clear();
+	if (buf_stream.is_open() || map_fd >= 0) {
+		close_storage();
 		remove(filename.c_str());
 	}
 }
 
+bool RunStorage::is_valid_serial_data(const vector<char> &serial_data) const
+{
+	if (std::streamoff(serial_data.size()) != run_data_byte_size)
+	{
+		return false;
+	}
+	const double *data = reinterpret_cast<const double*>(serial_data.data());
+	return none_of(data, data + serial_data.size() / sizeof(double), OperSys::double_is_invalid);
+}
+
 void RunStorage::check_rec_size(const vector<char> &serial_data) const
 {
-	if (serial_data.size() != run_data_byte_size)
+	if (std::streamoff(serial_data.size()) != run_data_byte_size)
 	{ 
 		throw PestError("Error in RunStorage routine.  Size of serial data is different from what is expected");
 	}
@@ -607,7 +1495,6 @@ void RunStorage::check_rec_size(const vector<char> &serial_data) const
 
 void RunStorage::check_rec_id(int run_id)
 {
-	int n_runs = get_nruns();
 	if ( run_id + 1 > n_runs)
 	{
 		ostringstream msg;
@@ -706,4 +1593,12 @@ void RunStorage::export_diff_to_text_file(const std::string &in1_filename, const
 RunStorage::~RunStorage()
 {
   //free_memory();
+  try
+  {
+	  close_storage();
+  }
+  catch (exception &e)
+  {
+	  cerr << e.what() << endl;
+  }
 }
@@ -24,7 +24,10 @@
 #include <fstream>
 #include <ostream>
 #include <vector>
+#include <set>
 #include <cstdint>
+#include <chrono>
+#include <unordered_map>
 #include <Eigen/Dense>
 
 class Parameters;
@@ -32,6 +35,12 @@ class Observations;
 
 class RunStorage {
 	// This class stores a sequence of model runs in a single binary file using the following format:
+	//     magic ("PESTRNS\0")                                                   char*8
+	//     format_version (currently 2)                                         int_32_t
+	//     obs_value_size (4 for float32 or 8 for double observation values)     int_32_t
+	//     tile_nruns (number of runs in each tile, 0 = one record per run)      int_64_t
+	//     info_txt_length (number of bytes in the info_txt field, 41)           int_32_t
+	//     record_flags (1 = each record contains a crc32 checksum)              int_32_t
 	//     nruns (number of model runs stored in file)                       int_64_t
 	//     run_size (number of bytes required to store each model run)       int_64_t
 	//     par_name_vec_size (number of bytes required to store parameter names)  int_64_t
@@ -48,19 +57,71 @@ class RunStorage {
 	//       info_value (variable used to store an important value.  The varaible     double
 	//                   depends on the type of model run being stored  )
 	//       parameter_values  (parameters values for model runs)                     double*number of parameters
-	//       observationn_values( observations results produced by the model run)     double*number of observations
+	//       checksum (crc32 of the parameter and observation values)                 uint_32_t
+	//       observationn_values( observations results produced by the model run)     obs_value_size*number of observations
+	//
+	//   Records are tightly packed.  A completed run is written data first, then checksum and finally status so
+	//   init_restart can detect a partially written run by its checksum and reset it to pending.
+	//
+	//   When tile_nruns > 0 the runs are stored in tiles of tile_nruns runs.  Each tile contains the status,
+	//   info_txt, info_value, parameter values and checksum of its runs followed by the observation values of its
+	//   runs stored observation-major (ie. value(iobs, irun) is at index iobs * tile_nruns + irun) so observations
+	//   can be assembled across runs with sequential reads.  Tiled storage updates observations one value at a
+	//   time and is best used together with use_mmap.  obs_value_size and tile_nruns are set with set_format and
+	//   take effect at the next call to reset.
+	//
+	//   Older files are still read and restarted in their own format.  Version 1 files have the same layout
+	//   without info_txt_length, record_flags and the checksum.  Legacy files start directly with nruns, use
+	//   double observation values and a run_size with unused padding.  Both use a double buffer following the
+	//   last run to recover a run that was being written when the program was interrupted.  New files are
+	//   written in the legacy format after a call to set_legacy_format(true).  This is used by
+	//   RunManagerExternal because external run managers read the storage file directly and only
+	//   understand the legacy layout.
+	//
+	//   The number of runs and the status of each run are cached in memory so they can be queried without
+	//   accessing the file.  The cache also keeps counts of pending, failed, complete and canceled runs and the
+	//   set of unfinished (pending or failed) runs.
+	//
+	//   When use_mmap is set (linux only), the file is accessed through a memory map which is grown in large
+	//   chunks and trimmed back to its logical size when the storage is flushed or closed.  Both access modes
+	//   produce identical files.
+	//
+	//   In group commit mode (set_group_commit) completed runs are accumulated in an in-memory journal instead of
+	//   being written to the file one at a time.  The journal is committed every
+	//   commit_nruns runs or commit_msec milliseconds by writing it to a separate journal file (filename + ".jnl"),
+	//   syncing it to disk, applying it to the storage file and then removing the journal file.  init_restart
+	//   replays a complete journal file left behind by a crash.  Runs that are still in the in-memory journal
+	//   are committed before their data is read.
 
 public:
 	static const double no_data;
 	RunStorage(const std::string &_filename);
+	void set_use_mmap(bool _use_mmap);
+	bool get_use_mmap() const { return use_mmap; }
+	void set_group_commit(int _commit_nruns, int _commit_msec);
+	void set_format(bool obs_float32, int _tile_nruns);
+	void set_legacy_format(bool _legacy_format) { new_legacy_format = _legacy_format; }
+	int get_format_version() const { return format_version; }
+	int get_obs_value_size() const { return obs_value_size; }
+	int get_tile_nruns() const { return tile_nruns; }
+	void commit();
+	void commit_if_due();
 	void reset(const std::vector<std::string> &par_names, const std::vector<std::string> &obs_names, const std::string &_filename = std::string(""));
 	void init_restart(const std::string &_filename);
 	virtual int add_run(const std::vector<double> &model_pars, const std::string &info_txt="", double info_value=no_data);
 	virtual int add_run(const Parameters &pars, const std::string &info_txt="", double info_value=no_data);
 	virtual int add_run(const Eigen::VectorXd &model_pars, const std::string &info_txt="", double info_value=no_data);
+	// add one model run for each row of model_pars.  The columns of model_pars must be ordered as in get_par_name_vec().
+	// info_txt_vec and info_value_vec may be empty or contain one entry per row
+	std::vector<int> add_runs(const Eigen::MatrixXd &model_pars, const std::vector<std::string> &info_txt_vec = std::vector<std::string>(),
+		const std::vector<double> &info_value_vec = std::vector<double>());
 	void update_run(int run_id, const Parameters &pars, const Observations &obs);
 	void update_run(int run_id, const Observations &obs);
-	void update_run(int run_id, const std::vector<char> serial_data);
+	// serial_data contains the parameter values followed by the observation values (as doubles) in the order of
+	// get_par_name_vec() and get_obs_name_vec().  It is written to the file without being unpacked
+	void update_run(int run_id, const std::vector<char> &serial_data);
+	// true if serial_data has the size expected by update_run and contains no nan or inf values
+	bool is_valid_serial_data(const std::vector<char> &serial_data) const;
 	void update_run_failed(int run_id);
 	void set_run_nfailed(int run_id, int nfail);
 	int get_nruns();
@@ -68,6 +129,11 @@ public:
 	const std::vector<std::string>& get_par_name_vec()const;
 	const std::vector<std::string>& get_obs_name_vec()const;
 	int get_run_status(int run_id);
+	int get_n_pending() const { return n_pending; }
+	int get_n_failed() const { return n_failed; }
+	int get_n_complete() const { return n_complete; }
+	int get_n_canceled() const { return n_canceled; }
+	const std::set<int>& get_unfinished_run_ids() const { return unfinished_run_ids; }
 	void get_info(int run_id, int &run_status, std::string &info_txt, double &info_value);
 	int get_run(int run_id, Parameters &pars, Observations &obs, bool clear_old=true);
 	int get_run(int run_id, Parameters &pars, Observations &obs, std::string &info_txt, double &info_value, bool clear_old=true);
@@ -76,17 +142,62 @@ public:
 	int get_run(int run_id, std::vector<double> &pars_vec, std::vector<double> &obs_vec,
 		    std::string &info_txt, double &info_value);
 	int get_run(int run_id, std::vector<double> &pars_vec, std::vector<double> &obs_vec);
+	// read the runs in run_ids into the rows of pars and obs.  Consecutive run ids are read as a single block
+	void get_runs(const std::vector<int> &run_ids, Eigen::MatrixXd &pars, Eigen::MatrixXd &obs, std::vector<int> &run_status);
 	int get_parameters(int run_id, Parameters &pars);
 	std::vector<char> get_serial_pars(int run_id);
+	// pointer to the serialized parameters of run_id in the memory map of the storage file or nullptr if the
+	// file is not memory mapped.  The pointer is valid until runs are added to the storage
+	const char *get_serial_pars_ptr(int run_id);
+	size_t get_serial_pars_size() const { return size_t(run_par_byte_size); }
 	int get_observations_vec(int run_id, std::vector<double> &data_vec);
 	static void export_diff_to_text_file(const std::string &in1_filename, const std::string &in2_filename, const std::string &out_filename);
 	void free_memory();
+	void flush();
 	std::string get_filename() { return filename; }
 	~RunStorage();
 private:
 	static const int info_txt_length = 41;
+	static const int cur_format_version = 2;
+	static const std::int32_t rec_flag_crc32 = 1;
+	static const char format_magic[8];
+	static const std::streamoff mmap_chunk_size = 64 * 1024 * 1024;
+	static const std::streamoff max_block_byte_size = 16 * 1024 * 1024;
 	std::string filename;
 	mutable std::fstream buf_stream;
+	bool use_mmap;
+	int map_fd;
+	char *map_ptr;
+	std::streamoff map_size;
+	std::streamoff file_end;
+	std::int64_t n_runs;
+	std::vector<std::int8_t> run_status_vec;
+	class JournalRec {
+	public:
+		std::int32_t run_id;
+		std::int8_t r_status;
+		std::int8_t has_pars;
+		std::vector<char> data;
+	};
+	int commit_nruns;
+	int commit_msec;
+	std::vector<JournalRec> journal;
+	std::unordered_map<int, size_t> journal_idx_map;
+	std::chrono::steady_clock::time_point journal_start_time;
+	int format_version;
+	int obs_value_size;
+	std::int64_t tile_nruns;
+	bool new_obs_float32;
+	int new_tile_nruns;
+	bool new_legacy_format;
+	std::streamoff nruns_pos;
+	std::streamoff run_head_byte_size;
+	std::streamoff tile_byte_size;
+	std::set<int> unfinished_run_ids;
+	int n_pending;
+	int n_failed;
+	int n_complete;
+	int n_canceled;
 	std::streamoff beg_run0;
 	std::streamoff run_byte_size;
 	std::streamoff run_par_byte_size;
@@ -97,6 +208,38 @@ private:
 	void check_rec_id(int run_id);
 	std::int8_t get_run_status_native(int run_id);
 	std::streamoff get_stream_pos(int run_id);
+	std::streamoff get_obs_pos(int run_id);
+	std::streamoff get_buffer_pos();
+	void set_record_layout();
+	bool has_run_crc() const;
+	static std::uint32_t crc32(std::uint32_t crc, const char *data, size_t n_bytes);
+	std::uint32_t calc_run_crc(const char *par_data, const char *obs_data, size_t obs_stride) const;
+	void encode_obs(const double *obs_data, size_t n_obs, char *buf) const;
+	void decode_obs(const char *buf, size_t n_obs, size_t stride, double *obs_data) const;
+	void write_run_obs(int run_id, const char *obs_buf);
+	void read_run_obs(int run_id, double *obs_data, size_t n_obs);
+	void write_run_record(int run_id, std::int8_t r_status, const double *par_data, const double *obs_data);
+	void store_run(int run_id, std::int8_t r_status, const double *par_data, const double *obs_data, std::int8_t buf_flag);
+	int add_run_native(const double *model_pars, size_t npars, const std::string &info_txt, double info_value);
+	void set_run_status(int run_id, std::int8_t r_status);
+	void clear_status_index();
+	void count_status(int run_id, std::int8_t r_status, int inc);
+	void append_status(std::int8_t r_status);
+	void cache_run_status(int run_id, std::int8_t r_status);
+	bool group_commit_enabled() const { return commit_nruns > 0 || commit_msec > 0; }
+	void journal_run(int run_id, std::int8_t r_status, const char *par_data, const char *obs_data);
+	void commit_run(int run_id);
+	void apply_journal_rec(const JournalRec &rec);
+	void replay_journal();
+	void sync_storage();
+	std::string get_journal_filename() const { return filename + ".jnl"; }
+	static void sync_file(const std::string &_filename);
+	void open_storage(bool truncate);
+	void close_storage();
+	void reserve_map(std::streamoff size);
+	void write_bytes(std::streamoff pos, const void *data, size_t n_bytes);
+	void read_bytes(std::streamoff pos, void *data, size_t n_bytes);
+	void flush_bytes();
 };
 
 #endif //RUN_STORAGE_H_
@@ -0,0 +1,429 @@
+/*
+     Copyright 2012, David Welter
+
+    This file is part of PEST++.
+
+    PEST++ is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PEST++ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "YamrBroker.h"
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cstdint>
+#include <sstream>
+#include <iostream>
+#include "pest_error.h"
+
+using namespace std;
+
+YamrBroker::YamrBroker(const string &slave_port, const string &master_port, ostream &_f_log)
+	: f_log(_f_log)
+{
+	w_init();
+	slave_listener = listen(slave_port);
+	f_log << "YAMR broker listening for slaves on port: " << slave_port << endl;
+	master_listener = listen(master_port);
+	f_log << "YAMR broker listening for masters on port: " << master_port << endl << endl;
+}
+
+YamrBroker::~YamrBroker()
+{
+	set<int> sockets = poller.get_sockets();
+	for (int i : sockets)
+	{
+		if (slave_map.find(i) != slave_map.end())
+		{
+			NetPackage net_pack(NetPackage::PackType::TERMINATE, 0, 0, "");
+			char data;
+			net_pack.send(i, &data, 0);
+		}
+		poller.remove(i);
+		w_close(i);
+	}
+	w_cleanup();
+}
+
+int YamrBroker::listen(const string &port)
+{
+	int listener;
+	struct addrinfo hints;
+	struct addrinfo *servinfo;
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	w_getaddrinfo(NULL, port.c_str(), &hints, &servinfo);
+	addrinfo *connect_addr = w_bind_first_avl(servinfo, listener);
+	freeaddrinfo(servinfo);
+	if (connect_addr == nullptr)
+	{
+		throw PestError("YAMR broker: port \"" + port + "\" is busy.  Can not bind port");
+	}
+	w_listen(listener, BACKLOG);
+	poller.add(listener);
+	return listener;
+}
+
+void YamrBroker::run()
+{
+	vector<int> ready_fds;
+	while (true)
+	{
+		if (poller.wait(1000, ready_fds) == -1)
+		{
+			continue;
+		}
+		for (int i : ready_fds)
+		{
+			// a socket may have been closed while processing an earlier socket
+			if (!poller.contains(i)) continue;
+			if (i == slave_listener || i == master_listener)
+			{
+				accept(i);
+			}
+			else if (slave_map.find(i) != slave_map.end())
+			{
+				process_slave_message(i);
+			}
+			else if (master_map.find(i) != master_map.end())
+			{
+				process_master_message(i);
+			}
+			else if (link_map.find(i) != link_map.end())
+			{
+				process_link_message(i);
+			}
+		}
+	}
+}
+
+void YamrBroker::accept(int listener_sock)
+{
+	struct sockaddr_storage remote_addr;
+	socklen_t addr_len = sizeof remote_addr;
+	int newfd = w_accept(listener_sock, (struct sockaddr *)&remote_addr, &addr_len);
+	if (newfd == -1) return;
+	NetPackage::reset_connection(newfd);
+	try
+	{
+		poller.add(newfd);
+	}
+	catch (PestError &e)
+	{
+		report(e.what());
+		w_close(newfd);
+		return;
+	}
+	vector<string> sock_name = w_getnameinfo_vec(newfd);
+	if (listener_sock == master_listener)
+	{
+		master_map[newfd] = MasterRec();
+		master_map[newfd].host = sock_name[0];
+		return;
+	}
+	// ask the new slave for its working directory and then for its linpack benchmark
+	slave_map[newfd] = SlaveRec();
+	NetPackage net_pack(NetPackage::PackType::REQ_RUNDIR, 0, 0, NetPackage::V2_TAG);
+	char data = '\0';
+	if (net_pack.send(newfd, &data, sizeof(data)) == -1)
+	{
+		close_slave(newfd);
+		return;
+	}
+	slave_map[newfd].state = State::RUNDIR_REQ;
+	report("new slave connection from: " + sock_name[0] + ":" + sock_name[1]);
+}
+
+int YamrBroker::forward(NetPackage &net_pack, int to_sock)
+{
+	const vector<char> &data = net_pack.get_data();
+	char empty = '\0';
+	const char *data_ptr = data.empty() ? &empty : data.data();
+	return net_pack.send(to_sock, data_ptr, data.size());
+}
+
+bool YamrBroker::recalibrate_requested(NetPackage &net_pack)
+{
+	const vector<char> &data = net_pack.get_data();
+	int32_t recalibrate = 0;
+	if (data.size() >= sizeof(recalibrate)) memcpy(&recalibrate, data.data(), sizeof(recalibrate));
+	return recalibrate != 0;
+}
+
+void YamrBroker::process_slave_message(int slave_sock)
+{
+	NetPackage net_pack;
+	if (net_pack.recv(slave_sock) <= 0)
+	{
+		report("lost connection to slave: " + slave_map[slave_sock].work_dir);
+		close_slave(slave_sock);
+		return;
+	}
+	SlaveRec &slave = slave_map[slave_sock];
+	NetPackage::PackType type = net_pack.get_type();
+	if (type == NetPackage::PackType::RUNDIR && slave.state == State::RUNDIR_REQ)
+	{
+		slave.work_dir = string(net_pack.get_data().begin(), net_pack.get_data().end());
+		NetPackage req_pack(NetPackage::PackType::REQ_LINPACK, 0, 0, "");
+		char data = '\0';
+		if (req_pack.send(slave_sock, &data, sizeof(data)) == -1)
+		{
+			close_slave(slave_sock);
+			return;
+		}
+		slave.state = State::LINPACK_REQ;
+	}
+	else if (type == NetPackage::PackType::LINPACK && slave.state == State::LINPACK_REQ)
+	{
+		slave.linpack_data = net_pack.get_data();
+		slave.state = State::IDLE;
+		report("slave ready: " + slave.work_dir);
+		assign_slaves();
+	}
+	else if (slave.state == State::LINKED || slave.state == State::DRAINING)
+	{
+		if (type == NetPackage::PackType::RUN_FINISH || type == NetPackage::PackType::RUN_FINISH_SPARSE
+			|| type == NetPackage::PackType::RUN_FAILED)
+		{
+			slave.run_ids.erase(net_pack.get_run_id());
+		}
+		else if (type == NetPackage::PackType::READY && slave.n_ready > 0)
+		{
+			--slave.n_ready;
+		}
+		else if (type == NetPackage::PackType::LINPACK)
+		{
+			// reply to a recalibration requested by the master
+			slave.linpack_data = net_pack.get_data();
+		}
+		if (slave.state == State::LINKED)
+		{
+			if (forward(net_pack, slave.link_sock) == -1)
+			{
+				report("error sending to master from slave: " + slave.work_dir);
+				unlink_slave(slave_sock);
+			}
+		}
+		else if (slave.run_ids.empty() && slave.n_ready == 0)
+		{
+			// the runs of a master that has gone away have finished
+			slave.state = State::IDLE;
+			report("slave ready: " + slave.work_dir);
+			assign_slaves();
+		}
+	}
+}
+
+void YamrBroker::process_master_message(int master_sock)
+{
+	NetPackage net_pack;
+	if (net_pack.recv(master_sock) <= 0)
+	{
+		close_master(master_sock);
+		return;
+	}
+	if (net_pack.get_type() == NetPackage::PackType::REQ_SLAVES)
+	{
+		// the master sends the port it is listening on for slaves
+		MasterRec &master = master_map[master_sock];
+		master.port = string(net_pack.get_data().begin(), net_pack.get_data().end());
+		report("master registered: " + master.host + ":" + master.port);
+		assign_slaves();
+	}
+}
+
+void YamrBroker::process_link_message(int link_sock)
+{
+	int slave_sock = link_map[link_sock];
+	SlaveRec &slave = slave_map[slave_sock];
+	NetPackage net_pack;
+	if (net_pack.recv(link_sock) <= 0)
+	{
+		report("connection to master closed for slave: " + slave.work_dir);
+		unlink_slave(slave_sock);
+		return;
+	}
+	NetPackage::PackType type = net_pack.get_type();
+	int err = 0;
+	if (type == NetPackage::PackType::REQ_RUNDIR)
+	{
+		NetPackage reply(NetPackage::PackType::RUNDIR, 0, 0, "");
+		err = reply.send(link_sock, slave.work_dir.c_str(), slave.work_dir.size());
+	}
+	else if (type == NetPackage::PackType::REQ_LINPACK && !recalibrate_requested(net_pack))
+	{
+		// the slave was benchmarked when it connected to the broker
+		NetPackage reply(NetPackage::PackType::LINPACK, 0, 0, "");
+		char empty = '\0';
+		const char *data_ptr = slave.linpack_data.empty() ? &empty : slave.linpack_data.data();
+		err = reply.send(link_sock, data_ptr, slave.linpack_data.size());
+	}
+	else if (type == NetPackage::PackType::TERMINATE)
+	{
+		unlink_slave(slave_sock);
+		return;
+	}
+	else
+	{
+		if (type == NetPackage::PackType::START_RUN || type == NetPackage::PackType::START_RUN_DELTA)
+		{
+			slave.run_ids.insert(net_pack.get_run_id());
+			++slave.n_ready;
+		}
+		else if (type == NetPackage::PackType::START_RUN_BATCH)
+		{
+			// data starts with the number of runs followed by the run ids
+			const vector<char> &data = net_pack.get_data();
+			int32_t n_runs = 0;
+			if (data.size() >= sizeof(n_runs)) memcpy(&n_runs, data.data(), sizeof(n_runs));
+			for (int32_t i = 0; i < n_runs && (i + 2) * sizeof(int32_t) <= data.size(); ++i)
+			{
+				int32_t run_id;
+				memcpy(&run_id, &data[(i + 1) * sizeof(int32_t)], sizeof(run_id));
+				slave.run_ids.insert(run_id);
+			}
+			++slave.n_ready;
+		}
+		err = forward(net_pack, slave_sock);
+	}
+	if (err == -1)
+	{
+		report("error sending to slave: " + slave.work_dir);
+		close_slave(slave_sock);
+	}
+}
+
+void YamrBroker::assign_slaves()
+{
+	for (auto &i_slave : slave_map)
+	{
+		SlaveRec &slave = i_slave.second;
+		if (slave.state != State::IDLE) continue;
+		// give the slave to the registered master using the fewest slaves
+		auto it_master = master_map.end();
+		for (auto it = master_map.begin(); it != master_map.end(); ++it)
+		{
+			if (it->second.port.empty()) continue;
+			if (it_master == master_map.end() || it->second.n_links < it_master->second.n_links) it_master = it;
+		}
+		if (it_master == master_map.end()) return;
+		MasterRec &master = it_master->second;
+		struct addrinfo hints;
+		struct addrinfo *servinfo;
+		memset(&hints, 0, sizeof hints);
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		if (w_getaddrinfo(master.host.c_str(), master.port.c_str(), &hints, &servinfo) != 0)
+		{
+			report("unable to resolve master: " + master.host + ":" + master.port);
+			close_master(it_master->first);
+			return;
+		}
+		int link_sock;
+		addrinfo *connect_addr = w_connect_first_avl(servinfo, link_sock);
+		freeaddrinfo(servinfo);
+		if (connect_addr == nullptr)
+		{
+			report("unable to connect to master: " + master.host + ":" + master.port);
+			close_master(it_master->first);
+			return;
+		}
+		NetPackage::reset_connection(link_sock);
+		poller.add(link_sock);
+		link_map[link_sock] = i_slave.first;
+		slave.link_sock = link_sock;
+		slave.master_sock = it_master->first;
+		slave.state = State::LINKED;
+		++master.n_links;
+		report("slave " + slave.work_dir + " connected to master: " + master.host + ":" + master.port);
+	}
+}
+
+void YamrBroker::unlink_slave(int slave_sock)
+{
+	SlaveRec &slave = slave_map[slave_sock];
+	if (slave.link_sock != -1)
+	{
+		poller.remove(slave.link_sock);
+		w_close(slave.link_sock);
+		link_map.erase(slave.link_sock);
+		slave.link_sock = -1;
+	}
+	auto it_master = master_map.find(slave.master_sock);
+	if (it_master != master_map.end()) --it_master->second.n_links;
+	slave.master_sock = -1;
+	if (slave.run_ids.empty() && slave.n_ready == 0)
+	{
+		slave.state = State::IDLE;
+		report("slave ready: " + slave.work_dir);
+		assign_slaves();
+		return;
+	}
+	// kill the runs that are no longer needed and wait for the slave to report back
+	slave.state = State::DRAINING;
+	for (int run_id : slave.run_ids)
+	{
+		NetPackage net_pack(NetPackage::PackType::REQ_KILL, 0, run_id, "");
+		char data = '\0';
+		if (net_pack.send(slave_sock, &data, sizeof(data)) == -1)
+		{
+			close_slave(slave_sock);
+			return;
+		}
+	}
+}
+
+void YamrBroker::close_slave(int slave_sock)
+{
+	auto it_slave = slave_map.find(slave_sock);
+	if (it_slave == slave_map.end()) return;
+	// closing the connection to the master lets it reschedule the slave's runs
+	if (it_slave->second.link_sock != -1)
+	{
+		poller.remove(it_slave->second.link_sock);
+		w_close(it_slave->second.link_sock);
+		link_map.erase(it_slave->second.link_sock);
+	}
+	auto it_master = master_map.find(it_slave->second.master_sock);
+	if (it_master != master_map.end()) --it_master->second.n_links;
+	poller.remove(slave_sock);
+	w_close(slave_sock);
+	slave_map.erase(it_slave);
+	stringstream ss;
+	ss << "closed connection to slave; number of slaves: " << slave_map.size();
+	report(ss.str());
+}
+
+void YamrBroker::close_master(int master_sock)
+{
+	auto it_master = master_map.find(master_sock);
+	if (it_master == master_map.end()) return;
+	report("master unregistered: " + it_master->second.host + ":" + it_master->second.port);
+	// slaves already connected to the master stay with it until it closes their connections
+	for (auto &i_slave : slave_map)
+	{
+		if (i_slave.second.master_sock == master_sock) i_slave.second.master_sock = -1;
+	}
+	poller.remove(master_sock);
+	w_close(master_sock);
+	master_map.erase(it_master);
+}
+
+void YamrBroker::report(const string &message)
+{
+	std::time_t tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	string t_str = ctime(&tt);
+	f_log << t_str.substr(0, t_str.length() - 1) << "->" << message << endl;
+}
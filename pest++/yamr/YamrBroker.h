@@ -0,0 +1,91 @@
+/*
+     Copyright 2012, David Welter
+
+    This file is part of PEST++.
+
+    PEST++ is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PEST++ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef YAMRBROKER_H_
+#define YAMRBROKER_H_
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <ostream>
+#include "network_wrapper.h"
+#include "network_package.h"
+#include "network_poller.h"
+
+// YamrBroker is a long running process that keeps a pool of YAMR slaves connected between PEST++ runs.
+// Slaves connect to the broker's slave port and are initialized (REQ_RUNDIR and REQ_LINPACK) once.  A master
+// registers on the broker's master port by sending REQ_SLAVES with the port it is listening on.  The broker
+// then opens a connection to the master for each idle slave and relays the messages between them, answering
+// REQ_RUNDIR and REQ_LINPACK itself.  A TERMINATE from the master is not passed on; the slave is returned to
+// the pool instead.  If a master goes away while its runs are being made, the runs are killed before the
+// slave is given to another master.
+class YamrBroker
+{
+public:
+	YamrBroker(const std::string &slave_port, const std::string &master_port, std::ostream &_f_log);
+	~YamrBroker();
+	// process messages from slaves and masters.  Does not return
+	void run();
+private:
+	enum class State { NEW, RUNDIR_REQ, LINPACK_REQ, IDLE, LINKED, DRAINING };
+	class SlaveRec
+	{
+	public:
+		SlaveRec() : state(State::NEW), link_sock(-1), master_sock(-1), n_ready(0) {}
+		State state;
+		std::string work_dir;
+		std::vector<char> linpack_data;
+		int link_sock; // connection to the master using this slave
+		int master_sock; // registration socket of the master using this slave
+		std::set<int> run_ids; // runs started by the master that have not finished
+		int n_ready; // READY messages the slave still has to send
+	};
+	class MasterRec
+	{
+	public:
+		MasterRec() : n_links(0) {}
+		std::string host;
+		std::string port;
+		int n_links;
+	};
+	static const int BACKLOG = 10;
+	std::ostream &f_log;
+	int slave_listener;
+	int master_listener;
+	NetPoller poller;
+	std::unordered_map<int, SlaveRec> slave_map; // slaves by their socket
+	std::unordered_map<int, MasterRec> master_map; // masters by their registration socket
+	std::unordered_map<int, int> link_map; // slave socket of each connection to a master
+	int listen(const std::string &port);
+	void accept(int listener_sock);
+	int forward(NetPackage &net_pack, int to_sock);
+	// true if a REQ_LINPACK message asks the slave to repeat its calibration
+	bool recalibrate_requested(NetPackage &net_pack);
+	void process_slave_message(int slave_sock);
+	void process_master_message(int master_sock);
+	void process_link_message(int link_sock);
+	void assign_slaves();
+	void unlink_slave(int slave_sock);
+	void close_slave(int slave_sock);
+	void close_master(int master_sock);
+	void report(const std::string &message);
+};
+
+#endif /* YAMRBROKER_H_ */
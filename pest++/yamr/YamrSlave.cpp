@@ -3,37 +3,35 @@
 #include "Serialization.h"
 #include "system_variables.h"
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <algorithm>
 #include <thread>
+#include <sstream>
+#include <iomanip>
+#include <functional>
 #include "system_variables.h"
 #include "iopp.h"
 
 using namespace pest_utils;
 
-int  linpack_wrap(void);
+const string YAMRSlave::slot_dir_prefix = "yamr_slot_";
+const string YAMRSlave::calib_file_prefix = "yamr_calibration_";
+const double YAMRSlave::calib_secs = 0.2;
 
-extern "C"
-{
+double linpack_calibrate(double min_secs);
 
-	void wrttpl_(int *,
-		char *,
-		char *,
-		int *,
-		char *,
-		double *,
-		int *);
-
-	void readins_(int *,
-		char *,
-		char *,
-		int *,
-		char *,
-		double *,
-		int *);
+YAMRSlave::YAMRSlave() : sockfd(-1), fdmax(0), terminate(false), n_slots(1), base_pars_group(-1),
+	base_obs_group(-1), obs_tol(0.0), last_batch_id(0)
+{
+	wake_fd[0] = -1;
+	wake_fd[1] = -1;
 }
 
-
+void YAMRSlave::set_slots(int _n_slots)
+{
+	n_slots = max(_n_slots, 1);
+}
 
 void YAMRSlave::init_network(const string &host, const string &port)
 {
@@ -67,20 +65,46 @@ void YAMRSlave::init_network(const string &host, const string &port)
 	}
 	cout << "connection to master succeeded on socket: " << w_get_addrinfo_string(connect_addr) << endl << endl;
 	freeaddrinfo(servinfo);
+	NetPackage::reset_connection(sockfd);
 
 	fdmax = sockfd;
 	FD_ZERO(&master);
 	FD_SET(sockfd, &master);
+	if (wake_fd[0] == -1 && w_socketpair(wake_fd) != 0)
+	{
+		throw PestError("could not create the socket pair used to wake the slave when a run finishes");
+	}
+	FD_SET(wake_fd[0], &master);
+	fdmax = max(sockfd, wake_fd[0]);
 	// send run directory to master
 }
 
 
 YAMRSlave::~YAMRSlave()
 {
+	terminate_slot_runs();
 	w_close(sockfd);
+	for (int fd : wake_fd)
+	{
+		if (fd != -1) w_close(fd);
+	}
 	w_cleanup();
 }
 
+void YAMRSlave::wake_main_thread()
+{
+	char data = '\0';
+	w_send(wake_fd[1], &data, sizeof(data), 0);
+}
+
+bool YAMRSlave::recv_wake(int fd)
+{
+	if (fd != wake_fd[0]) return false;
+	char buf[64];
+	w_recv(fd, buf, sizeof(buf), 0);
+	return true;
+}
+
 int YAMRSlave::recv_message(NetPackage &net_pack)
 {
 	fd_set read_fds;
@@ -92,6 +116,7 @@ int YAMRSlave::recv_message(NetPackage &net_pack)
 		}
 		for(int i = 0; i <= fdmax; i++) {
 			if (FD_ISSET(i, &read_fds)) { // got message to read
+				if (recv_wake(i)) return 0; // woken by a slot thread
 				if(( err=net_pack.recv(i)) <=0) // error or lost connection
 				{
 					vector<string> sock_name = w_getnameinfo_vec(i);
@@ -132,6 +157,7 @@ int YAMRSlave::recv_message(NetPackage &net_pack,int timeout_microsecs)
 		{		
 			for (int i = 0; i <= fdmax; i++) {
 				if (FD_ISSET(i, &read_fds)) { // got message to read
+					if (recv_wake(i)) return 0; // woken by a slot thread
 					if ((err = net_pack.recv(i)) <= 0) // error or lost connection
 					{
 						vector<string> sock_name = w_getnameinfo_vec(i);
@@ -176,441 +202,397 @@ int YAMRSlave::send_message(NetPackage &net_pack, const void *data, unsigned lon
 	return err;
 }
 
-string YAMRSlave::tpl_err_msg(int i)
+void YAMRSlave::write_input_files(Parameters &pars, const vector<string> &inp_files)
 {
-	string err_msg;
-	switch (i)
-	{
-	case 0:
-	  err_msg = string("Routine completed successfully");
-		break;
-	case 1:
-	  err_msg = string("TPL file does not exist");
-		break;
-	case 2:
-	  err_msg = string("Not all parameters listed in TPL file");
-		break;
-	case 3:
-	  err_msg = string("Illegal header specified in TPL file");
-		break;
-	case 4:
-	  err_msg = string("Error getting parameter name from template");
-		break;
-	case 5:
-	  err_msg = string("Error getting parameter name from template");
-		break;
-	case 10:
-	  err_msg = string("Error writing to model input file");
-	}
-	return err_msg;
+	vector<double> par_values;
+	for (auto &name : par_name_vec)
+	{
+		par_values.push_back(pars.get_rec(name));
+	}
+	if (std::any_of(par_values.begin(), par_values.end(), OperSys::double_is_invalid))
+	{
+		throw PestError("Error running model: invalid parameter value returned");
+	}
+	if (!tpl_writer)
+	{
+		throw PestError("Error processing template files: model IO files have not been received from the master");
+	}
+	tpl_writer->write(par_values, inp_files);
+	// update parameter values
+	pars.clear();
+	pars.insert(par_name_vec, par_values);
 }
 
-
-string YAMRSlave::ins_err_msg(int i)
+void YAMRSlave::read_output_files(Observations &obs, const vector<string> &out_files)
 {
-	string err_msg;
-	switch (i)
+	if (!ins_reader)
 	{
-	case 0:
-		err_msg = "Routine completed successfully";
-		break;
-	default:
-		err_msg = "";
+		throw PestError("Error processing instruction files: model IO files have not been received from the master");
+	}
+	vector<double> obs_vec;
+	ins_reader->read(out_files, obs_vec);
+	// check observations for inf and nan
+	if (std::any_of(obs_vec.begin(), obs_vec.end(), OperSys::double_is_invalid))
+	{
+		throw PestError("Error running model: invalid observation value returned");
+	}
+	// update observation values
+	obs.clear();
+	for (size_t i = 0; i < obs_name_vec.size(); ++i)
+	{
+		obs[obs_name_vec[i]] = obs_vec[i];
 	}
-	return err_msg;
 }
 
-int YAMRSlave::run_model(Parameters &pars, Observations &obs,NetPackage &net_pack)
+int YAMRSlave::send_run_results(NetPackage &net_pack, int group_id, int run_id, Parameters &pars, Observations &obs,
+	const string &desc)
 {
-	bool done = false;
-	int success = 1,err = 0;
-	int recv_fails = 0;	
-	int send_fails = 0;
-	std::vector<double> obs_vec;
-	bool isDouble = true;
-	bool forceRadix = true;
-	//TemplateFiles tpl_files(isDouble, forceRadix, tplfile_vec, inpfile_vec, par_name_vec);
-	//InstructionFiles ins_files(insfile_vec, outfile_vec);	
-	thread_flag f_terminate(false);
-	thread_flag f_finished(false);
-	try 
-	{
-	//	message.str("");
-		//first delete any existing input and output files			
-		for (auto &out_file : outfile_vec)
-		{
-			if ((check_exist_out(out_file)) && (remove(out_file.c_str()) != 0))
-				throw PestError("model interface error: Cannot delete existing model output file " + out_file);
+	vector<char> serialized_data = Serialization::serialize(pars, par_name_vec, obs, obs_name_vec);
+	const size_t par_size = par_name_vec.size() * sizeof(double);
+	if (base_obs_group >= 0 && base_obs_group == group_id && serialized_data.size() == par_size + base_obs.size() * sizeof(double))
+	{
+		// RUN_FINISH_SPARSE data: the parameters followed by the number of observations that differ from
+		// the base observations and the index and value of each
+		vector<char> sparse_data(serialized_data.begin(), serialized_data.begin() + par_size);
+		sparse_data.resize(par_size + sizeof(int32_t));
+		const size_t max_sparse_size = serialized_data.size() / 2;
+		for (size_t i = 0; i < base_obs.size() && sparse_data.size() <= max_sparse_size; ++i)
+		{
+			const char *val_ptr = &serialized_data[par_size + i * sizeof(double)];
+			double val;
+			memcpy(&val, val_ptr, sizeof(val));
+			bool same = (obs_tol > 0) ? std::abs(val - base_obs[i]) <= obs_tol * std::abs(base_obs[i])
+				: memcmp(&val, &base_obs[i], sizeof(val)) == 0;
+			if (!same)
+			{
+				int32_t idx = i;
+				sparse_data.insert(sparse_data.end(), (char*)&idx, (char*)&idx + sizeof(idx));
+				sparse_data.insert(sparse_data.end(), val_ptr, val_ptr + sizeof(double));
+			}
 		}
-		for (auto &in_file : inpfile_vec)
+		if (sparse_data.size() <= max_sparse_size)
 		{
-			if ((check_exist_out(in_file)) && (remove(in_file.c_str()) != 0))
-				throw PestError("model interface error: Cannot delete existing model input file " + in_file);
+			int32_t n_sparse = (sparse_data.size() - par_size - sizeof(int32_t)) / (sizeof(int32_t) + sizeof(double));
+			memcpy(&sparse_data[par_size], &n_sparse, sizeof(n_sparse));
+			net_pack.reset(NetPackage::PackType::RUN_FINISH_SPARSE, group_id, run_id, desc);
+			return send_message(net_pack, sparse_data.data(), sparse_data.size());
 		}
+	}
+	net_pack.reset(NetPackage::PackType::RUN_FINISH, group_id, run_id, desc);
+	return send_message(net_pack, serialized_data.data(), serialized_data.size());
+}
 
+void YAMRSlave::reset_base_data()
+{
+	base_pars_group = -1;
+	base_pars.clear();
+	delta_run_pars.clear();
+	base_obs_group = -1;
+	base_obs.clear();
+}
 
-		int ifail;
-		int ntpl = tplfile_vec.size();
-		int npar = pars.size();
-		vector<string> par_name_vec;
-		vector<double> par_values;
-		for (auto &i : pars)
-		{
-			par_name_vec.push_back(i.first);
-			par_values.push_back(i.second);
-		}
-		if (std::any_of(par_values.begin(), par_values.end(), OperSys::double_is_invalid))
-		{
-			throw PestError("Error running model: invalid parameter value returned");
-		}
-		wrttpl_(&ntpl, StringvecFortranCharArray(tplfile_vec, 50).get_prt(),
-			StringvecFortranCharArray(inpfile_vec, 50).get_prt(),
-			&npar, StringvecFortranCharArray(par_name_vec, 50, pest_utils::TO_LOWER).get_prt(),
-			par_values.data(), &ifail);
-		if (ifail != 0)
+double YAMRSlave::get_linpack_time(bool recalibrate)
+{
+	// the calibration is stored for each host together with a hash of the processor model so it is
+	// repeated if the slave is moved to different hardware
+	string host = w_gethostname();
+	stringstream cache_name;
+	cache_name << OperSys::temp_dir() << OperSys::DIR_SEP << calib_file_prefix << host << ".dat";
+	size_t cpu_hash = std::hash<string>()(OperSys::cpu_model());
+	if (!recalibrate)
+	{
+		ifstream fin(cache_name.str());
+		size_t cache_hash;
+		double linpack_secs;
+		if (fin >> cache_hash >> linpack_secs && cache_hash == cpu_hash && linpack_secs > 0)
 		{
-			throw PestError("Error processing template file:" + tpl_err_msg(ifail));
+			cout << "using cached calibration: " << cache_name.str() << endl;
+			return linpack_secs;
 		}
+	}
+	double linpack_secs = linpack_calibrate(calib_secs);
+	if (linpack_secs > 0)
+	{
+		ofstream fout(cache_name.str());
+		fout << cpu_hash << " " << setprecision(12) << linpack_secs << endl;
+	}
+	return linpack_secs;
+}
 
-		// update parameter values		
-		pars.clear();
-		for (int i = 0; i<npar; ++i)
-		{
-			pars[par_name_vec[i]] = par_values[i];
-		}
-		thread run_thread(w_run_commands, &f_terminate, &f_finished, comline_vec);
-		while (true)
-		{
-			//check if the runner thread has finished
-			if (f_finished.get())
-			{
-				cout << "received finished signal from runner " << std::endl;
-				run_thread.join();
-				//don't break here, need to check one last time for incoming messages
-				done = true;
-			}
-			//this call includes a "sleep" for the timeout
-			err = recv_message(net_pack, OperSys::thread_sleep_milli_secs * 1000);
-			if (err == -1)
-			{
-				recv_fails++;
-				if (recv_fails >= max_recv_fails)
-				{
-					cerr << "recv from master failed " << max_recv_fails << " times, exiting..." << endl;
-					f_terminate.set(true);
-					run_thread.join();
-					exit(-1);
-				}
-			}
-			//timeout on recv
-			else if (err == 0){}
-			else if (net_pack.get_type() == NetPackage::PackType::PING)
-			{
-				cout << "ping request recieved...";
-				net_pack.reset(NetPackage::PackType::PING, 0, 0, "");
-				const char* data = "\0";
-				err = send_message(net_pack, &data, 0);
-				if (err == -1)
-				{
-					send_fails++;
-					if (send_fails >= max_send_fails)
-					{
-						cerr << "send to master failed " << max_send_fails << " times, exiting..." << endl;
-						f_terminate.set(true);
-						run_thread.join();
-						exit(-1);
-					}
-				}
-				cout << "ping response sent" << endl;
-			}
-			else if (net_pack.get_type() == NetPackage::PackType::REQ_KILL)
-			{
-				cout << "received kill request signal from master" << endl;
-				cout << "sending terminate signal to run thread" << endl;
-				f_terminate.set(true);
-				run_thread.join();
-				success = 0;
-				break;
-			}
-			else if (net_pack.get_type() == NetPackage::PackType::TERMINATE)
-			{
-				cout << "received terminate signal from master" << endl;
-				cout << "sending terminate signal to run thread" << endl;
-				f_terminate.set(true);
-				run_thread.join();
-				success = 0;
-				terminate = true;
-				break;
-			}
-			else
-			{
-				cerr << "Received unsupported message from master, only PING REQ_KILL or TERMINATE can be sent during model run" << endl;
-				cerr << "something is wrong...exiting" << endl;
-				f_terminate.set(true);
-				run_thread.join();
-				exit(-1);
-			}
-			if (done) break;
-		}
-		//if this run was terminated, throw an error to signal a failed run
-		if (f_terminate.get())
-		{
-			throw PestError("model run terminated");
-		}
-		// process instruction files		
-		int nins = insfile_vec.size();
-		int nobs = obs_name_vec.size();
-		std::vector<double> obs_vec;
-		obs_vec.resize(nobs, -9999.00);
-		readins_(&nins, StringvecFortranCharArray(insfile_vec, 50).get_prt(),
-			StringvecFortranCharArray(outfile_vec, 50).get_prt(),
-			&nobs, StringvecFortranCharArray(obs_name_vec, 50, pest_utils::TO_LOWER).get_prt(),
-			obs_vec.data(), &ifail);
-		if (ifail != 0)
+void YAMRSlave::init_slots()
+{
+	slots.clear();
+	pending_runs.clear();
+	batch_n_runs.clear();
+	if (n_slots < 2)
+	{
+		// a single slot runs the model in the working directory of the slave
+		slots.push_back(unique_ptr<Slot>(new Slot("")));
+		return;
+	}
+	vector<string> file_vec(inpfile_vec);
+	file_vec.insert(file_vec.end(), outfile_vec.begin(), outfile_vec.end());
+	for (auto &file : file_vec)
+	{
+		if (OperSys::is_absolute_path(file))
 		{
-			throw PestError("Error processing instruction file");
+			throw PestError("model input and output files must be relative to the working directory when using multiple slots: " + file);
 		}
+	}
+	// each slot gets its own copy of the working directory.  This is done once and the copies are reused for every run
+	string cwd = OperSys::getcwd();
+	for (int i = 1; i <= n_slots; ++i)
+	{
+		stringstream ss;
+		ss << slot_dir_prefix << i;
+		string work_dir = ss.str();
+		cout << "copying working directory to slot directory " << work_dir << "...";
+		OperSys::copy_dir(cwd, cwd + OperSys::DIR_SEP + work_dir, slot_dir_prefix);
+		cout << "done" << endl;
+		slots.push_back(unique_ptr<Slot>(new Slot(work_dir)));
+	}
+}
 
-		// check parameters and observations for inf and nan
-		if (std::any_of(par_values.begin(), par_values.end(), OperSys::double_is_invalid))
-		{
-			throw PestError("Error running model: invalid parameter value returned");
-		}
-		if (std::any_of(obs_vec.begin(), obs_vec.end(), OperSys::double_is_invalid))
+const vector<char> &YAMRSlave::get_run_pars(NetPackage &net_pack)
+{
+	if (net_pack.get_type() != NetPackage::PackType::START_RUN_DELTA)
+	{
+		return net_pack.get_data();
+	}
+	// the data contains the number of parameters that differ from the base parameters of the group
+	// followed by the index and value of each
+	const vector<char> &data = net_pack.get_data();
+	int32_t n_delta = 0;
+	if (data.size() >= sizeof(n_delta)) memcpy(&n_delta, data.data(), sizeof(n_delta));
+	const size_t entry_size = sizeof(int32_t) + sizeof(double);
+	if (base_pars_group != net_pack.get_groud_id() || n_delta < 0 || data.size() != sizeof(n_delta) + n_delta * entry_size)
+	{
+		cerr << "received parameter differences from master without matching base parameters" << endl;
+		cerr << "something is wrong...exiting" << endl;
+		exit(-1);
+	}
+	delta_run_pars = base_pars;
+	for (int32_t i = 0; i < n_delta; ++i)
+	{
+		int32_t idx;
+		const char *entry = &data[sizeof(n_delta) + i * entry_size];
+		memcpy(&idx, entry, sizeof(idx));
+		if (idx < 0 || (idx + 1) * sizeof(double) > delta_run_pars.size())
 		{
-			throw PestError("Error running model: invalid observation value returned");
+			cerr << "received invalid parameter index from master: " << idx << endl;
+			exit(-1);
 		}
-		// update observation values		
-		obs.clear();
-		for (int i = 0; i<nobs; ++i)
-		{
-			obs[obs_name_vec[i]] = obs_vec[i];
-		}
-		//IOPP method
-		//tpl_files.write(pars);		
-		//thread run_thread(w_run_commands, &f_terminate, &f_finished, comline_vec);
-		//while (true)
-		//{							
-		//	//check if the runner thread has finished
-		//	if (f_finished.get())
-		//	{
-		//		cout << "received finished signal from runner " << std::endl;
-		//		run_thread.join();
-		//		//don't break here, need to check one last time for incoming messages
-		//		done = true;
-		//	}
-		//	//this call includes a "sleep" for the timeout
-		//	err = recv_message(net_pack, OperSys::thread_sleep_milli_secs*1000);
-		//	if (err == -1)
-		//	{
-		//		recv_fails++;
-		//		if (recv_fails >= max_recv_fails)
-		//		{
-		//			cerr << "recv from master failed " << max_recv_fails << " times, exiting..." << endl;
-		//			f_terminate.set(true);
-		//			run_thread.join();
-		//			exit(-1);
-		//		}
-		//	}
-		//	//timeout on recv
-		//	else if (err == 0){}
-		//	else if (net_pack.get_type() == NetPackage::PackType::PING)
-		//	{
-		//		cout << "ping request recieved...";
-		//		net_pack.reset(NetPackage::PackType::PING, 0, 0, "");
-		//		const char* data = "\0";
-		//		err = send_message(net_pack, &data, 0);
-		//		if (err == -1)
-		//		{
-		//			send_fails++;
-		//			if (send_fails >= max_send_fails)
-		//			{
-		//				cerr << "send to master failed " << max_send_fails << " times, exiting..." << endl;
-		//				f_terminate.set(true);
-		//				run_thread.join();
-		//				exit(-1);
-		//			}
-		//		}
-		//		cout << "ping response sent" << endl;
-		//	}
-		//	else if (net_pack.get_type() == NetPackage::PackType::REQ_KILL)
-		//	{
-		//	    cout << "received kill request signal from master" << endl;
-		//		cout << "sending terminate signal to run thread" << endl;
-		//		f_terminate.set(true);
-		//		run_thread.join();
-		//		success = 0;				
-		//		break;
-		//	}
-		//	else if (net_pack.get_type() == NetPackage::PackType::TERMINATE)
-		//	{
-		//		cout << "received terminate signal from master" << endl;
-		//		cout << "sending terminate signal to run thread" << endl;
-		//		f_terminate.set(true);
-		//		run_thread.join();
-		//		success = 0;
-		//		terminate = true;
-		//		break;
-		//	}
-		//	else
-		//	{
-		//		cerr << "Received unsupported message from master, only PING REQ_KILL or TERMINATE can be sent during model run" << endl;
-		//		cerr << "something is wrong...exiting" << endl;
-		//		f_terminate.set(true);
-		//		run_thread.join();
-		//		exit(-1);
-		//	}	
-		//	if (done) break;
-		//}		
-		////if this run was terminated, throw an error to signal a failed run
-		//if (f_terminate.get())
-		//{
-		//	throw PestError("model run terminated");
-		//}
-		//// process instruction files		
-		//obs.clear();
-		//ins_files.read(obs_name_vec, obs);		
-	}
-	catch(const std::exception& ex)
+		memcpy(&delta_run_pars[idx * sizeof(double)], entry + sizeof(idx), sizeof(double));
+	}
+	return delta_run_pars;
+}
+
+int YAMRSlave::queue_run(int group_id, int run_id, int batch_id, vector<char> &&par_data)
+{
+	cout << "received parameters (group id = " << group_id << ", run id = " << run_id << ")" << endl;
+	if (pending_runs.size() >= size_t(max_pending_runs))
 	{
-		cerr << endl;
-		cerr << "   " << ex.what() << endl;
-		cerr << "   Aborting model run" << endl << endl;
-		success = 0;
+		cerr << "received run " << run_id << " from master but the queue of pending runs is full" << endl;
+		NetPackage net_pack(NetPackage::PackType::RUN_FAILED, group_id, run_id, "");
+		char data = '\0';
+		int err = send_message(net_pack, &data, sizeof(data));
+		int ready_err = finish_batch_run(batch_id);
+		return (err == -1) ? err : ready_err;
 	}
-	catch(...)
+	pending_runs.emplace_back(group_id, run_id, batch_id, std::move(par_data));
+	return 0;
+}
+
+void YAMRSlave::start_pending_runs()
+{
+	for (auto &slot : slots)
 	{
-		cerr << "   Error running model" << endl;
-		cerr << "   Aborting model run" << endl;
-		success = 0;
+		if (pending_runs.empty()) break;
+		if (slot->run_id != -1) continue;
+		start_slot_run(slot.get(), pending_runs.front());
+		pending_runs.pop_front();
+	}
+}
+
+void YAMRSlave::start_slot_run(Slot *slot, PendingRun &run)
+{
+	Serialization::unserialize(run.par_data, slot->pars, par_name_vec);
+	slot->group_id = run.group_id;
+	slot->run_id = run.run_id;
+	slot->batch_id = run.batch_id;
+	slot->f_terminate.set(false);
+	slot->f_finished.set(false);
+	if (slot->work_dir.empty())
+	{
+		cout << "starting model run (run id = " << run.run_id << ")..." << endl;
+	}
+	else
+	{
+		cout << "starting model run in " << slot->work_dir << " (run id = " << run.run_id << ")..." << endl;
 	}
-	return success;
+	slot->run_thread = thread(&YAMRSlave::run_slot_model, this, slot);
 }
 
-int YAMRSlave::run_model(Parameters &pars, Observations &obs)
+int YAMRSlave::finish_batch_run(int batch_id)
 {
-	int success = 1;
-	std::vector<double> obs_vec;
-	bool isDouble = true;
-	bool forceRadix = true;
-	//TemplateFiles tpl_files(isDouble, forceRadix, tplfile_vec, inpfile_vec, par_name_vec);
-	//InstructionFiles ins_files(insfile_vec, outfile_vec);
-	thread_flag terminate(false);
-	thread_flag finished(false);
+	auto it = batch_n_runs.find(batch_id);
+	if (it == batch_n_runs.end() || --(it->second) > 0)
+	{
+		return 0;
+	}
+	batch_n_runs.erase(it);
+	// Send READY Message to master
+	NetPackage net_pack(NetPackage::PackType::READY, 0, 0, "");
+	char data;
+	return send_message(net_pack, &data, 0);
+}
+
+void YAMRSlave::run_slot_model(Slot *slot)
+{
+	slot->usage = RunUsage();
+	slot->success = 1;
 	try
 	{
-		//	message.str("");
-		//first delete any existing input and output files			
-		for (auto &out_file : outfile_vec)
+		vector<string> slot_inpfile_vec;
+		vector<string> slot_outfile_vec;
+		string file_prefix = slot->work_dir.empty() ? string() : slot->work_dir + OperSys::DIR_SEP;
+		for (auto &file : inpfile_vec) slot_inpfile_vec.push_back(file_prefix + file);
+		for (auto &file : outfile_vec) slot_outfile_vec.push_back(file_prefix + file);
+		//first delete any existing input and output files
+		for (auto &out_file : slot_outfile_vec)
 		{
 			if ((check_exist_out(out_file)) && (remove(out_file.c_str()) != 0))
 				throw PestError("model interface error: Cannot delete existing model output file " + out_file);
 		}
-		for (auto &in_file : inpfile_vec)
+		for (auto &in_file : slot_inpfile_vec)
 		{
 			if ((check_exist_out(in_file)) && (remove(in_file.c_str()) != 0))
 				throw PestError("model interface error: Cannot delete existing model input file " + in_file);
 		}
-		int ifail;
-		int ntpl = tplfile_vec.size();
-		int npar = pars.size();
-		vector<string> par_name_vec;
-		vector<double> par_values;
-		for(auto &i : pars)
-		{
-		par_name_vec.push_back(i.first);
-		par_values.push_back(i.second);
-		}
-		if (std::any_of(par_values.begin(), par_values.end(), OperSys::double_is_invalid))
-		{
-			throw PestError("Error running model: invalid parameter value returned");
-		}
-		wrttpl_(&ntpl, StringvecFortranCharArray(tplfile_vec, 50).get_prt(),
-		StringvecFortranCharArray(inpfile_vec, 50).get_prt(),
-		&npar, StringvecFortranCharArray(par_name_vec, 50, pest_utils::TO_LOWER).get_prt(),
-		par_values.data(), &ifail);
-		if(ifail != 0)
+		// the template writer is shared by the slots without locking as write() does not modify it
+		write_input_files(slot->pars, slot_inpfile_vec);
+		// the process group of the run is killed if the master asks for the run to be terminated
+		ModelLauncher::Status status = ModelLauncher::run(comline_vec, slot->work_dir, &slot->f_terminate, 0, slot->usage);
+		//if this run was terminated, throw an error to signal a failed run
+		if (status == ModelLauncher::Status::TERMINATED)
 		{
-		throw PestError("Error processing template file:" + tpl_err_msg(ifail));
+			throw PestError("model run terminated");
 		}
-
-		// update parameter values		
-		pars.clear();
-		for (int i=0; i<npar; ++i)
+		if (status == ModelLauncher::Status::START_FAILED)
 		{
-		pars[par_name_vec[i]] = par_values[i];
+			throw PestError("could not start model command");
 		}
+		// process instruction files.  The instruction reader is shared by the slots in the same way as the
+		// template writer
+		read_output_files(slot->obs, slot_outfile_vec);
+	}
+	catch (const std::exception& ex)
+	{
+		cerr << endl;
+		cerr << "   " << ex.what() << endl;
+		cerr << "   Aborting model run in " << slot->work_dir << endl << endl;
+		slot->success = 0;
+	}
+	catch (...)
+	{
+		cerr << "   Error running model" << endl;
+		cerr << "   Aborting model run in " << slot->work_dir << endl;
+		slot->success = 0;
+	}
+	slot->f_finished.set(true);
+	wake_main_thread();
+}
 
-		// run model - single thread
-		for (auto &i : comline_vec)
-		{
-			ifail = system(i.c_str());
-			if(ifail != 0)
-			{
-				cerr << "Error executing command line: " << i << endl;
-				throw PestError("Error executing command line: " + i);
-			}
+int YAMRSlave::send_slot_results()
+{
+	int err = 0;
+	Parameters pars;
+	Observations obs;
+	for (auto &slot : slots)
+	{
+		if (slot->run_id == -1 || !slot->f_finished.get()) continue;
+		slot->run_thread.join();
+		int group_id = slot->group_id;
+		int run_id = slot->run_id;
+		int batch_id = slot->batch_id;
+		int success = slot->success;
+		swap(pars, slot->pars);
+		swap(obs, slot->obs);
+		string usage_str = slot->usage.to_string();
+		// start the next run before sending the results so the model runs while the results are sent
+		slot->run_id = -1;
+		if (!pending_runs.empty())
+		{
+			start_slot_run(slot.get(), pending_runs.front());
+			pending_runs.pop_front();
+		}
+		NetPackage net_pack;
+		int send_err;
+		if (success)
+		{
+			//send model results back
+			cout << "run complete (run id = " << run_id << ")" << endl;
+			cout << "sending results to master (group id = " << group_id << ", run id = " << run_id << ")..." << endl;
+			send_err = send_run_results(net_pack, group_id, run_id, pars, obs, usage_str);
+			cout << "results sent" << endl << endl;
 		}
-		// process instructio files
-		int nins = insfile_vec.size();
-		int nobs = obs_name_vec.size();
-		std::vector<double> obs_vec;
-		obs_vec.resize(nobs, -9999.00);
-		readins_(&nins, StringvecFortranCharArray(insfile_vec, 50).get_prt(),
-			StringvecFortranCharArray(outfile_vec, 50).get_prt(),
-			&nobs, StringvecFortranCharArray(obs_name_vec, 50, pest_utils::TO_LOWER).get_prt(),
-			obs_vec.data(), &ifail);
-		if(ifail != 0)
+		else
 		{
-			throw PestError("Error processing instruction file");
+			char data = '\0';
+			net_pack.reset(NetPackage::PackType::RUN_FAILED, group_id, run_id, "");
+			send_err = send_message(net_pack, &data, sizeof(data));
 		}
+		if (send_err == -1) err = -1;
+		send_err = finish_batch_run(batch_id);
+		if (send_err == -1) err = -1;
+	}
+	return err;
+}
 
-		// check parameters and observations for inf and nan
-		if (std::any_of(par_values.begin(), par_values.end(), OperSys::double_is_invalid))
-		{
-			throw PestError("Error running model: invalid parameter value returned");
-		}
-		if (std::any_of(obs_vec.begin(), obs_vec.end(), OperSys::double_is_invalid))
-		{
-			throw PestError("Error running model: invalid observation value returned");
-		}
-		// update observation values		
-		obs.clear();
-		for (int i=0; i<nobs; ++i)
+bool YAMRSlave::kill_slot_run(int run_id)
+{
+	for (auto &slot : slots)
+	{
+		if (slot->run_id == run_id)
 		{
-			obs[obs_name_vec[i]] = obs_vec[i];
+			cout << "sending terminate signal to run " << run_id << endl;
+			slot->f_terminate.set(true);
+			return true;
 		}
-		/*
-		//IOPP
-		tpl_files.write(pars);
-		// run model - single thread
-		for (auto &i : comline_vec)
-		{
-			ifail = system(i.c_str());
-			if (ifail != 0)
-			{
-				cerr << "Error executing command line: " << i << endl;
-				throw PestError("Error executing command line: " + i);
-			}
-		}
-		obs.clear();
-		ins_files.read(obs_name_vec, obs);
-		*/
 	}
-	catch (const std::exception& ex)
+	auto it_pending = find_if(pending_runs.begin(), pending_runs.end(), [run_id](const PendingRun &r) { return r.run_id == run_id; });
+	if (it_pending != pending_runs.end())
 	{
-		cerr << endl;
-		cerr << "   " << ex.what() << endl;
-		cerr << "   Aborting model run" << endl << endl;
-		success = 0;
+		cout << "removing run " << run_id << " from the queue of pending runs" << endl;
+		NetPackage net_pack(NetPackage::PackType::RUN_FAILED, it_pending->group_id, run_id, "");
+		int batch_id = it_pending->batch_id;
+		pending_runs.erase(it_pending);
+		char data = '\0';
+		send_message(net_pack, &data, sizeof(data));
+		finish_batch_run(batch_id);
+		return true;
 	}
-	catch (...)
+	return false;
+}
+
+void YAMRSlave::terminate_slot_runs()
+{
+	for (auto &slot : slots)
 	{
-		cerr << "   Error running model" << endl;
-		cerr << "   Aborting model run" << endl;
-		success = 0;
+		if (slot->run_thread.joinable())
+		{
+			slot->f_terminate.set(true);
+			slot->run_thread.join();
+		}
+		slot->run_id = -1;
 	}
-	return success;
+	pending_runs.clear();
+	batch_n_runs.clear();
+}
+
+bool YAMRSlave::slots_busy() const
+{
+	return !pending_runs.empty() || any_of(slots.begin(), slots.end(), [](const unique_ptr<Slot> &s) { return s->run_id != -1; });
 }
 
 void YAMRSlave::check_io()
@@ -645,17 +627,14 @@ void YAMRSlave::check_par_obs()
 void YAMRSlave::start(const string &host, const string &port)
 {
 	NetPackage net_pack;
-	Observations obs;
-	Parameters pars;
-	vector<char> serialized_data;
 	int err;
-	//class attribute - can be modified in run_model()
 	terminate = false;	
 	int recv_fails = 0,send_fails = 0;
 	init_network(host, port);
 	while (!terminate)
 	{
-		//get message from master
+		//get message from master.  The slot threads wake this thread up when a run finishes so its results
+		//are sent straight away
 		err = recv_message(net_pack);
 		if (err == -1)
 		{
@@ -666,10 +645,15 @@ void YAMRSlave::start(const string &host, const string &port)
 				terminate = true;
 			}
 		}
+		else if (err == 0)
+		{
+			//no message: woken by a slot thread or lost connection
+		}
 		else if(net_pack.get_type() == NetPackage::PackType::REQ_RUNDIR)
 		{
 			// Send Master the local run directory.  This information is only used by the master
 			// for reporting purposes
+			reset_base_data();
 			net_pack.reset(NetPackage::PackType::RUNDIR, 0, 0,"");
 			string cwd =  OperSys::getcwd();
 			err = send_message(net_pack, cwd.c_str(), cwd.size());
@@ -694,11 +678,16 @@ void YAMRSlave::start(const string &host, const string &port)
 			outfile_vec = tmp_vec_vec[4];
 			par_name_vec= tmp_vec_vec[5];
 			obs_name_vec= tmp_vec_vec[6];
+			reset_base_data();
 			cout << "checking model IO files...";
 			try
 			{
 				check_io();
 				//check_par_obs();
+				// the template and instruction files are read once here and reused for every run
+				tpl_writer.reset(new TemplateWriter(tplfile_vec, par_name_vec));
+				ins_reader.reset(new InstructionReader(insfile_vec, obs_name_vec));
+				init_slots();
 			}
 			catch (exception &e)
 			{
@@ -714,10 +703,23 @@ void YAMRSlave::start(const string &host, const string &port)
 		}
 		else if(net_pack.get_type() == NetPackage::PackType::REQ_LINPACK)
 		{
-			linpack_wrap();
+			// the master can ask for the calibration to be repeated instead of using the cached value
+			int32_t recalibrate = 0;
+			if (net_pack.get_data().size() >= sizeof(recalibrate))
+			{
+				memcpy(&recalibrate, net_pack.get_data().data(), sizeof(recalibrate));
+			}
+			double linpack_secs = get_linpack_time(recalibrate != 0);
+			// tell the master how many runs can be made at the same time and the calibrated benchmark time
 			net_pack.reset(NetPackage::PackType::LINPACK, 0, 0,"");
-			char data;
-			err = send_message(net_pack, &data, 0);
+			// followed by the optional protocol features this slave supports
+			char data[sizeof(int32_t) + sizeof(double) + sizeof(int32_t)];
+			int32_t data_slots = n_slots;
+			int32_t features = NetPackage::FEATURE_DELTA_PARS | NetPackage::FEATURE_SPARSE_OBS;
+			memcpy(data, &data_slots, sizeof(data_slots));
+			memcpy(data + sizeof(data_slots), &linpack_secs, sizeof(linpack_secs));
+			memcpy(data + sizeof(data_slots) + sizeof(linpack_secs), &features, sizeof(features));
+			err = send_message(net_pack, data, sizeof(data));
 			if (err == -1)
 			{
 				send_fails++;
@@ -728,56 +730,73 @@ void YAMRSlave::start(const string &host, const string &port)
 				}
 			}
 		}
-		else if(net_pack.get_type() == NetPackage::PackType::START_RUN)
+		else if (net_pack.get_type() == NetPackage::PackType::BASE_PARS)
 		{
-			Serialization::unserialize(net_pack.get_data(), pars, par_name_vec);
-			// run model
-			int group_id = net_pack.get_groud_id();
-			int run_id = net_pack.get_run_id();
-			cout << "received parameters (group id = " << group_id << ", run id = " << run_id << ")" << endl;
-			cout << "starting model run..." << endl;
-			if (run_model(pars, obs, net_pack))
+			// parameters the START_RUN_DELTA packages of this group are relative to
+			base_pars_group = net_pack.get_groud_id();
+			base_pars = net_pack.get_data();
+		}
+		else if (net_pack.get_type() == NetPackage::PackType::BASE_OBS)
+		{
+			// relative tolerance followed by the observations RUN_FINISH_SPARSE packages of this group are relative to
+			const vector<char> &data = net_pack.get_data();
+			if (data.size() < sizeof(obs_tol) || (data.size() - sizeof(obs_tol)) % sizeof(double) != 0)
 			{
-				//send model results back
-				cout << "run complete" << endl;
-				cout << "sending results to master (group id = " << group_id << ", run id = " << run_id << ")..." <<endl;
-				cout << "results sent" << endl << endl;
-				serialized_data = Serialization::serialize(pars, par_name_vec, obs, obs_name_vec);
-				net_pack.reset(NetPackage::PackType::RUN_FINISH, group_id, run_id, "");
-				err = send_message(net_pack, serialized_data.data(), serialized_data.size());
-				if (err == -1)
-				{
-					send_fails++;
-					if (send_fails >= max_send_fails)
-					{
-						cerr << "send to master failed " << max_send_fails << " times, exiting..." << endl;
-						exit(-1);
-					}
-				}
-				// Send READY Message to master
-				net_pack.reset(NetPackage::PackType::READY, 0, 0,"");
-				char data;
-				err = send_message(net_pack, &data, 0);
-				if (err == -1)
+				cerr << "received invalid base observations from master" << endl;
+				cerr << "something is wrong...exiting" << endl;
+				exit(-1);
+			}
+			memcpy(&obs_tol, data.data(), sizeof(obs_tol));
+			base_obs.resize((data.size() - sizeof(obs_tol)) / sizeof(double));
+			if (!base_obs.empty()) memcpy(base_obs.data(), data.data() + sizeof(obs_tol), base_obs.size() * sizeof(double));
+			base_obs_group = net_pack.get_groud_id();
+		}
+		else if(net_pack.get_type() == NetPackage::PackType::START_RUN ||
+			net_pack.get_type() == NetPackage::PackType::START_RUN_DELTA)
+		{
+			// the run is started as soon as a slot is free.  The results and a READY message are sent when it finishes
+			int batch_id = ++last_batch_id;
+			batch_n_runs[batch_id] = 1;
+			err = queue_run(net_pack.get_groud_id(), net_pack.get_run_id(), batch_id, vector<char>(get_run_pars(net_pack)));
+			if (err == -1)
+			{
+				send_fails++;
+				if (send_fails >= max_send_fails)
 				{
-					send_fails++;
-					if (send_fails >= max_send_fails)
-					{
-						cerr << "send to master failed " << max_send_fails << " times, exiting..." << endl;
-						exit(-1);
-					}
+					cerr << "send to master failed " << max_send_fails << " times, exiting..." << endl;
+					exit(-1);
 				}
 			}
-			else
+		}
+		else if (net_pack.get_type() == NetPackage::PackType::START_RUN_BATCH)
+		{
+			// data contains the number of runs, the run ids and then the parameter values of each run.
+			// The runs are queued and the results of each run are sent as soon as it finishes.  READY is
+			// sent after the last run of the batch
+			int group_id = net_pack.get_groud_id();
+			const vector<char> &batch_data = net_pack.get_data();
+			int32_t n_runs = 0;
+			size_t par_byte_size = par_name_vec.size() * sizeof(double);
+			if (batch_data.size() >= sizeof(n_runs))
 			{
-				serialized_data.clear();
-				serialized_data.push_back('\0');
-				net_pack.reset(NetPackage::PackType::RUN_FAILED, group_id, run_id, "");
-				err = send_message(net_pack, serialized_data.data(), serialized_data.size());
-				// Send READY Message to master
-				net_pack.reset(NetPackage::PackType::READY, 0, 0,"");
-				char data;
-				err = send_message(net_pack, &data, 0);
+				memcpy(&n_runs, batch_data.data(), sizeof(n_runs));
+			}
+			size_t par_loc = sizeof(n_runs) + n_runs * sizeof(int32_t);
+			if (n_runs <= 0 || batch_data.size() != par_loc + n_runs * par_byte_size)
+			{
+				cerr << "received invalid batch of model runs from master" << endl;
+				cerr << "something is wrong...exiting" << endl;
+				exit(-1);
+			}
+			cout << "received batch of " << n_runs << " runs (group id = " << group_id << ")" << endl;
+			int batch_id = ++last_batch_id;
+			batch_n_runs[batch_id] = n_runs;
+			for (int i = 0; i < n_runs; ++i)
+			{
+				int32_t run_id;
+				memcpy(&run_id, &batch_data[sizeof(n_runs) + i * sizeof(int32_t)], sizeof(run_id));
+				auto it_pars = batch_data.begin() + par_loc + i * par_byte_size;
+				err = queue_run(group_id, run_id, batch_id, vector<char>(it_pars, it_pars + par_byte_size));
 				if (err == -1)
 				{
 					send_fails++;
@@ -787,13 +806,17 @@ void YAMRSlave::start(const string &host, const string &port)
 						exit(-1);
 					}
 				}
-				//w_sleep(500);
 			}
 		}
 		else if (net_pack.get_type() == NetPackage::PackType::TERMINATE)
 		{
+			terminate_slot_runs();
 			terminate = true;
 		}
+		else if (net_pack.get_type() == NetPackage::PackType::REQ_KILL && kill_slot_run(net_pack.get_run_id()))
+		{
+			cout << "received kill request from master for run " << net_pack.get_run_id() << endl;
+		}
 		else if (net_pack.get_type() == NetPackage::PackType::REQ_KILL)
 		{
 			cout << "received kill request from master. run already finished" << endl;
@@ -819,8 +842,26 @@ void YAMRSlave::start(const string &host, const string &port)
 		{
 			cout << "received unsupported messaged type: " << int(net_pack.get_type()) << endl;
 		}
-		//w_sleep(100);
-		this_thread::sleep_for(chrono::milliseconds(100));
+		if (!slots.empty())
+		{
+			start_pending_runs();
+			err = send_slot_results();
+			if (err == -1)
+			{
+				send_fails++;
+				if (send_fails >= max_send_fails)
+				{
+					cerr << "send to master failed " << max_send_fails << " times, exiting..." << endl;
+					exit(-1);
+				}
+			}
+		}
+		else
+		{
+			//w_sleep(100);
+			this_thread::sleep_for(chrono::milliseconds(100));
+		}
 	}
+	terminate_slot_runs();
 }
 
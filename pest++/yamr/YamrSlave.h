@@ -26,13 +26,25 @@
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
 #include "utilities.h"
 #include "pest_error.h"
 #include "network_package.h"
+#include "model_launcher.h"
+#include "template_writer.h"
+#include "instruction_reader.h"
 #include "Transformable.h"
 
 class YAMRSlave{
 public:
+	YAMRSlave();
+	// number of model runs that can be made at the same time.  With more than one slot each run is made in
+	// its own copy of the working directory
+	void set_slots(int _n_slots);
 	void init_network(const std::string &host, const std::string &port);
 	void start(const std::string &host, const std::string &port);
 	~YAMRSlave();
@@ -40,10 +52,6 @@ public:
 	int recv_message(NetPackage &net_pack);
 	int recv_message(NetPackage &net_pack,int timeout_microsec);
 	int send_message(NetPackage &net_pack, const void *data=NULL, unsigned long data_len=0);
-	int run_model(Parameters &pars, Observations &obs, NetPackage &net_pack);
-	int run_model(Parameters &pars, Observations &obs);
-	std::string tpl_err_msg(int i);
-	std::string ins_err_msg(int i);
 	void check_io();
 	void check_par_obs();
 	//void listener(pest_utils::thread_flag* terminate, pest_utils::thread_flag* finished);
@@ -51,6 +59,12 @@ public:
 private:
 	int sockfd;
 	int fdmax;
+	// the slot threads write to wake_fd[1] when a run finishes so the main thread, waiting in select on
+	// wake_fd[0], sends the results straight away
+	int wake_fd[2];
+	void wake_main_thread();
+	// returns true if fd is the wake up socket.  Its data is discarded
+	bool recv_wake(int fd);
 #ifdef _DEBUG
 	static const int max_recv_fails = 10;
 	static const int max_send_fails = 10;
@@ -60,6 +74,90 @@ private:
 #endif
 	static const int recv_timeout_secs = 1;	
 	bool terminate;
+	class Slot
+	{
+	public:
+		Slot(const std::string &_work_dir) : work_dir(_work_dir), group_id(0), run_id(-1), batch_id(-1), success(0),
+			f_terminate(false), f_finished(false) {}
+		std::string work_dir; // empty for the working directory of the slave
+		int group_id;
+		int run_id; // -1 when the slot is free
+		int batch_id;
+		int success;
+		Parameters pars;
+		Observations obs;
+		std::thread run_thread;
+		pest_utils::thread_flag f_terminate;
+		pest_utils::thread_flag f_finished;
+		RunUsage usage; // resources used by the last run
+	};
+	// run received from the master that is waiting for a free slot
+	class PendingRun
+	{
+	public:
+		PendingRun(int _group_id, int _run_id, int _batch_id, std::vector<char> &&_par_data)
+			: group_id(_group_id), run_id(_run_id), batch_id(_batch_id), par_data(std::move(_par_data)) {}
+		int group_id;
+		int run_id;
+		int batch_id; // runs received in the same START_RUN or START_RUN_BATCH message
+		std::vector<char> par_data;
+	};
+	static const std::string slot_dir_prefix;
+	static const int max_pending_runs = 128;
+	static const std::string calib_file_prefix;
+	static const double calib_secs;
+	// time the LINPACK benchmark would take on this computer, estimated from a short calibration run.  The
+	// result is cached in the temporary directory and reused unless recalibrate is true
+	double get_linpack_time(bool recalibrate);
+	int n_slots;
+	std::vector<std::unique_ptr<Slot>> slots;
+	void init_slots();
+	// parameters of the last BASE_PARS package.  START_RUN_DELTA packages of the same group contain the
+	// parameters that differ from them
+	int base_pars_group;
+	std::vector<char> base_pars;
+	std::vector<char> delta_run_pars;
+	// serialized parameters of a START_RUN or START_RUN_DELTA package
+	const std::vector<char> &get_run_pars(NetPackage &net_pack);
+	// observations of the last BASE_OBS package.  Results of runs in the same group are sent as
+	// RUN_FINISH_SPARSE packages containing the observations that differ from them by more than obs_tol
+	int base_obs_group;
+	double obs_tol;
+	std::vector<double> base_obs;
+	// group ids start again from 1 for each master, so the base parameters and observations are
+	// forgotten when a new master connects (it sends REQ_RUNDIR and CMD first)
+	void reset_base_data();
+	// send a RUN_FINISH or RUN_FINISH_SPARSE package with the results of a model run
+	// desc is sent as the package description.  Slots use it to report the resources used by the run
+	int send_run_results(NetPackage &net_pack, int group_id, int run_id, Parameters &pars, Observations &obs,
+		const std::string &desc="");
+	// runs are queued as they arrive from the master and started as soon as a slot becomes free, so a
+	// slot does not wait for the master to answer the results of its previous run.  The main thread only
+	// handles the connection to the master; the runs, including the template and instruction file
+	// processing, are made by the slot threads
+	std::deque<PendingRun> pending_runs;
+	// runs of each batch that have not finished.  READY is sent to the master when the last one finishes
+	std::unordered_map<int, int> batch_n_runs;
+	int last_batch_id;
+	int queue_run(int group_id, int run_id, int batch_id, std::vector<char> &&par_data);
+	void start_pending_runs();
+	void start_slot_run(Slot *slot, PendingRun &run);
+	int finish_batch_run(int batch_id);
+	void run_slot_model(Slot *slot);
+	// model input files are written from the template files compiled when the model IO files are received
+	std::unique_ptr<TemplateWriter> tpl_writer;
+	// write the model input files for pars and replace pars by the values written to the files
+	void write_input_files(Parameters &pars, const std::vector<std::string> &inp_files);
+	// model output files are read with the instruction files compiled when the model IO files are received
+	std::unique_ptr<InstructionReader> ins_reader;
+	// read the observations from the model output files
+	void read_output_files(Observations &obs, const std::vector<std::string> &out_files);
+	// send the results of finished runs.  The next pending run is started in the slot before the results
+	// are sent
+	int send_slot_results();
+	bool kill_slot_run(int run_id);
+	void terminate_slot_runs();
+	bool slots_busy() const;
 	fd_set master;
 	std::vector<std::string> comline_vec;
 	std::vector<std::string> tplfile_vec;
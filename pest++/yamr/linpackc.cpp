@@ -17,6 +17,10 @@
 ** - Prints machine precision.
 ** - ANSI prototyping.
 **
+** linpack_calibrate() is a short alternative to the full benchmark used by
+** the YAMR slaves.  It times a blocked matrix multiply for a fraction of a
+** second and scales the result to the time linpack_wrap() would take.
+**
 ** To compile:  cc -O -o linpack linpack.c -lm
 **
 **
@@ -60,9 +64,17 @@ static REAL ddot_ur  (int n,REAL *dx,int incx,REAL *dy,int incy);
 static void dscal_ur (int n,REAL da,REAL *dx,int incx);
 static int  idamax   (int n,REAL *dx,int incx);
 static REAL second   (void);
+static void dgemm_blk(REAL *a,REAL *b,REAL *c,int n,int nb);
 
 static void *mempool;
 
+/* size of the LINPACK problem solved by linpack_wrap() */
+#define LINPACK_ARSIZE  200
+#define LINPACK_NREPS   1000
+/* matrix order and block size of the calibration kernel */
+#define CALIB_N         128
+#define CALIB_NB        32
+
 
 int linpack_wrap(void)
 
@@ -71,7 +83,7 @@ int linpack_wrap(void)
     long    arsize2d,memreq,nreps;
     size_t  malloc_arg;
 
-     arsize=200;
+     arsize=LINPACK_ARSIZE;
      arsize/=2;
      arsize*=2;
      arsize2d = (long)arsize*(long)arsize;
@@ -89,7 +101,7 @@ int linpack_wrap(void)
      printf("Average rolled and unrolled performance:\n\n");
      printf("    Reps Time(s) DGEFA   DGESL  OVERHEAD    KFLOPS\n");
      printf("----------------------------------------------------\n");
-     nreps=1000;
+     nreps=LINPACK_NREPS;
 	
      linpack(nreps,arsize);
      free(mempool);
@@ -98,6 +110,86 @@ int linpack_wrap(void)
     }
 
 
+/*
+** Times C = C + A*B with CALIB_N x CALIB_N matrices for at least min_secs
+** CPU seconds.  Returns the number of seconds the full benchmark run by
+** linpack_wrap() would take at the same floating point rate, or -1 if
+** the memory could not be allocated.
+*/
+double linpack_calibrate(double min_secs)
+
+    {
+    REAL   *a,*b,*c;
+    REAL   t1,totalt,kflops,ops,linpack_ops;
+    long   i,nreps;
+    int    n,nn;
+
+    n=CALIB_N;
+    nn=n*n;
+    if ((a=(REAL *)malloc(3*(size_t)nn*sizeof(REAL)))==NULL)
+        return(-1.);
+    b=a+nn;
+    c=b+nn;
+    for (i=0;i<nn;i++)
+        {
+        a[i]=(REAL)((i*7)%13)/13.-0.5;
+        b[i]=(REAL)((i*5)%11)/11.-0.5;
+        c[i]=ZERO;
+        }
+    nreps=0;
+    t1=second();
+    do
+        {
+        dgemm_blk(a,b,c,n,CALIB_NB);
+        nreps++;
+        totalt=second()-t1;
+        }
+    while (totalt<min_secs);
+    free(a);
+    if (totalt<=0.)
+        totalt=1./CLOCKS_PER_SEC;
+    ops=2.0*n*n*n;
+    kflops=nreps*ops/(1000.*totalt);
+    n=LINPACK_ARSIZE/2;
+    linpack_ops=2.*LINPACK_NREPS*((2.0*n*n*n)/3.0+2.0*n*n);
+    printf("Calibration: %ld reps %6.2f s %9.3f KFLOPS\n",nreps,totalt,kflops);
+    return(linpack_ops/(1000.*kflops));
+    }
+
+
+/*
+** Blocked matrix multiply C = C + A*B for n x n matrices stored by
+** columns, c[n*j+i] = sum a[n*k+i]*b[n*j+k].  The blocks of nb columns
+** of A are reused while they are in cache.
+*/
+static void dgemm_blk(REAL *a,REAL *b,REAL *c,int n,int nb)
+
+    {
+    int  i,j,k,ii,jj,kk,imax,jmax,kmax;
+    REAL t;
+
+    for (jj=0;jj<n;jj+=nb)
+        {
+        jmax=(jj+nb<n) ? jj+nb : n;
+        for (kk=0;kk<n;kk+=nb)
+            {
+            kmax=(kk+nb<n) ? kk+nb : n;
+            for (ii=0;ii<n;ii+=nb)
+                {
+                imax=(ii+nb<n) ? ii+nb : n;
+                for (j=jj;j<jmax;j++)
+                    for (k=kk;k<kmax;k++)
+                        {
+                        t=b[n*j+k];
+                        for (i=ii;i<imax;i++)
+                            c[n*j+i]+=t*a[n*k+i];
+                        }
+                }
+            }
+        }
+    }
+
+
 static REAL linpack(long nreps,int arsize)
 
     {
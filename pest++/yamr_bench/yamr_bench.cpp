@@ -0,0 +1,195 @@
+/*
+ Copyright 2012, David Welter
+
+This file is part of PEST++.
+
+PEST++ is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PEST++ is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdlib>
+#include "RunManagerYAMR.h"
+
+using namespace std;
+
+// Measures the throughput of the YAMR master's run table bookkeeping when a large number of slaves send
+// RUN_FINISH messages.  Each round assigns one model run to every slave, with 10% of the slaves working on
+// concurrent copies of runs that are already active, and then processes a RUN_FINISH message from every
+// slave in random order in the same way as RunManagerYAMR::process_message:  the run on the slave is looked
+// up, the other copies of the run are moved to the zombie table and killed, and finished zombies are removed.
+// The same workload is run against the linear search of the multimap tables used by earlier versions of the
+// master for comparison.
+
+void usage(ostream &fout)
+{
+	fout << "--------------------------------------------------------" << endl;
+	fout << "usage:" << endl << endl;
+	fout << "  yamr_bench [n_slaves [n_rounds]]" << endl << endl;
+	fout << " where:" << endl;
+	fout << "  n_slaves:    number of simulated slaves (default 5000)" << endl;
+	fout << "  n_rounds:    number of rounds of model runs (default 10)" << endl;
+	fout << "--------------------------------------------------------" << endl;
+}
+
+class Workload
+{
+public:
+	vector<YamrModelRun> runs;
+	vector<int> finish_order;
+};
+
+Workload make_workload(int n_slaves, mt19937 &rng)
+{
+	Workload work;
+	int n_unique = max(1, n_slaves - n_slaves / 10);
+	uniform_int_distribution<int> rand_run(0, n_unique - 1);
+	for (int i_sock = 0; i_sock < n_slaves; ++i_sock)
+	{
+		int run_id = (i_sock < n_unique) ? i_sock : rand_run(rng);
+		work.runs.push_back(YamrModelRun(run_id, i_sock));
+		work.finish_order.push_back(i_sock);
+	}
+	shuffle(work.finish_order.begin(), work.finish_order.end(), rng);
+	return work;
+}
+
+// returns the number of kill requests that would have been sent
+long long process_indexed(const Workload &work)
+{
+	YamrRunTable active_runs;
+	YamrRunTable zombie_runs;
+	unordered_set<int> completed_runs;
+	long long n_kill = 0;
+	for (const auto &run : work.runs)
+	{
+		active_runs.insert(run);
+	}
+	for (int i_sock : work.finish_order)
+	{
+		int run_id = work.runs[i_sock].get_id();
+		if (zombie_runs.erase(i_sock, run_id)) continue;
+		if (active_runs.find(i_sock, run_id) == nullptr) continue;
+		completed_runs.insert(run_id);
+		for (int act_sock_id : active_runs.get_sockets(run_id))
+		{
+			if (act_sock_id != i_sock)
+			{
+				zombie_runs.insert(*active_runs.find(act_sock_id, run_id));
+			}
+			active_runs.erase(act_sock_id, run_id);
+		}
+		n_kill += zombie_runs.get_sockets(run_id).size();
+	}
+	return n_kill;
+}
+
+long long process_linear(const Workload &work)
+{
+	unordered_multimap<int, YamrModelRun> active_runs;
+	unordered_multimap<int, YamrModelRun> zombie_runs;
+	unordered_set<int> completed_runs;
+	long long n_kill = 0;
+	auto find_socket = [](unordered_multimap<int, YamrModelRun> &run_map, int socket)
+	{
+		auto i = run_map.begin();
+		for (; i != run_map.end() && i->second.get_socket() != socket; ++i) {}
+		return i;
+	};
+	for (const auto &run : work.runs)
+	{
+		active_runs.insert(pair<int, YamrModelRun>(run.get_id(), run));
+	}
+	for (int i_sock : work.finish_order)
+	{
+		auto it_zombie = find_socket(zombie_runs, i_sock);
+		if (it_zombie != zombie_runs.end())
+		{
+			zombie_runs.erase(it_zombie);
+			continue;
+		}
+		auto it_active = find_socket(active_runs, i_sock);
+		if (it_active == active_runs.end()) continue;
+		int run_id = it_active->second.get_id();
+		completed_runs.insert(run_id);
+		auto range_pair = active_runs.equal_range(run_id);
+		for (auto b = range_pair.first; b != range_pair.second; ++b)
+		{
+			if (b->second.get_socket() != i_sock)
+			{
+				zombie_runs.insert(*b);
+			}
+		}
+		active_runs.erase(range_pair.first, range_pair.second);
+		for (auto &z : zombie_runs)
+		{
+			if (z.second.get_id() == run_id) ++n_kill;
+		}
+	}
+	return n_kill;
+}
+
+int main(int argc, char* argv[])
+{
+	int n_slaves = 5000;
+	int n_rounds = 10;
+	if (argc > 3)
+	{
+		usage(cerr);
+		return 1;
+	}
+	if (argc > 1) n_slaves = atoi(argv[1]);
+	if (argc > 2) n_rounds = atoi(argv[2]);
+	if (n_slaves <= 0 || n_rounds <= 0)
+	{
+		usage(cerr);
+		return 1;
+	}
+
+	mt19937 rng(2718);
+	vector<Workload> work_vec;
+	for (int i = 0; i < n_rounds; ++i)
+	{
+		work_vec.push_back(make_workload(n_slaves, rng));
+	}
+
+	typedef long long(*ProcessFunc)(const Workload &);
+	vector<pair<string, ProcessFunc>> method_vec;
+	method_vec.push_back(make_pair(string("indexed run table"), &process_indexed));
+	method_vec.push_back(make_pair(string("linear search"), &process_linear));
+	cout << n_slaves << " slaves, " << n_rounds << " rounds" << endl;
+	vector<double> msg_rate_vec;
+	for (auto &method : method_vec)
+	{
+		long long n_kill = 0;
+		auto start = chrono::steady_clock::now();
+		for (const auto &work : work_vec)
+		{
+			n_kill += method.second(work);
+		}
+		double sec = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1.0E6;
+		double msg_rate = (double)n_slaves * n_rounds / max(sec, 1.0E-6);
+		msg_rate_vec.push_back(msg_rate);
+		cout << "  " << method.first << ": " << sec << " sec, " << msg_rate << " RUN_FINISH messages/sec, "
+			<< n_kill << " zombie kills" << endl;
+	}
+	cout << "  speedup: " << msg_rate_vec[0] / msg_rate_vec[1] << endl;
+	return 0;
+}
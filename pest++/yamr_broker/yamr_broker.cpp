@@ -0,0 +1,62 @@
+/*
+ Copyright 2012, David Welter
+
+This file is part of PEST++.
+
+PEST++ is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+PEST++ is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+
+#include <iostream>
+#include <string>
+#include "YamrBroker.h"
+#include "pest_error.h"
+
+using namespace std;
+
+// Keeps a pool of YAMR slaves between PEST++ runs.  Slaves are started once with
+//   pest++ control_file.pst /H broker_hostname:slave_port
+// and each PEST++ master borrows them with
+//   pest++ control_file.pst /H :port /B broker_hostname:master_port
+
+void usage(ostream &fout)
+{
+	fout << "--------------------------------------------------------" << endl;
+	fout << "usage:" << endl << endl;
+	fout << "  yamr_broker slave_port master_port" << endl << endl;
+	fout << " where:" << endl;
+	fout << "  slave_port:  port YAMR slaves connect to" << endl;
+	fout << "  master_port: port PEST++ masters register on with /B" << endl;
+	fout << "--------------------------------------------------------" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		usage(cerr);
+		return 1;
+	}
+	try
+	{
+		YamrBroker broker(argv[1], argv[2], cout);
+		broker.run();
+	}
+	catch (PestError &e)
+	{
+		cerr << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}